@@ -9,7 +9,7 @@ mode="${1:-debug}"
 
 mkdir -p "$build"
 
-CFLAGS="-std=c11 -lX11 -lXrandr -lGL -lm"
+CFLAGS="-std=c11 -pthread -lX11 -lXrandr -lGL -lm"
 
 case "$mode" in
     debug)
@@ -61,6 +61,29 @@ os_data_from_path(String8 path, Allocator alloc)
 	return result;
 }
 
+internal String8
+os_map_from_path(String8 path)
+{
+	String8 result = {0};
+
+	OS_Handle file = os_file_open(OS_AccessFlag_Read, path);
+	if (file < 0) return result;
+
+	OS_FileProps props = os_properties_from_file(file);
+	if (props.size && !(props.flags & OS_FileFlag_Directory))
+	{
+		u8 *mem = os_file_map(file, props.size);
+		if (mem)
+		{
+			result.str = mem;
+			result.len = props.size;
+		}
+	}
+
+	os_file_close(file);
+	return result;
+}
+
 internal bool
 os_write_to_path(String8 path, String8 data)
 {
@@ -170,13 +193,17 @@ _gp_aligned_resize(void *p, size_t old_size, size_t new_size, size_t new_alignme
 
 	u8 *new_aligned =
 		(u8 *)AlignPow2((usize)(new_raw + sizeof(void *)), new_alignment);
-	((void **)new_aligned)[-1] = new_raw;
 
-	if (new_aligned != p)
+	// ~geb: realloc kept the old padding, the data sits at the same
+	//       distance from new_raw as it did from old_raw
+	u8 *moved = new_raw + ((u8 *)p - (u8 *)old_raw);
+	if (new_aligned != moved)
 	{
-		MemMove(new_aligned, p, Min(old_size, new_size));
+		MemMove(new_aligned, moved, Min(old_size, new_size));
 	}
 
+	((void **)new_aligned)[-1] = new_raw;
+
 	if (zero_memory && new_size > old_size)
 	{
 		MemZero(new_aligned + old_size, new_size - old_size);
@@ -436,6 +463,15 @@ arena_allocator(usize reserve)
 		.data = arena};
 }
 
+internal void
+arena_allocator_release(Allocator arena)
+{
+	Arena *a = (Arena *)arena.data;
+	if (!a) return;
+
+	os_release(a, sizeof(Arena) + a->reserved);
+}
+
 internal Arena_Scope
 arena_scope_begin(Arena *arena)
 {
@@ -457,6 +493,429 @@ arena_scope_end(Arena_Scope scope)
 	arena->pos = scope.pos;
 }
 
+/////////////////////////////////////////////////////////////////////////
+//                         BYTE SCANNING                               //
+/////////////////////////////////////////////////////////////////////////
+
+// ~geb: scalar kernels work a u64 at a time and are the fallback on any
+//       target. SSE2 is baseline on x64, AVX2 gets picked by mem_scan_init
+//       when the cpu has it. everything is compiled in, only the table changes.
+
+#define SWAR_ONES  0x0101010101010101ull
+#define SWAR_HIGHS 0x8080808080808080ull
+
+force_inline u64 _swar_has_byte(u64 word, u8 byte)
+{
+	u64 x = word ^ (SWAR_ONES * byte);
+	return (x - SWAR_ONES) & ~x & SWAR_HIGHS;
+}
+
+internal usize
+_find_byte_scalar(u8 *ptr, usize len, u8 byte)
+{
+	usize i = 0;
+
+	for (; i + 8 <= len; i += 8) {
+		u64 word;
+		MemMove(&word, ptr + i, 8);
+		if (_swar_has_byte(word, byte)) break;
+	}
+
+	while (i < len && ptr[i] != byte)
+		i++;
+
+	return i;
+}
+
+internal usize
+_find_byte_rev_scalar(u8 *ptr, usize len, u8 byte)
+{
+	usize i = len;
+
+	for (; i >= 8; i -= 8) {
+		u64 word;
+		MemMove(&word, ptr + i - 8, 8);
+		if (_swar_has_byte(word, byte)) break;
+	}
+
+	while (i > 0) {
+		if (ptr[--i] == byte) return i;
+	}
+
+	return len;
+}
+
+internal usize
+_count_byte_scalar(u8 *ptr, usize len, u8 byte)
+{
+	usize count = 0;
+	for (usize i = 0; i < len; ++i)
+		count += (ptr[i] == byte);
+	return count;
+}
+
+internal usize
+_find_non_ascii_scalar(u8 *ptr, usize len)
+{
+	usize i = 0;
+
+	for (; i + 8 <= len; i += 8) {
+		u64 word;
+		MemMove(&word, ptr + i, 8);
+		if (word & SWAR_HIGHS) break;
+	}
+
+	while (i < len && ptr[i] < RUNE_SELF)
+		i++;
+
+	return i;
+}
+
+force_inline bool _pair_at(u8 *ptr, usize i, Mem_Pair *pair)
+{
+	return (ptr[i] | pair->first_fold) == pair->first &&
+		(ptr[i + pair->dist] | pair->last_fold) == pair->last;
+}
+
+internal usize
+_find_pair_scalar(u8 *ptr, usize len, Mem_Pair *pair)
+{
+	if (len <= pair->dist) return len;
+
+	usize n    = len - pair->dist;
+	u64   fold = SWAR_ONES * pair->first_fold;
+	usize i    = 0;
+
+	for (;;) {
+		for (; i + 8 <= n; i += 8) {
+			u64 word;
+			MemMove(&word, ptr + i, 8);
+			if (_swar_has_byte(word | fold, pair->first)) break;
+		}
+
+		for (usize stop = Min(i + 8, n); i < stop; ++i) {
+			if (_pair_at(ptr, i, pair)) return i;
+		}
+
+		if (i >= n) return len;
+	}
+}
+
+internal usize
+_find_pair_rev_scalar(u8 *ptr, usize len, Mem_Pair *pair)
+{
+	if (len <= pair->dist) return len;
+
+	u64   fold = SWAR_ONES * pair->first_fold;
+	usize i    = len - pair->dist;
+
+	for (;;) {
+		for (; i >= 8; i -= 8) {
+			u64 word;
+			MemMove(&word, ptr + i - 8, 8);
+			if (_swar_has_byte(word | fold, pair->first)) break;
+		}
+
+		for (usize stop = i >= 8 ? i - 8 : 0; i > stop;) {
+			if (_pair_at(ptr, --i, pair)) return i;
+		}
+
+		if (!i) return len;
+	}
+}
+
+#if MEM_SCAN_X64
+
+internal usize
+_find_byte_sse2(u8 *ptr, usize len, u8 byte)
+{
+	__m128i needle = _mm_set1_epi8((char)byte);
+	usize i = 0;
+
+	for (; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((__m128i *)(ptr + i));
+		u32 mask = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(v, needle));
+		if (mask) return i + (usize)__builtin_ctz(mask);
+	}
+
+	return i + _find_byte_scalar(ptr + i, len - i, byte);
+}
+
+internal usize
+_find_byte_rev_sse2(u8 *ptr, usize len, u8 byte)
+{
+	__m128i needle = _mm_set1_epi8((char)byte);
+	usize i = len;
+
+	for (; i >= 16; i -= 16) {
+		__m128i v = _mm_loadu_si128((__m128i *)(ptr + i - 16));
+		u32 mask = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(v, needle));
+		if (mask) return i - 16 + (usize)(31 - __builtin_clz(mask));
+	}
+
+	usize at = _find_byte_rev_scalar(ptr, i, byte);
+	return at < i ? at : len;
+}
+
+// ~geb: matches are summed as -1 bytes per lane, flushed through a SAD
+//       before any lane can wrap
+internal usize
+_count_byte_sse2(u8 *ptr, usize len, u8 byte)
+{
+	__m128i needle = _mm_set1_epi8((char)byte);
+	__m128i zero   = _mm_setzero_si128();
+	__m128i total  = _mm_setzero_si128();
+	usize i = 0;
+
+	while (i + 16 <= len) {
+		__m128i acc = _mm_setzero_si128();
+		usize stop = Min(len - 15, i + 255 * 16);
+
+		for (; i < stop; i += 16) {
+			__m128i v = _mm_loadu_si128((__m128i *)(ptr + i));
+			acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(v, needle));
+		}
+
+		total = _mm_add_epi64(total, _mm_sad_epu8(acc, zero));
+	}
+
+	usize count = (usize)_mm_cvtsi128_si64(total) + (usize)_mm_cvtsi128_si64(_mm_unpackhi_epi64(total, total));
+	return count + _count_byte_scalar(ptr + i, len - i, byte);
+}
+
+internal usize
+_find_non_ascii_sse2(u8 *ptr, usize len)
+{
+	usize i = 0;
+
+	for (; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((__m128i *)(ptr + i));
+		u32 mask = (u32)_mm_movemask_epi8(v);
+		if (mask) return i + (usize)__builtin_ctz(mask);
+	}
+
+	return i + _find_non_ascii_scalar(ptr + i, len - i);
+}
+
+internal usize
+_find_pair_sse2(u8 *ptr, usize len, Mem_Pair *pair)
+{
+	if (len <= pair->dist) return len;
+
+	__m128i first      = _mm_set1_epi8((char)pair->first);
+	__m128i last       = _mm_set1_epi8((char)pair->last);
+	__m128i first_fold = _mm_set1_epi8((char)pair->first_fold);
+	__m128i last_fold  = _mm_set1_epi8((char)pair->last_fold);
+
+	usize n = len - pair->dist;
+	usize i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		__m128i a = _mm_or_si128(_mm_loadu_si128((__m128i *)(ptr + i)), first_fold);
+		__m128i b = _mm_or_si128(_mm_loadu_si128((__m128i *)(ptr + i + pair->dist)), last_fold);
+		u32 mask = (u32)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+		if (mask) return i + (usize)__builtin_ctz(mask);
+	}
+
+	usize at = _find_pair_scalar(ptr + i, len - i, pair);
+	return at < len - i ? i + at : len;
+}
+
+internal usize
+_find_pair_rev_sse2(u8 *ptr, usize len, Mem_Pair *pair)
+{
+	if (len <= pair->dist) return len;
+
+	__m128i first      = _mm_set1_epi8((char)pair->first);
+	__m128i last       = _mm_set1_epi8((char)pair->last);
+	__m128i first_fold = _mm_set1_epi8((char)pair->first_fold);
+	__m128i last_fold  = _mm_set1_epi8((char)pair->last_fold);
+
+	usize i = len - pair->dist;
+
+	for (; i >= 16; i -= 16) {
+		__m128i a = _mm_or_si128(_mm_loadu_si128((__m128i *)(ptr + i - 16)), first_fold);
+		__m128i b = _mm_or_si128(_mm_loadu_si128((__m128i *)(ptr + i - 16 + pair->dist)), last_fold);
+		u32 mask = (u32)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+		if (mask) return i - 16 + (usize)(31 - __builtin_clz(mask));
+	}
+
+	usize at = _find_pair_rev_scalar(ptr, i + pair->dist, pair);
+	return at < i ? at : len;
+}
+
+#define MEM_SCAN_AVX2 __attribute__((target("avx2")))
+
+MEM_SCAN_AVX2 internal usize
+_find_byte_avx2(u8 *ptr, usize len, u8 byte)
+{
+	__m256i needle = _mm256_set1_epi8((char)byte);
+	usize i = 0;
+
+	for (; i + 32 <= len; i += 32) {
+		__m256i v = _mm256_loadu_si256((__m256i *)(ptr + i));
+		u32 mask = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle));
+		if (mask) return i + (usize)__builtin_ctz(mask);
+	}
+
+	return i + _find_byte_sse2(ptr + i, len - i, byte);
+}
+
+MEM_SCAN_AVX2 internal usize
+_find_byte_rev_avx2(u8 *ptr, usize len, u8 byte)
+{
+	__m256i needle = _mm256_set1_epi8((char)byte);
+	usize i = len;
+
+	for (; i >= 32; i -= 32) {
+		__m256i v = _mm256_loadu_si256((__m256i *)(ptr + i - 32));
+		u32 mask = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle));
+		if (mask) return i - 32 + (usize)(31 - __builtin_clz(mask));
+	}
+
+	usize at = _find_byte_rev_sse2(ptr, i, byte);
+	return at < i ? at : len;
+}
+
+MEM_SCAN_AVX2 internal usize
+_count_byte_avx2(u8 *ptr, usize len, u8 byte)
+{
+	__m256i needle = _mm256_set1_epi8((char)byte);
+	__m256i zero   = _mm256_setzero_si256();
+	__m256i total  = _mm256_setzero_si256();
+	usize i = 0;
+
+	while (i + 32 <= len) {
+		__m256i acc = _mm256_setzero_si256();
+		usize stop = Min(len - 31, i + 255 * 32);
+
+		for (; i < stop; i += 32) {
+			__m256i v = _mm256_loadu_si256((__m256i *)(ptr + i));
+			acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(v, needle));
+		}
+
+		total = _mm256_add_epi64(total, _mm256_sad_epu8(acc, zero));
+	}
+
+	u64 lanes[4];
+	_mm256_storeu_si256((__m256i *)lanes, total);
+
+	usize count = (usize)(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+	return count + _count_byte_sse2(ptr + i, len - i, byte);
+}
+
+MEM_SCAN_AVX2 internal usize
+_find_non_ascii_avx2(u8 *ptr, usize len)
+{
+	usize i = 0;
+
+	for (; i + 32 <= len; i += 32) {
+		__m256i v = _mm256_loadu_si256((__m256i *)(ptr + i));
+		u32 mask = (u32)_mm256_movemask_epi8(v);
+		if (mask) return i + (usize)__builtin_ctz(mask);
+	}
+
+	return i + _find_non_ascii_sse2(ptr + i, len - i);
+}
+
+MEM_SCAN_AVX2 internal usize
+_find_pair_avx2(u8 *ptr, usize len, Mem_Pair *pair)
+{
+	if (len <= pair->dist) return len;
+
+	__m256i first      = _mm256_set1_epi8((char)pair->first);
+	__m256i last       = _mm256_set1_epi8((char)pair->last);
+	__m256i first_fold = _mm256_set1_epi8((char)pair->first_fold);
+	__m256i last_fold  = _mm256_set1_epi8((char)pair->last_fold);
+
+	usize n = len - pair->dist;
+	usize i = 0;
+
+	for (; i + 32 <= n; i += 32) {
+		__m256i a = _mm256_or_si256(_mm256_loadu_si256((__m256i *)(ptr + i)), first_fold);
+		__m256i b = _mm256_or_si256(_mm256_loadu_si256((__m256i *)(ptr + i + pair->dist)), last_fold);
+		u32 mask = (u32)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+		if (mask) return i + (usize)__builtin_ctz(mask);
+	}
+
+	usize at = _find_pair_sse2(ptr + i, len - i, pair);
+	return at < len - i ? i + at : len;
+}
+
+MEM_SCAN_AVX2 internal usize
+_find_pair_rev_avx2(u8 *ptr, usize len, Mem_Pair *pair)
+{
+	if (len <= pair->dist) return len;
+
+	__m256i first      = _mm256_set1_epi8((char)pair->first);
+	__m256i last       = _mm256_set1_epi8((char)pair->last);
+	__m256i first_fold = _mm256_set1_epi8((char)pair->first_fold);
+	__m256i last_fold  = _mm256_set1_epi8((char)pair->last_fold);
+
+	usize i = len - pair->dist;
+
+	for (; i >= 32; i -= 32) {
+		__m256i a = _mm256_or_si256(_mm256_loadu_si256((__m256i *)(ptr + i - 32)), first_fold);
+		__m256i b = _mm256_or_si256(_mm256_loadu_si256((__m256i *)(ptr + i - 32 + pair->dist)), last_fold);
+		u32 mask = (u32)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+		if (mask) return i - 32 + (usize)(31 - __builtin_clz(mask));
+	}
+
+	usize at = _find_pair_rev_sse2(ptr, i + pair->dist, pair);
+	return at < i ? at : len;
+}
+
+global Mem_Scan_Kernels g_mem_scan = {
+	.find_byte       = _find_byte_sse2,
+	.find_byte_rev   = _find_byte_rev_sse2,
+	.count_byte      = _count_byte_sse2,
+	.find_non_ascii  = _find_non_ascii_sse2,
+	.find_pair       = _find_pair_sse2,
+	.find_pair_rev   = _find_pair_rev_sse2,
+	.width           = 16,
+};
+
+#else
+
+global Mem_Scan_Kernels g_mem_scan = {
+	.find_byte       = _find_byte_scalar,
+	.find_byte_rev   = _find_byte_rev_scalar,
+	.count_byte      = _count_byte_scalar,
+	.find_non_ascii  = _find_non_ascii_scalar,
+	.find_pair       = _find_pair_scalar,
+	.find_pair_rev   = _find_pair_rev_scalar,
+	.width           = 8,
+};
+
+#endif
+
+internal void
+mem_scan_init(void)
+{
+#if MEM_SCAN_X64
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2")) {
+		g_mem_scan = (Mem_Scan_Kernels){
+			.find_byte       = _find_byte_avx2,
+			.find_byte_rev   = _find_byte_rev_avx2,
+			.count_byte      = _count_byte_avx2,
+			.find_non_ascii  = _find_non_ascii_avx2,
+			.find_pair       = _find_pair_avx2,
+			.find_pair_rev   = _find_pair_rev_avx2,
+			.width           = 32,
+		};
+	}
+#endif
+}
+
+internal usize mem_find_byte(u8 *ptr, usize len, u8 byte)     { return g_mem_scan.find_byte(ptr, len, byte); }
+internal usize mem_find_byte_rev(u8 *ptr, usize len, u8 byte) { return g_mem_scan.find_byte_rev(ptr, len, byte); }
+internal usize mem_count_byte(u8 *ptr, usize len, u8 byte)    { return g_mem_scan.count_byte(ptr, len, byte); }
+internal usize mem_find_non_ascii(u8 *ptr, usize len)         { return g_mem_scan.find_non_ascii(ptr, len); }
+internal usize mem_find_pair(u8 *ptr, usize len, Mem_Pair *pair)     { return g_mem_scan.find_pair(ptr, len, pair); }
+internal usize mem_find_pair_rev(u8 *ptr, usize len, Mem_Pair *pair) { return g_mem_scan.find_pair_rev(ptr, len, pair); }
+
 /////////////////////////////////////////////////////////////////////////
 //                            STRINGS                                  //
 /////////////////////////////////////////////////////////////////////////
@@ -550,6 +1009,41 @@ out_of_range:
 	return 0;
 }
 
+internal usize
+utf8_encode(rune cp, u8 out[4])
+{
+	if (cp <= 0x7F) {
+		out[0] = (u8)cp;
+		return 1;
+	}
+	if (cp <= 0x7FF) {
+		out[0] = (u8)(0xC0 | (cp >> 6));
+		out[1] = (u8)(0x80 | (cp & 0x3F));
+		return 2;
+	}
+	if (cp <= 0xFFFF) {
+		out[0] = (u8)(0xE0 | (cp >> 12));
+		out[1] = (u8)(0x80 | ((cp >> 6) & 0x3F));
+		out[2] = (u8)(0x80 | (cp & 0x3F));
+		return 3;
+	}
+	if (cp <= MAX_RUNE) {
+		out[0] = (u8)(0xF0 | (cp >> 18));
+		out[1] = (u8)(0x80 | ((cp >> 12) & 0x3F));
+		out[2] = (u8)(0x80 | ((cp >> 6) & 0x3F));
+		out[3] = (u8)(0x80 | (cp & 0x3F));
+		return 4;
+	}
+	return 0;
+}
+
+// ~geb: number of leading bytes below 0x80
+internal usize
+utf8_ascii_run(u8 *ptr, usize len)
+{
+	return mem_find_non_ascii(ptr, len);
+}
+
 internal usize
 utf8_codepoint_size(rune cp)
 {
@@ -717,11 +1211,20 @@ str8_concat(String8 s1, String8 s2, Allocator alloc)
 internal isize
 find_left(String8 str, rune c)
 {
-	for(Str_Iterator itr = {0}; str8_iter(str, &itr);)
-	{
-		if (itr.codepoint == c) {
-			return cast(isize)(itr.ptr - str.str);
-		}
+	// ~geb: a lead byte never shows up inside another codepoint, so hunting
+	//       for the first byte and checking the rest is enough
+	u8 enc[4];
+	usize n = utf8_encode(c, enc);
+	if (!n) return -1;
+
+	usize at = 0;
+	while (at + n <= str.len) {
+		at += mem_find_byte(str.str + at, str.len - at, enc[0]);
+		if (at + n > str.len) break;
+
+		if (MemCompare(str.str + at, enc, n) == 0)
+			return cast(isize) at;
+		at++;
 	}
 	return -1;
 }
@@ -729,23 +1232,20 @@ find_left(String8 str, rune c)
 internal isize
 find_right(String8 str, rune target)
 {
-    u8 *p = str.str + str.len;
-
-    while (p > str.str) {
-        p -= 1;
-
-        while (p > str.str && (*p & 0xC0) == RUNE_SELF) {
-            p -= 1;
-        }
-
-        Str_Iterator itr = { .ptr = p };
-        str8_iter(str, &itr);
-
-        if (itr.codepoint == target) {
-            return (isize)(p - str.str);
-        }
-    }
-    return -1;
+	u8 enc[4];
+	usize n = utf8_encode(target, enc);
+	if (!n) return -1;
+
+	usize end = str.len;
+	while (end) {
+		usize at = mem_find_byte_rev(str.str, end, enc[0]);
+		if (at == end) break;
+
+		if (at + n <= str.len && MemCompare(str.str + at, enc, n) == 0)
+			return cast(isize) at;
+		end = at;
+	}
+	return -1;
 }
 
 internal String8_List
@@ -1073,3 +1573,1313 @@ dynamic_array_clear(Dynamic_Array *arr)
 {
 	arr->len = 0;
 }
+
+/////////////////////////////////////////////////////////////////////////
+//                              GAP TREE                               //
+/////////////////////////////////////////////////////////////////////////
+
+internal u8 *
+_gap_tree_at(Gap_Tree *t, usize n)
+{
+	return t->nodes + n * t->size;
+}
+
+internal void
+gap_tree_delete(Gap_Tree *t)
+{
+	if (t->nodes) mem_free(t->alloc, t->nodes, NULL);
+
+	t->nodes  = NULL;
+	t->cap    = 0;
+	t->before = 0;
+	t->after  = 0;
+}
+
+internal usize
+gap_tree_count(Gap_Tree *t)
+{
+	return t->before + (t->cap - t->after);
+}
+
+internal usize
+gap_tree_leaf(Gap_Tree *t, usize i)
+{
+	return i < t->before ? i : i + (t->after - t->before);
+}
+
+internal usize
+gap_tree_logical(Gap_Tree *t, usize leaf)
+{
+	return leaf < t->before ? leaf : leaf - (t->after - t->before);
+}
+
+internal void
+gap_tree_fix(Gap_Tree *t, usize lo, usize hi)
+{
+	if (lo >= hi) return;
+
+	usize a = (t->cap + lo) >> 1;
+	usize b = (t->cap + hi - 1) >> 1;
+
+	for (; a; a >>= 1, b >>= 1) {
+		for (usize n = a; n <= b; ++n)
+			t->join(_gap_tree_at(t, n), _gap_tree_at(t, 2 * n), _gap_tree_at(t, 2 * n + 1));
+	}
+}
+
+internal void
+gap_tree_set(Gap_Tree *t, usize leaf, void *node)
+{
+	MemMove(_gap_tree_at(t, t->cap + leaf), node, t->size);
+	gap_tree_fix(t, leaf, leaf + 1);
+}
+
+internal bool
+gap_tree_grow(Gap_Tree *t)
+{
+	usize cap = Max(t->cap * 2, 64);
+
+	Alloc_Error err = 0;
+	u8 *nodes = cast(u8 *) mem_alloc_aligned(t->alloc, 2 * cap * t->size, t->align, true, &err);
+	if (err) return false;
+
+	usize tail  = t->cap - t->after;
+	usize after = cap - tail;
+	if (t->nodes) {
+		MemMove(nodes + cap * t->size, _gap_tree_at(t, t->cap), t->before * t->size);
+		MemMove(nodes + (cap + after) * t->size, _gap_tree_at(t, t->cap + t->after), tail * t->size);
+		mem_free(t->alloc, t->nodes, NULL);
+	}
+
+	t->nodes = nodes;
+	t->cap   = cap;
+	t->after = after;
+	gap_tree_fix(t, 0, cap);
+	return true;
+}
+
+internal void
+gap_tree_gap_to(Gap_Tree *t, usize i)
+{
+	u8 *leaf = _gap_tree_at(t, t->cap);
+	usize size   = t->size;
+	usize before = t->before;
+	usize after  = t->after;
+
+	if (i < before) {
+		usize m = before - i;
+		MemMove(leaf + (after - m) * size, leaf + i * size, m * size);
+		MemZero(leaf + i * size, Min(m, after - before) * size);
+
+		t->before = i;
+		t->after  = after - m;
+		gap_tree_fix(t, i, i + Min(m, after - before));
+		gap_tree_fix(t, after - m, after);
+	}
+	else if (i > before) {
+		usize m = i - before;
+		MemMove(leaf + before * size, leaf + after * size, m * size);
+		usize zero = Max(i, after);
+		MemZero(leaf + zero * size, (after + m - zero) * size);
+
+		t->before = i;
+		t->after  = after + m;
+		gap_tree_fix(t, before, i);
+		gap_tree_fix(t, zero, after + m);
+	}
+}
+
+internal bool
+gap_tree_push(Gap_Tree *t, void *node)
+{
+	if (t->before == t->after && !gap_tree_grow(t)) return false;
+	gap_tree_set(t, t->before++, node);
+	return true;
+}
+
+internal void
+gap_tree_drop(Gap_Tree *t, usize count)
+{
+	Assert(count <= t->cap - t->after);
+
+	MemZero(_gap_tree_at(t, t->cap + t->after), count * t->size);
+	t->after += count;
+	gap_tree_fix(t, t->after - count, t->after);
+}
+
+/////////////////////////////////////////////////////////////////////////
+//                              REGEX                                  //
+/////////////////////////////////////////////////////////////////////////
+
+// ~geb: a pattern is parsed to a small tree and compiled twice, front to
+//       back and back to front, into thompson programs over bytes. scans
+//       step sets of program counters, and the sets they run into are
+//       cached as states of a dfa built one transition at a time, the first
+//       time it is taken. the cache is an arena that is wiped when it fills
+//       up, a pattern that keeps wiping it without getting anywhere makes
+//       the scan step the sets directly from then on. either way each byte
+//       is looked at once and the work per byte is bounded by the pattern.
+//
+//       finding a match forward takes two scans: the forward one finds
+//       where the leftmost match ends, the start one runs the reversed
+//       program back from there to find where it begins.
+
+#define REGEX_MAX_PATTERN   Kb(8)
+#define REGEX_MAX_DEPTH     256
+#define REGEX_MAX_REPEAT    1000
+#define REGEX_MAX_INSTS     Kb(64)
+#define REGEX_DFA_CACHE     Mb(1)
+#define REGEX_DFA_TABLE     4096 // power of two
+#define REGEX_MATCH_BIT     0x80000000u // set on cached transitions that complete a match
+#define REGEX_DEAD_BIT      0x40000000u // and on the ones into a state nothing can come out of
+#define REGEX_REPEAT_INF    U32_MAX
+#define REGEX_BYTES_PER_STATE 16 // a wipe sooner than this per cached state was a bad one
+#define REGEX_MAX_BAD_CLEARS  3
+#define REGEX_SKIP_REACH      16 // fixed bytes looked at for the skip pair
+
+typedef struct {
+	u64 bits[4];
+} Re_Class;
+
+typedef u8 Re_Kind;
+enum {
+	Re_Empty = 0,
+	Re_Bytes,
+	Re_Cat,
+	Re_Alt,
+	Re_Repeat,
+	Re_Line_Start,
+	Re_Line_End,
+};
+
+typedef struct {
+	Re_Kind kind;
+	bool    lazy;
+	u32     a;   // first child, the class of Re_Bytes
+	u32     b;
+	u32     min;
+	u32     max;
+} Re_Node;
+
+typedef u8 Re_Op;
+enum {
+	Re_Op_Byte = 0,
+	Re_Op_Split, // x is tried before y
+	Re_Op_Jmp,
+	Re_Op_Match,
+	Re_Op_Line_Start,
+	Re_Op_Line_End,
+};
+
+typedef struct {
+	Re_Op op;
+	u32   x;
+	u32   y;
+} Re_Inst;
+
+typedef struct {
+	Re_Inst *insts;
+	u32      count;
+	bool     line_start; // states have to remember whether they sit at a line start
+} Re_Prog;
+
+typedef u8 Re_State_Flags;
+enum {
+	Re_State_Line_Start = Bit(0),
+	Re_State_Matched    = Bit(1), // no new match may start anymore
+	Re_State_Dead       = Bit(2),
+};
+
+typedef struct {
+	u32           *pcs;
+	u32            count;
+	Re_State_Flags flags;
+} Re_Threads;
+
+typedef struct {
+	u32            hash;
+	u32            count;
+	Re_State_Flags flags;
+	u32            next[257]; // by byte, 256 is the edge of the text. 0 until taken
+	u32            pcs[];
+} Re_State;
+
+typedef struct {
+	Allocator cache; // arena, states are addressed by their offset in it
+	u32      *table;
+	u32       states;
+	u32       idle;  // the state that waits for a match to begin
+} Re_Dfa;
+
+struct Regex {
+	Allocator alloc;
+
+	Re_Class *classes;
+	u32       class_count;
+	Re_Prog   prog[2]; // front to back, back to front
+
+	Re_Dfa   dfa[Regex_Scan_Kind_Count];
+	Mem_Pair skip[Regex_Scan_Kind_Count]; // the only bytes that leave the idle state
+	bool     has_skip[Regex_Scan_Kind_Count];
+
+	// ~geb: scratch for stepping, sized by the program
+	u32 *sparse;
+	u32 *dense;
+	u32  visited;
+	u32 *stack;
+	u32 *out;
+	Re_Threads nfa;
+	u32 *nfa_pcs[2];
+};
+
+force_inline void
+_re_class_set(Re_Class *c, u8 b)
+{
+	c->bits[b >> 6] |= 1ull << (b & 63);
+}
+
+force_inline bool
+_re_class_has(Re_Class *c, u8 b)
+{
+	return (c->bits[b >> 6] >> (b & 63)) & 1;
+}
+
+internal void
+_re_class_range(Re_Class *c, u8 lo, u8 hi)
+{
+	for (u32 b = lo; b <= hi; ++b)
+		_re_class_set(c, cast(u8) b);
+}
+
+internal void
+_re_class_fold(Re_Class *c)
+{
+	for (u8 b = 'a'; b <= 'z'; ++b) {
+		if (_re_class_has(c, b) || _re_class_has(c, b - 0x20)) {
+			_re_class_set(c, b);
+			_re_class_set(c, b - 0x20);
+		}
+	}
+}
+
+///////////////////////////////////////////////
+// ~geb: parsing
+
+typedef struct {
+	u8           *at;
+	u8           *end;
+	bool          fold;
+	Dynamic_Array nodes;   // Re_Node
+	Dynamic_Array classes; // Re_Class
+	char         *error;
+	u32           depth;
+} Re_Parser;
+
+internal u32
+_re_node(Re_Parser *p, Re_Node node)
+{
+	usize len = p->nodes.len;
+	dyn_arr_append(&p->nodes, Re_Node, node);
+	if (p->nodes.len == len) p->error = "out of memory";
+	return cast(u32) len;
+}
+
+internal u32
+_re_bytes(Re_Parser *p, Re_Class cls)
+{
+	if (p->fold) _re_class_fold(&cls);
+
+	usize len = p->classes.len;
+	dyn_arr_append(&p->classes, Re_Class, cls);
+	if (p->classes.len == len) p->error = "out of memory";
+
+	return _re_node(p, (Re_Node){ .kind = Re_Bytes, .a = cast(u32) len });
+}
+
+internal u32
+_re_byte(Re_Parser *p, u8 b)
+{
+	Re_Class cls = {0};
+	_re_class_set(&cls, b);
+	return _re_bytes(p, cls);
+}
+
+internal u32
+_re_pair(Re_Parser *p, Re_Kind kind, u32 a, u32 b)
+{
+	return _re_node(p, (Re_Node){ .kind = kind, .a = a, .b = b });
+}
+
+// ~geb: one whole codepoint: an ascii byte from `ascii` or any multi byte sequence
+internal u32
+_re_any_codepoint(Re_Parser *p, Re_Class ascii)
+{
+	Re_Class cont = {0}, lead2 = {0}, lead3 = {0}, lead4 = {0};
+	_re_class_range(&cont,  0x80, 0xbf);
+	_re_class_range(&lead2, 0xc0, 0xdf);
+	_re_class_range(&lead3, 0xe0, 0xef);
+	_re_class_range(&lead4, 0xf0, 0xf7);
+
+	u32 c = _re_bytes(p, cont);
+	u32 n = _re_pair(p, Re_Cat, _re_bytes(p, lead2), c);
+	n = _re_pair(p, Re_Alt, n, _re_pair(p, Re_Cat, _re_bytes(p, lead3), _re_pair(p, Re_Cat, c, c)));
+	n = _re_pair(p, Re_Alt, n, _re_pair(p, Re_Cat, _re_bytes(p, lead4), _re_pair(p, Re_Cat, c, _re_pair(p, Re_Cat, c, c))));
+
+	return _re_pair(p, Re_Alt, _re_bytes(p, ascii), n);
+}
+
+// ~geb: the ascii half of a negated class, never a newline
+internal Re_Class
+_re_class_negate(Re_Class cls)
+{
+	Re_Class out = {0};
+	for (u8 b = 0; b < 0x80; ++b) {
+		if (!_re_class_has(&cls, b) && b != '\n') _re_class_set(&out, b);
+	}
+	return out;
+}
+
+// ~geb: \d \w \s and their negations, false for any other escape
+internal bool
+_re_escape_class(u8 e, Re_Class *cls, bool *negate)
+{
+	Re_Class c = {0};
+
+	switch (e | 0x20) {
+	case 'd':
+		_re_class_range(&c, '0', '9');
+		break;
+	case 'w':
+		_re_class_range(&c, 'a', 'z');
+		_re_class_range(&c, 'A', 'Z');
+		_re_class_range(&c, '0', '9');
+		_re_class_set(&c, '_');
+		break;
+	case 's':
+		_re_class_set(&c, ' ');
+		_re_class_range(&c, '\t', '\r');
+		break;
+	default:
+		return false;
+	}
+
+	*cls    = c;
+	*negate = (e & 0x20) == 0;
+	return true;
+}
+
+// ~geb: a single escaped byte, -1 when the escape is not one
+internal i32
+_re_escape_byte(u8 e)
+{
+	switch (e) {
+	case 'n': return '\n';
+	case 't': return '\t';
+	case 'r': return '\r';
+	case 'f': return '\f';
+	case 'v': return '\v';
+	case '0': return 0;
+	}
+
+	if (e < 0x80 && !Is_Between('a', e | 0x20, 'z') && !Is_Between('0', e, '9'))
+		return e;
+	return -1;
+}
+
+// ~geb: the bytes of the codepoint at p->at, one after the other
+internal u32
+_re_literal(Re_Parser *p)
+{
+	usize size = Min(cast(usize) UTF8_LEN_TABLE[*p->at], cast(usize) (p->end - p->at));
+
+	u32 n = _re_byte(p, *p->at++);
+	for (usize i = 1; i < size; ++i)
+		n = _re_pair(p, Re_Cat, n, _re_byte(p, *p->at++));
+
+	return n;
+}
+
+internal u32
+_re_parse_class(Re_Parser *p)
+{
+	bool negate = p->at < p->end && *p->at == '^';
+	if (negate) p->at++;
+
+	Re_Class cls   = {0};
+	u32      multi = U32_MAX; // alternatives for non-ascii members
+	bool     first = true;
+
+	while (p->at < p->end && (*p->at != ']' || first)) {
+		first = false;
+
+		i32 lo = *p->at;
+		if (lo == '\\') {
+			if (++p->at == p->end) break;
+
+			Re_Class esc;
+			bool     esc_negate;
+			if (_re_escape_class(*p->at, &esc, &esc_negate)) {
+				if (esc_negate) esc = _re_class_negate(esc);
+				for (u32 i = 0; i < 4; ++i) cls.bits[i] |= esc.bits[i];
+				p->at++;
+				continue;
+			}
+
+			lo = _re_escape_byte(*p->at);
+			if (lo < 0) {
+				p->error = "unknown escape";
+				return 0;
+			}
+		} else if (lo >= 0x80) {
+			if (negate) {
+				p->error = "non-ascii in a negated class";
+				return 0;
+			}
+
+			u32 n = _re_literal(p);
+			multi = multi == U32_MAX ? n : _re_pair(p, Re_Alt, multi, n);
+			continue;
+		}
+		p->at++;
+
+		i32 hi = lo;
+		if (p->end - p->at >= 2 && p->at[0] == '-' && p->at[1] != ']') {
+			p->at++;
+			hi = *p->at++;
+			if (hi == '\\' && p->at < p->end) hi = _re_escape_byte(*p->at++);
+
+			if (hi < lo || hi >= 0x80) {
+				p->error = "bad class range";
+				return 0;
+			}
+		}
+
+		_re_class_range(&cls, cast(u8) lo, cast(u8) hi);
+	}
+
+	if (p->at == p->end) {
+		p->error = "missing ]";
+		return 0;
+	}
+	p->at++;
+
+	if (negate) {
+		if (p->fold) _re_class_fold(&cls);
+		return _re_any_codepoint(p, _re_class_negate(cls));
+	}
+
+	u32 n = _re_bytes(p, cls);
+	return multi == U32_MAX ? n : _re_pair(p, Re_Alt, n, multi);
+}
+
+internal u32 _re_parse_alt(Re_Parser *p);
+
+internal u32
+_re_parse_atom(Re_Parser *p)
+{
+	u8 c = *p->at;
+
+	switch (c) {
+	case '(': {
+		p->at++;
+		if (p->end - p->at >= 2 && p->at[0] == '?' && p->at[1] == ':') p->at += 2;
+
+		if (++p->depth > REGEX_MAX_DEPTH) {
+			p->error = "groups nested too deep";
+			return 0;
+		}
+
+		u32 n = _re_parse_alt(p);
+		p->depth--;
+
+		if (p->at == p->end || *p->at != ')') {
+			if (!p->error) p->error = "missing )";
+			return 0;
+		}
+		p->at++;
+		return n;
+	}
+
+	case '[':
+		p->at++;
+		return _re_parse_class(p);
+
+	case '.': {
+		p->at++;
+		Re_Class all = {0};
+		return _re_any_codepoint(p, _re_class_negate(all));
+	}
+
+	case '^':
+		p->at++;
+		return _re_node(p, (Re_Node){ .kind = Re_Line_Start });
+
+	case '$':
+		p->at++;
+		return _re_node(p, (Re_Node){ .kind = Re_Line_End });
+
+	case '\\': {
+		if (++p->at == p->end) {
+			p->error = "trailing \\";
+			return 0;
+		}
+
+		Re_Class cls;
+		bool     negate;
+		if (_re_escape_class(*p->at, &cls, &negate)) {
+			p->at++;
+			return negate ? _re_any_codepoint(p, _re_class_negate(cls)) : _re_bytes(p, cls);
+		}
+
+		i32 b = _re_escape_byte(*p->at++);
+		if (b < 0) {
+			p->error = "unknown escape";
+			return 0;
+		}
+		return _re_byte(p, cast(u8) b);
+	}
+
+	case '*': case '+': case '?': case '{':
+		p->error = "nothing to repeat";
+		return 0;
+	}
+
+	return _re_literal(p);
+}
+
+internal bool
+_re_parse_count(Re_Parser *p, u32 *out)
+{
+	u8 *start = p->at;
+	u32 n = 0;
+
+	while (p->at < p->end && Is_Between('0', *p->at, '9')) {
+		n = n * 10 + (*p->at++ - '0');
+		if (n > REGEX_MAX_REPEAT) return false;
+	}
+
+	*out = n;
+	return p->at > start;
+}
+
+internal u32
+_re_parse_repeat(Re_Parser *p)
+{
+	u32 n = _re_parse_atom(p);
+
+	while (!p->error && p->at < p->end) {
+		u32 min, max;
+
+		switch (*p->at) {
+		case '*': min = 0; max = REGEX_REPEAT_INF; p->at++; break;
+		case '+': min = 1; max = REGEX_REPEAT_INF; p->at++; break;
+		case '?': min = 0; max = 1;                p->at++; break;
+
+		case '{':
+			p->at++;
+			if (!_re_parse_count(p, &min)) goto bad;
+
+			max = min;
+			if (p->at < p->end && *p->at == ',') {
+				p->at++;
+				max = REGEX_REPEAT_INF;
+				if (p->at < p->end && *p->at != '}' && (!_re_parse_count(p, &max) || max < min)) goto bad;
+			}
+
+			if (p->at == p->end || *p->at++ != '}') goto bad;
+			break;
+
+		default:
+			return n;
+		}
+
+		bool lazy = p->at < p->end && *p->at == '?';
+		if (lazy) p->at++;
+
+		n = _re_node(p, (Re_Node){ .kind = Re_Repeat, .lazy = lazy, .a = n, .min = min, .max = max });
+	}
+
+	return n;
+
+bad:
+	p->error = "bad repeat count";
+	return 0;
+}
+
+internal u32
+_re_parse_cat(Re_Parser *p)
+{
+	u32 n = U32_MAX;
+
+	while (!p->error && p->at < p->end && *p->at != '|' && *p->at != ')') {
+		u32 r = _re_parse_repeat(p);
+		n = n == U32_MAX ? r : _re_pair(p, Re_Cat, n, r);
+	}
+
+	return n == U32_MAX ? _re_node(p, (Re_Node){ .kind = Re_Empty }) : n;
+}
+
+internal u32
+_re_parse_alt(Re_Parser *p)
+{
+	u32 n = _re_parse_cat(p);
+
+	while (!p->error && p->at < p->end && *p->at == '|') {
+		p->at++;
+		n = _re_pair(p, Re_Alt, n, _re_parse_cat(p));
+	}
+
+	return n;
+}
+
+///////////////////////////////////////////////
+// ~geb: compiling
+
+typedef struct {
+	Re_Node      *nodes;
+	Dynamic_Array insts; // Re_Inst
+	bool          reverse;
+	bool          line_start;
+	char         *error;
+} Re_Compiler;
+
+force_inline Re_Inst *
+_re_inst(Re_Compiler *c, u32 pc)
+{
+	return &dyn_arr_data(&c->insts, Re_Inst)[pc];
+}
+
+force_inline u32
+_re_pc(Re_Compiler *c)
+{
+	return cast(u32) c->insts.len;
+}
+
+internal u32
+_re_emit(Re_Compiler *c, Re_Op op, u32 x, u32 y)
+{
+	usize len = c->insts.len;
+	if (len == REGEX_MAX_INSTS) {
+		c->error = "pattern too large";
+		return 0;
+	}
+
+	dyn_arr_append(&c->insts, Re_Inst, ((Re_Inst){ .op = op, .x = x, .y = y }));
+	if (c->insts.len == len) {
+		c->error = "out of memory";
+		return 0;
+	}
+
+	return cast(u32) len;
+}
+
+internal void
+_re_compile(Re_Compiler *c, u32 index)
+{
+	if (c->error) return;
+	Re_Node *n = &c->nodes[index];
+
+	switch (n->kind) {
+	case Re_Empty:
+		break;
+
+	case Re_Bytes:
+		_re_emit(c, Re_Op_Byte, n->a, 0);
+		break;
+
+	case Re_Cat:
+		_re_compile(c, c->reverse ? n->b : n->a);
+		_re_compile(c, c->reverse ? n->a : n->b);
+		break;
+
+	case Re_Alt: {
+		u32 split = _re_emit(c, Re_Op_Split, 0, 0);
+		_re_inst(c, split)->x = _re_pc(c);
+		_re_compile(c, n->a);
+
+		u32 jmp = _re_emit(c, Re_Op_Jmp, 0, 0);
+		_re_inst(c, split)->y = _re_pc(c);
+		_re_compile(c, n->b);
+
+		_re_inst(c, jmp)->x = _re_pc(c);
+	} break;
+
+	// ~geb: a back to front scan sees a line start where the front to back one sees its end
+	case Re_Line_Start:
+	case Re_Line_End: {
+		bool start = (n->kind == Re_Line_Start) != c->reverse;
+		_re_emit(c, start ? Re_Op_Line_Start : Re_Op_Line_End, 0, 0);
+		c->line_start |= start;
+	} break;
+
+	case Re_Repeat: {
+		for (u32 i = 0; i < n->min; ++i)
+			_re_compile(c, n->a);
+
+		if (n->max == REGEX_REPEAT_INF) {
+			u32 split = _re_emit(c, Re_Op_Split, 0, 0);
+			u32 body  = _re_pc(c);
+
+			_re_compile(c, n->a);
+			_re_emit(c, Re_Op_Jmp, split, 0);
+			if (c->error) break;
+
+			Re_Inst *inst = _re_inst(c, split);
+			inst->x = n->lazy ? _re_pc(c) : body;
+			inst->y = n->lazy ? body : _re_pc(c);
+			break;
+		}
+
+		// ~geb: optional copies, their splits out are chained through `y`
+		//       until the end is known
+		u32 chain = U32_MAX;
+		for (u32 i = n->min; i < n->max && !c->error; ++i) {
+			u32 split = _re_emit(c, Re_Op_Split, 0, chain);
+			_re_inst(c, split)->x = _re_pc(c);
+			chain = split;
+			_re_compile(c, n->a);
+		}
+
+		while (!c->error && chain != U32_MAX) {
+			Re_Inst *inst = _re_inst(c, chain);
+			chain = inst->y;
+
+			inst->y = _re_pc(c);
+			if (n->lazy) {
+				u32 body = inst->x;
+				inst->x  = inst->y;
+				inst->y  = body;
+			}
+		}
+	} break;
+	}
+}
+
+///////////////////////////////////////////////
+// ~geb: stepping
+
+// ~geb: follows everything that does not consume a byte from `pc`, in the
+//       order the program prefers it
+internal void
+_re_closure(Regex *re, Re_Prog *prog, u32 pc, bool line_start, bool line_end)
+{
+	u32 top = 0;
+	re->stack[top++] = pc;
+
+	while (top) {
+		pc = re->stack[--top];
+
+		u32 slot = re->sparse[pc];
+		if (slot < re->visited && re->dense[slot] == pc) continue;
+
+		re->sparse[pc] = re->visited;
+		re->dense[re->visited++] = pc;
+
+		Re_Inst *inst = &prog->insts[pc];
+		switch (inst->op) {
+		case Re_Op_Jmp:
+			re->stack[top++] = inst->x;
+			break;
+		case Re_Op_Split:
+			re->stack[top++] = inst->y;
+			re->stack[top++] = inst->x;
+			break;
+		case Re_Op_Line_Start:
+			if (line_start) re->stack[top++] = pc + 1;
+			break;
+		case Re_Op_Line_End:
+			if (line_end) re->stack[top++] = pc + 1;
+			break;
+		}
+	}
+}
+
+// ~geb: steps `in` over `c`, -1 being the edge of the text. returns whether
+//       a match ends right in front of `c`
+internal bool
+_re_step(Regex *re, Regex_Scan_Kind kind, Re_Threads *in, i32 c, Re_Threads *out)
+{
+	// ~geb: only a forward scan cares which match is preferred, the others
+	//       keep every thread alive, a back scan ignores the match at its start
+	Re_Prog *prog = &re->prog[kind != Regex_Scan_Forward];
+	bool anchored = kind == Regex_Scan_Start;
+	bool longest  = kind != Regex_Scan_Forward;
+
+	bool line_start = (in->flags & Re_State_Line_Start) != 0;
+	bool line_end   = c < 0 || c == '\n';
+
+	re->visited = 0;
+	for (u32 i = 0; i < in->count; ++i)
+		_re_closure(re, prog, in->pcs[i], line_start, line_end);
+
+	if (!anchored && !(in->flags & Re_State_Matched))
+		_re_closure(re, prog, 0, line_start, line_end);
+
+	bool match = false;
+	out->count = 0;
+
+	for (u32 i = 0; i < re->visited; ++i) {
+		u32      pc   = re->dense[i];
+		Re_Inst *inst = &prog->insts[pc];
+
+		if (inst->op == Re_Op_Match) {
+			match = true;
+			if (!longest) break; // ~geb: whatever comes after it is less preferred
+		} else if (inst->op == Re_Op_Byte && c >= 0 && _re_class_has(&re->classes[inst->x], cast(u8) c)) {
+			out->pcs[out->count++] = pc + 1;
+		}
+	}
+
+	out->flags = 0;
+	if (prog->line_start && c == '\n')
+		out->flags |= Re_State_Line_Start;
+	if (!longest && (match || (in->flags & Re_State_Matched)))
+		out->flags |= Re_State_Matched;
+	if (!out->count && (anchored || (out->flags & Re_State_Matched)))
+		out->flags |= Re_State_Dead;
+
+	return match;
+}
+
+///////////////////////////////////////////////
+// ~geb: lazy dfa
+
+force_inline Re_State *
+_re_state(Re_Dfa *dfa, u32 offset)
+{
+	Arena *arena = cast(Arena *) dfa->cache.data;
+	return cast(Re_State *) (arena->base + offset);
+}
+
+// ~geb: the state for `t`, made if it is new. 0 when the cache is full
+internal u32
+_re_intern(Re_Dfa *dfa, Re_Threads *t)
+{
+	u32 hash = 2166136261u ^ t->flags;
+	for (u32 i = 0; i < t->count; ++i)
+		hash = (hash ^ t->pcs[i]) * 16777619u;
+
+	u32 mask = REGEX_DFA_TABLE - 1;
+	u32 slot = hash & mask;
+
+	for (; dfa->table[slot]; slot = (slot + 1) & mask) {
+		Re_State *s = _re_state(dfa, dfa->table[slot]);
+		if (s->hash == hash && s->count == t->count && s->flags == t->flags &&
+			MemCompare(s->pcs, t->pcs, t->count * sizeof(u32)) == 0)
+		{
+			return dfa->table[slot];
+		}
+	}
+
+	if (dfa->states >= REGEX_DFA_TABLE / 4 * 3) return 0;
+
+	Alloc_Error err = 0;
+	Re_State *s = cast(Re_State *) mem_alloc_aligned(dfa->cache, sizeof(Re_State) + t->count * sizeof(u32), AlignOf(Re_State), false, &err);
+	if (err) return 0;
+
+	s->hash  = hash;
+	s->count = t->count;
+	s->flags = t->flags;
+	MemZero(s->next, sizeof(s->next));
+	if (t->count) MemMove(s->pcs, t->pcs, t->count * sizeof(u32));
+
+	Arena *arena = cast(Arena *) dfa->cache.data;
+	dfa->table[slot] = cast(u32) (cast(u8 *) s - arena->base);
+	dfa->states++;
+
+	return dfa->table[slot];
+}
+
+internal bool
+_re_dfa_reset(Re_Dfa *dfa)
+{
+	if (!dfa->cache.data) {
+		dfa->cache = arena_allocator(REGEX_DFA_CACHE);
+		if (!dfa->cache.data) return false;
+	}
+
+	mem_free_all(dfa->cache);
+
+	// ~geb: the table sits at offset 0, so no state ever does
+	Alloc_Error err = 0;
+	dfa->table  = alloc_array(dfa->cache, u32, REGEX_DFA_TABLE, &err);
+	dfa->states = 0;
+	if (err) return false;
+
+	Re_Threads idle = {0};
+	dfa->idle = _re_intern(dfa, &idle);
+	return dfa->idle != 0;
+}
+
+internal void
+_re_scan_to_nfa(Regex_Scan *scan, Re_Threads *t)
+{
+	Regex *re = scan->re;
+
+	if (t->count) MemMove(re->nfa_pcs[0], t->pcs, t->count * sizeof(u32));
+	re->nfa = (Re_Threads){ .pcs = re->nfa_pcs[0], .count = t->count, .flags = t->flags };
+
+	scan->state = 0;
+}
+
+// ~geb: the transition out of the current state that is not in the dfa yet,
+//       or a step of the nfa once the scan fell back to it
+internal bool
+_re_scan_slow(Regex_Scan *scan, i32 c, usize at)
+{
+	Regex  *re  = scan->re;
+	Re_Dfa *dfa = &re->dfa[scan->kind];
+	Re_Threads out = { .pcs = re->out };
+
+	if (!scan->state) {
+		bool match = _re_step(re, scan->kind, &re->nfa, c, &out);
+
+		u32 *spare = re->nfa.pcs == re->nfa_pcs[0] ? re->nfa_pcs[1] : re->nfa_pcs[0];
+		if (out.count) MemMove(spare, out.pcs, out.count * sizeof(u32));
+		re->nfa = (Re_Threads){ .pcs = spare, .count = out.count, .flags = out.flags };
+
+		if (out.flags & Re_State_Dead) scan->done = true;
+		return match;
+	}
+
+	Re_State  *s  = _re_state(dfa, scan->state);
+	Re_Threads in = { .pcs = s->pcs, .count = s->count, .flags = s->flags };
+
+	bool match = _re_step(re, scan->kind, &in, c, &out);
+	u32  next  = _re_intern(dfa, &out);
+
+	if (!next) {
+		// ~geb: the cache is full. a wipe this soon after the last one means
+		//       the dfa is not paying for itself, the nfa takes over then
+		if (at - scan->cleared_at < REGEX_BYTES_PER_STATE * dfa->states)
+			scan->bad_clears++;
+		scan->cleared_at = at;
+
+		if (scan->bad_clears >= REGEX_MAX_BAD_CLEARS || !_re_dfa_reset(dfa) || !(next = _re_intern(dfa, &out))) {
+			_re_scan_to_nfa(scan, &out);
+			if (out.flags & Re_State_Dead) scan->done = true;
+			return match;
+		}
+	} else {
+		s->next[c < 0 ? 256 : c] = next | (match ? REGEX_MATCH_BIT : 0) | (out.flags & Re_State_Dead ? REGEX_DEAD_BIT : 0);
+	}
+
+	scan->state = next;
+	if (out.flags & Re_State_Dead) scan->done = true;
+	return match;
+}
+
+internal void
+_re_scan_matched(Regex_Scan *scan, usize at)
+{
+	if (scan->kind == Regex_Scan_Back) {
+		if (!at) return; // ~geb: an empty match where it starts is not behind it
+		scan->done = true;
+	}
+	scan->match = at;
+}
+
+internal void
+regex_scan_begin(Regex *re, Regex_Scan *scan, Regex_Scan_Kind kind, i32 before)
+{
+	*scan = (Regex_Scan){ .re = re, .kind = kind, .match = USIZE_MAX };
+
+	Re_Prog *prog = &re->prog[kind != Regex_Scan_Forward];
+	u32 entry = 0;
+
+	Re_Threads start = { .pcs = &entry, .count = kind == Regex_Scan_Start };
+	if (prog->line_start && (before < 0 || before == '\n'))
+		start.flags |= Re_State_Line_Start;
+
+	Re_Dfa *dfa = &re->dfa[kind];
+	if (dfa->cache.data || _re_dfa_reset(dfa)) {
+		scan->state = _re_intern(dfa, &start);
+		if (!scan->state && _re_dfa_reset(dfa))
+			scan->state = _re_intern(dfa, &start);
+	}
+
+	if (!scan->state) _re_scan_to_nfa(scan, &start);
+}
+
+internal bool
+regex_scan_feed(Regex_Scan *scan, u8 *ptr, usize len)
+{
+	if (scan->done) return false;
+
+	Regex  *re      = scan->re;
+	Re_Dfa *dfa     = &re->dfa[scan->kind];
+	bool    reverse = scan->kind != Regex_Scan_Forward;
+	bool    skip    = re->has_skip[scan->kind];
+
+	usize k = 0;
+	while (k < len && !scan->done) {
+		if (skip && scan->state == dfa->idle) {
+			// ~geb: nothing can start before the next place the pair turns up.
+			//       one cut off by the end of the span is left to the dfa
+			Mem_Pair *pair = &re->skip[scan->kind];
+			usize rest = len - k;
+			usize at   = reverse ? mem_find_pair_rev(ptr, rest, pair) : mem_find_pair(ptr + k, rest, pair);
+
+			if (at < rest) k = reverse ? len - 1 - (at + pair->dist) : k + at;
+			else           k = len - Min(pair->dist, rest);
+			if (k == len) break;
+		}
+
+		if (scan->state) {
+			// ~geb: plain cached transitions stay in here, anything that needs
+			//       looking at (a miss, a match, a dead end, the idle state) drops out
+			u8 *base  = (cast(Arena *) dfa->cache.data)->base;
+			u32 state = scan->state;
+			u32 idle  = skip ? dfa->idle : 0;
+			if (reverse) {
+				for (; k < len; ++k) {
+					u32 next = (cast(Re_State *) (base + state))->next[ptr[len - 1 - k]];
+					if (!next || next >= REGEX_DEAD_BIT || next == idle) break;
+					state = next;
+				}
+			} else {
+				for (; k < len; ++k) {
+					u32 next = (cast(Re_State *) (base + state))->next[ptr[k]];
+					if (!next || next >= REGEX_DEAD_BIT || next == idle) break;
+					state = next;
+				}
+			}
+			scan->state = state;
+			if (k == len) break;
+		}
+
+		u8    c  = reverse ? ptr[len - 1 - k] : ptr[k];
+		usize at = scan->pos + k;
+
+		u32 next = scan->state ? _re_state(dfa, scan->state)->next[c] : 0;
+		if (next) {
+			scan->state = next & ~(REGEX_MATCH_BIT | REGEX_DEAD_BIT);
+			if (next & REGEX_MATCH_BIT) _re_scan_matched(scan, at);
+			if (next & REGEX_DEAD_BIT)  scan->done = true;
+		} else if (_re_scan_slow(scan, c, at)) {
+			_re_scan_matched(scan, at);
+		}
+		k++;
+	}
+
+	scan->pos += k;
+	return !scan->done;
+}
+
+internal void
+regex_scan_finish(Regex_Scan *scan, i32 after)
+{
+	if (scan->done) return;
+
+	u32 next = 0;
+	if (scan->state)
+		next = _re_state(&scan->re->dfa[scan->kind], scan->state)->next[after < 0 ? 256 : after];
+
+	if (next ? (next & REGEX_MATCH_BIT) != 0 : _re_scan_slow(scan, after < 0 ? -1 : after, scan->pos))
+		_re_scan_matched(scan, scan->pos);
+
+	scan->done = true;
+}
+
+///////////////////////////////////////////////
+// ~geb: compile / release
+
+// ~geb: the one byte a class holds, or the lower case letter when it holds
+//       a letter in both cases and nothing else
+internal bool
+_re_class_single(Re_Class *c, u8 *b, u8 *fold)
+{
+	u32 count = 0;
+	u8  seen[2];
+
+	for (u32 i = 0; i < 256; ++i) {
+		if (!_re_class_has(c, cast(u8) i)) continue;
+		if (count == 2) return false;
+		seen[count++] = cast(u8) i;
+	}
+
+	if (count == 1) {
+		*b = seen[0];
+		*fold = 0;
+		return true;
+	}
+
+	if (count == 2 && Is_Between('A', seen[0], 'Z') && seen[1] == seen[0] + 0x20) {
+		*b = seen[1];
+		*fold = 0x20;
+		return true;
+	}
+	return false;
+}
+
+// ~geb: when the idle state is left by one byte only, or one letter in
+//       either case, scans can hop straight to it. if the program goes on
+//       with more fixed bytes after it, the hop looks for the first and the
+//       last of those together, which is a lot pickier than one byte alone.
+internal void
+_re_find_skip(Regex *re, Regex_Scan_Kind kind)
+{
+	u32 leave[2];
+	u32 count = 0;
+
+	Re_Threads idle = {0};
+	Re_Threads out  = { .pcs = re->out };
+
+	for (i32 c = 0; c < 256; ++c) {
+		bool match = _re_step(re, kind, &idle, c, &out);
+		if (!match && !out.count && !out.flags) continue;
+
+		if (count == 2) return;
+		leave[count++] = cast(u32) c;
+	}
+
+	Mem_Pair pair = {0};
+	if (count == 1) {
+		pair.first = cast(u8) leave[0];
+	} else if (count == 2 && Is_Between('A', leave[0], 'Z') && leave[1] == leave[0] + 0x20) {
+		pair.first      = cast(u8) leave[1];
+		pair.first_fold = 0x20;
+	} else {
+		return;
+	}
+	pair.last      = pair.first;
+	pair.last_fold = pair.first_fold;
+
+	Re_Prog *prog = &re->prog[kind != Regex_Scan_Forward];
+	u32 pc = 0;
+	for (usize n = 0; n < REGEX_SKIP_REACH && pc < prog->count; ++pc, ++n) {
+		Re_Inst *in = &prog->insts[pc];
+		u8 b, fold;
+		if (in->op != Re_Op_Byte || !_re_class_single(&re->classes[in->x], &b, &fold)) break;
+
+		if (!n) {
+			if (b != pair.first || fold != pair.first_fold) break;
+			continue;
+		}
+		pair.last      = b;
+		pair.last_fold = fold;
+		pair.dist      = n;
+	}
+
+	// ~geb: back to front the pair is looked for the other way around
+	if (kind != Regex_Scan_Forward) {
+		u8 first = pair.first, first_fold = pair.first_fold;
+		pair.first      = pair.last;
+		pair.first_fold = pair.last_fold;
+		pair.last       = first;
+		pair.last_fold  = first_fold;
+	}
+
+	re->skip[kind]     = pair;
+	re->has_skip[kind] = true;
+}
+
+internal void
+regex_release(Regex *re)
+{
+	if (!re) return;
+
+	for (u32 i = 0; i < Regex_Scan_Kind_Count; ++i) {
+		if (re->dfa[i].cache.data) arena_allocator_release(re->dfa[i].cache);
+	}
+
+	if (re->classes)       mem_free(re->alloc, re->classes, NULL);
+	if (re->prog[0].insts) mem_free(re->alloc, re->prog[0].insts, NULL);
+	if (re->prog[1].insts) mem_free(re->alloc, re->prog[1].insts, NULL);
+	if (re->sparse)        mem_free(re->alloc, re->sparse, NULL);
+	mem_free(re->alloc, re, NULL);
+}
+
+internal Regex *
+regex_compile(String8 pattern, Regex_Flags flags, Allocator alloc, String8 *error)
+{
+	*error = (String8){0};
+
+	if (pattern.len > REGEX_MAX_PATTERN) {
+		*error = S("pattern too long");
+		return NULL;
+	}
+
+	// ~geb: the tree and the programs are built on the heap, only what a
+	//       scan needs is copied over to `alloc`
+	Re_Parser p = {
+		.at      = pattern.str,
+		.end     = pattern.str + pattern.len,
+		.fold    = (flags & Regex_Flag_Ignore_Case) != 0,
+		.nodes   = dynamic_array(heap_allocator(), Re_Node, 0),
+		.classes = dynamic_array(heap_allocator(), Re_Class, 0),
+	};
+
+	u32 root = _re_parse_alt(&p);
+	if (!p.error && p.at != p.end) p.error = "unmatched )";
+
+	Alloc_Error err = 0;
+	Regex *re = NULL;
+
+	if (!p.error) {
+		re = alloc(alloc, Regex, &err);
+		if (err) p.error = "out of memory";
+		else     re->alloc = alloc;
+	}
+
+	if (re && !p.error) {
+		re->classes = alloc_array_nz(alloc, Re_Class, Max(p.classes.len, 1), &err);
+		if (err) p.error = "out of memory";
+		else {
+			if (p.classes.len) MemMove(re->classes, p.classes.data, p.classes.len * sizeof(Re_Class));
+			re->class_count = cast(u32) p.classes.len;
+		}
+	}
+
+	for (u32 dir = 0; re && !p.error && dir < 2; ++dir) {
+		Re_Compiler c = {
+			.nodes   = dyn_arr_data(&p.nodes, Re_Node),
+			.insts   = dynamic_array(heap_allocator(), Re_Inst, 0),
+			.reverse = dir == 1,
+		};
+
+		_re_compile(&c, root);
+		_re_emit(&c, Re_Op_Match, 0, 0);
+
+		if (!c.error) {
+			Re_Inst *insts = alloc_array_nz(alloc, Re_Inst, c.insts.len, &err);
+			if (err) c.error = "out of memory";
+			else {
+				MemMove(insts, c.insts.data, c.insts.len * sizeof(Re_Inst));
+				re->prog[dir] = (Re_Prog){ .insts = insts, .count = cast(u32) c.insts.len, .line_start = c.line_start };
+			}
+		}
+
+		dynamic_array_delete(&c.insts);
+		p.error = c.error;
+	}
+
+	if (re && !p.error) {
+		// ~geb: both directions have the same instructions, just laid out differently
+		u32 n = re->prog[0].count;
+		re->sparse = alloc_array(alloc, u32, n * 7 + 1, &err);
+		if (err) {
+			p.error = "out of memory";
+		} else {
+			re->dense      = re->sparse + n;
+			re->out        = re->dense + n;
+			re->nfa_pcs[0] = re->out + n;
+			re->nfa_pcs[1] = re->nfa_pcs[0] + n;
+			re->stack      = re->nfa_pcs[1] + n;
+
+			_re_find_skip(re, Regex_Scan_Forward);
+			_re_find_skip(re, Regex_Scan_Back);
+		}
+	}
+
+	dynamic_array_delete(&p.nodes);
+	dynamic_array_delete(&p.classes);
+
+	if (p.error) {
+		regex_release(re);
+		*error = str8(cast(u8 *) p.error, strlen(p.error));
+		return NULL;
+	}
+
+	return re;
+}
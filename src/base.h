@@ -295,6 +295,8 @@ typedef u8 bool;
 	else     (var) &= ~(mask); \
 } while (0)
 
+#define ArrayCount(a) (sizeof(a) / sizeof((a)[0]))
+
 #define Min(a, b) ((a) < (b) ? (a) : (b))
 #define Max(a, b) ((a) > (b) ? (a) : (b))
 #define Clamp(lower, x, upper) Min(Max((x), (lower)), (upper))
@@ -505,6 +507,7 @@ mem_resize_aligned(Allocator a, void *old_mem, usize old_size, usize new_size, u
 
 internal Allocator heap_allocator(void);
 internal Allocator arena_allocator(usize reserve);
+internal void      arena_allocator_release(Allocator arena);
 
 ///////////////////////////////////
 // ~geb: Dynamic Array
@@ -545,6 +548,97 @@ internal void dynamic_array_delete(Dynamic_Array *arr);
 internal bool dynamic_array_reserve(Dynamic_Array *arr, usize elem_size, usize elem_align, usize min_capacity);
 internal void dynamic_array_clear(Dynamic_Array *arr);
 
+///////////////////////////////////
+// ~geb: Gap Tree
+
+// ~geb: a segment tree summing up a gap array of leaves. nodes[1] is the
+//       root and the leaves start at nodes[cap], with the ones in
+//       [before, after) empty, so the leaves around the last edit move in
+//       O(1) each. a zeroed node has to sum up to nothing, `join` puts the
+//       sum of `a` and `b` into `out`
+typedef void Gap_Tree_Join(void *out, void *a, void *b);
+
+typedef struct {
+	Allocator      alloc;
+	Gap_Tree_Join *join;
+	u8            *nodes;
+	usize          size;   // bytes a node takes
+	usize          align;
+	usize          cap;    // leaves, a power of two
+	usize          before;
+	usize          after;
+} Gap_Tree;
+
+#define gap_tree(_alloc, T, _join) \
+	(Gap_Tree){ \
+		.alloc = (_alloc), \
+		.join  = (_join), \
+		.size  = sizeof(T), \
+		.align = AlignOf(T), \
+	}
+
+#define gap_tree_nodes(t, T) (cast(T *) (t)->nodes)
+
+internal void  gap_tree_delete(Gap_Tree *t);
+internal bool  gap_tree_grow(Gap_Tree *t);
+
+internal usize gap_tree_count(Gap_Tree *t);
+internal usize gap_tree_leaf(Gap_Tree *t, usize i);
+internal usize gap_tree_logical(Gap_Tree *t, usize leaf);
+
+// ~geb: recomputes every node above leaves [lo, hi), a level at a time
+internal void  gap_tree_fix(Gap_Tree *t, usize lo, usize hi);
+internal void  gap_tree_set(Gap_Tree *t, usize leaf, void *node);
+
+// ~geb: moves the gap so leaf `i`, counting past the gap, is the first one behind it
+internal void  gap_tree_gap_to(Gap_Tree *t, usize i);
+
+// ~geb: a leaf put in right in front of the gap, growing the tree when it is full
+internal bool  gap_tree_push(Gap_Tree *t, void *node);
+
+// ~geb: the `count` leaves right behind the gap are emptied into it
+internal void  gap_tree_drop(Gap_Tree *t, usize count);
+
+
+///////////////////////////////////
+// ~geb: Byte scanning kernels
+// all of them return `len` when nothing matches
+
+#if ARCH_X64 && (COMPILER_CLANG || COMPILER_GCC)
+# define MEM_SCAN_X64 1
+# include <immintrin.h>
+#else
+# define MEM_SCAN_X64 0
+#endif
+
+// ~geb: probe for substring search candidates, start offsets `i` where
+//       ptr[i] matches `first` and ptr[i + dist] matches `last`. a probe's
+//       fold bits are or'ed into the text byte first, 0x20 folds ascii case.
+typedef struct {
+	u8    first;
+	u8    first_fold;
+	u8    last;
+	u8    last_fold;
+	usize dist;
+} Mem_Pair;
+
+typedef struct {
+	usize (*find_byte)(u8 *ptr, usize len, u8 byte);
+	usize (*find_byte_rev)(u8 *ptr, usize len, u8 byte);
+	usize (*count_byte)(u8 *ptr, usize len, u8 byte);
+	usize (*find_non_ascii)(u8 *ptr, usize len);
+	usize (*find_pair)(u8 *ptr, usize len, Mem_Pair *pair);
+	usize (*find_pair_rev)(u8 *ptr, usize len, Mem_Pair *pair);
+	usize width; // bytes looked at per step
+} Mem_Scan_Kernels;
+
+internal void  mem_scan_init(void); // picks the widest kernels the cpu runs
+internal usize mem_find_byte(u8 *ptr, usize len, u8 byte);
+internal usize mem_find_byte_rev(u8 *ptr, usize len, u8 byte);
+internal usize mem_count_byte(u8 *ptr, usize len, u8 byte);
+internal usize mem_find_non_ascii(u8 *ptr, usize len);
+internal usize mem_find_pair(u8 *ptr, usize len, Mem_Pair *pair);     // first candidate start, len if none
+internal usize mem_find_pair_rev(u8 *ptr, usize len, Mem_Pair *pair); // last candidate start, len if none
 
 ///////////////////////////////////
 // ~geb: String type ( UTF8 )
@@ -634,6 +728,8 @@ enum {
 internal bool str8_iter(String8 string, Str_Iterator *it);
 
 internal rune utf8_decode(u8 *ptr, UTF8_Error *err);
+internal usize utf8_encode(rune cp, u8 out[4]);
+internal usize utf8_ascii_run(u8 *ptr, usize len);
 internal usize utf8_codepoint_size(rune cp);
 
 internal bool is_letter(rune r);
@@ -644,6 +740,55 @@ internal bool is_pair_begin(rune r);
 internal bool is_pair_end(rune r);
 internal String8 get_pair_end(rune r);
 
+///////////////////////////////////
+// ~geb: Regex
+// linear time, nothing ever backtracks. patterns are matched over bytes:
+//   literals, .  [abc] [^a-z]  \d \w \s \D \W \S  \n \t \r
+//   ( )  (?: )  |  * + ? {n} {n,} {n,m} and their lazy ?-forms  ^ $
+// ^ and $ are line anchors. . and negated classes never match a newline.
+// leftmost match wins, the first alternative that matches there after that.
+
+typedef u32 Regex_Flags;
+enum {
+	Regex_Flag_Ignore_Case = Bit(0), // ascii letters only
+};
+
+typedef u8 Regex_Scan_Kind;
+enum {
+	Regex_Scan_Forward = 0, // front to back, ends up at the end of the leftmost match
+	Regex_Scan_Back,        // back to front, stops at the start of the first match behind where it started
+	Regex_Scan_Start,       // back to front from the end of a match, ends up at its start
+	Regex_Scan_Kind_Count,
+};
+
+typedef struct Regex Regex;
+
+// ~geb: a scan is fed the text a span at a time, in the direction of its
+//       kind, so it runs straight over whatever the text is stored in
+typedef struct {
+	Regex          *re;
+	Regex_Scan_Kind kind;
+
+	u32   state;  // lazy dfa state, 0 once the scan fell back to stepping the nfa
+	usize pos;    // bytes fed so far
+	usize match;  // `pos` where the last match ended, USIZE_MAX if none did
+	bool  done;   // nothing more can match
+
+	usize cleared_at; // `pos` when the dfa cache was last wiped
+	u32   bad_clears; // wipes that came too soon
+} Regex_Scan;
+
+// ~geb: NULL and `error` set when the pattern does not compile
+internal Regex *regex_compile(String8 pattern, Regex_Flags flags, Allocator alloc, String8 *error);
+internal void   regex_release(Regex *re);
+
+// ~geb: `before` is the byte in front of where the scan starts, in the
+//       direction it runs, `after` the one behind where it stops, -1 at
+//       the edge of the text. the anchors look at them.
+internal void regex_scan_begin(Regex *re, Regex_Scan *scan, Regex_Scan_Kind kind, i32 before);
+internal bool regex_scan_feed(Regex_Scan *scan, u8 *ptr, usize len); // false once done
+internal void regex_scan_finish(Regex_Scan *scan, i32 after);
+
 ///////////////////////////////////
 // ~geb: OS layer
 
@@ -675,6 +820,14 @@ enum {
   OS_FileFlag_Archive    = Bit(4),
   OS_FileFlag_Executable = Bit(5),
   OS_FileFlag_Symlink    = Bit(6),
+  OS_FileFlag_Special    = Bit(7), // device, fifo or socket
+};
+
+typedef u32 OS_Sync_Policy;
+enum {
+  OS_Sync_None = 0, // leave flushing to the kernel
+  OS_Sync_Data,     // flush file contents before it replaces the target
+  OS_Sync_Full,     // flush contents, metadata and the directory entry
 };
 
 typedef u64 OS_Time_Stamp;
@@ -693,13 +846,37 @@ internal OS_Handle    os_file_open(OS_AccessFlags flags, String8 path);
 internal void         os_file_close(OS_Handle file);
 internal usize        os_file_read(OS_Handle file, usize begin, usize end, void *out_data);
 internal usize        os_file_write(OS_Handle file, usize begin, usize end, void *data);
+internal usize        os_file_write_spans(OS_Handle file, String8 *spans, usize count);
+internal bool         os_file_sync(OS_Handle file, OS_Sync_Policy sync);
 internal OS_FileProps os_properties_from_file(OS_Handle file);
+internal void        *os_file_map(OS_Handle file, usize size);
+internal void         os_file_unmap(void *ptr, usize size);
 
 internal String8      os_data_from_path(String8 path, Allocator alloc);
+internal String8      os_map_from_path(String8 path);
 internal bool         os_write_to_path(String8 path, String8 data);
+internal bool         os_replace_path(String8 path, String8 *spans, usize count, OS_Sync_Policy sync);
 
 internal bool os_path_exists(String8 path);
 
+// ~geb: directory listing, entries come in batches straight from the kernel
+//       in whatever order the file system keeps them. `.` and `..` are left out
+typedef struct {
+	String8      name;  // into the iterator, valid until the next call
+	OS_FileFlags flags; // only the kind bits, none for a regular file
+} OS_Dir_Entry;
+
+typedef struct {
+	OS_Handle dir;
+	usize     at;
+	usize     filled;
+	u8        batch[Kb(32)];
+} OS_Dir_Iter;
+
+internal bool os_dir_open(String8 path, OS_Dir_Iter *it);
+internal bool os_dir_next(OS_Dir_Iter *it, OS_Dir_Entry *entry);
+internal void os_dir_close(OS_Dir_Iter *it);
+
 // ~geb: time interface
 
 typedef struct OS_Time_Duration {
@@ -714,6 +891,20 @@ internal OS_Time_Stamp    os_time_frequency();
 internal void             os_sleep_ns(u64 ns);
 internal OS_Time_Duration os_time_diff(OS_Time_Stamp start, OS_Time_Stamp end);
 
+// ~geb: threads, shared state between them goes through C11 atomics
+
+#include <stdatomic.h>
+
+typedef struct OS_Thread {
+	u64 handle; // 0 when the thread could not be started
+} OS_Thread;
+
+typedef void OS_Thread_Proc(void *data);
+
+internal OS_Thread os_thread_start(OS_Thread_Proc *proc, void *data);
+internal void      os_thread_join(OS_Thread thread);
+internal u32       os_core_count(void);
+
 ///////////////////////////////////
 // ~geb: Logging
 
@@ -2,438 +2,2868 @@
 
 // const global usize TAB_WIDTH = 4;
 
+#define LINE_SCAN_CHUNK Kb(256)
+#define COLUMN_CHECKPOINT_STRIDE Kb(4)
+#define LOADER_MIN_SIZE Mb(16) // smaller files are indexed lazily on the main thread
+
+#define BUFFER_RESERVE_SIZE Gb(64)
+#define BUFFER_COMMIT_BLOCK Kb(64)
+#define BUFFER_COMMIT_SLACK Mb(4) // committed but unused pages kept around a moving gap
+
+#define HISTORY_RESERVE_SIZE (ARCH_64BIT ? Gb(16) : Mb(64))
+
 internal usize
-_buf_len(Q_Buffer *b)
+_data_len(Q_Buffer *b)
 {
     return b->cap - b->gap_size;
 }
 
 internal usize
-_real(Q_Buffer *b, usize off)
+_buf_len(Q_Buffer *b)
 {
-    return off < b->gap_pos ? off : off + b->gap_size;
+    return b->orig_head + _data_len(b) + (b->orig.len - b->orig_tail);
 }
 
-internal void
-_move_gap(Q_Buffer *b, usize off)
+// ~geb: pointer to the byte at `off` and how many bytes follow it contiguously
+internal u8 *
+_chunk_at(Q_Buffer *b, usize off, usize *avail)
 {
-    if (off == b->gap_pos) return;
+	if (off < b->orig_head) {
+		*avail = b->orig_head - off;
+		return b->orig.str + off;
+	}
+	off -= b->orig_head;
 
-    if (off < b->gap_pos) {
-        usize n = b->gap_pos - off;
-        MemMove(b->data + off + b->gap_size,
-                b->data + off,
-                n);
-    } else {
-        usize n = off - b->gap_pos;
-        MemMove(b->data + b->gap_pos,
-                b->data + b->gap_pos + b->gap_size,
-                n);
-    }
+	usize pre = b->gap_pos - b->orig_head;
+	if (off < pre) {
+		*avail = pre - off;
+		return b->data + off;
+	}
 
-    b->gap_pos = off;
+	usize data_len = _data_len(b);
+	if (off < data_len) {
+		*avail = data_len - off;
+		return b->data + off + b->gap_size;
+	}
+	off -= data_len;
+
+	*avail = b->orig.len - b->orig_tail - off;
+	return b->orig.str + b->orig_tail + off;
 }
 
-internal Q_Buffer *
-_grow(Q_Buffer *b, usize need)
+internal u8
+_byte(Q_Buffer *b, usize off)
 {
-    if (b->gap_size >= need) return b;
+	usize avail = 0;
+	return *_chunk_at(b, off, &avail);
+}
 
-    usize new_cap = b->cap * 2 + need;
+internal u32
+_width_at(Q_Buffer *b, usize off)
+{
+	u32 w = UTF8_LEN_TABLE[_byte(b, off)];
+	return w ? w : 1;
+}
+
+// ~geb: decodes the codepoint at `off`, even if it straddles two regions
+internal rune
+_decode(Q_Buffer *b, usize off)
+{
+	usize avail = 0;
+	u8 *p = _chunk_at(b, off, &avail);
 
-    usize name_len = b->name.len;
-    usize size = sizeof(Q_Buffer) + new_cap + name_len;
+	UTF8_Error err = 0;
+	if (UTF8_LEN_TABLE[*p] <= avail) return utf8_decode(p, &err);
 
-    Alloc_Error err = 0;
-    Q_Buffer *n = mem_alloc_aligned(b->alloc, size, AlignOf(Q_Buffer), false, &err);
-    if (err) return b;
+	u8 tmp[4] = {0};
+	usize len = _buf_len(b);
+	for (usize i = 0; i < 4 && off + i < len; ++i)
+		tmp[i] = _byte(b, off + i);
 
-    MemZeroStruct(n);
+	return utf8_decode(tmp, &err);
+}
+
+///////////////////////////////////////////////
+// ~geb: Line index
 
-    n->alloc = b->alloc;
-    n->prev  = b->prev;
-    n->next  = b->next;
-    n->cap   = new_cap;
-	n->goal_col = b->goal_col;
-	n->goal_col_valid = b->goal_col_valid;
+internal bool
+_lines_reserve(Q_Buffer *b, usize gap_need, usize tail_need)
+{
+	Line_Index *li = &b->lines;
 
-    u8 *name_mem = n->data + new_cap;
-    MemMove(name_mem, b->name.str, name_len);
-    n->name = str8(name_mem, name_len);
+	if (li->after - li->before >= gap_need && li->cap - li->end >= tail_need)
+		return true;
 
-    usize before = b->gap_pos;
-    usize after  = b->cap - (b->gap_pos + b->gap_size);
+	usize after_count = li->end - li->after;
+	usize count       = li->before + after_count;
+	usize new_cap     = Max(li->cap * 2, count + gap_need + tail_need + 256);
 
-    n->gap_pos  = before;
-    n->gap_size = new_cap - (before + after);
+	Alloc_Error err = 0;
+	usize *items = alloc_array_nz(b->alloc, usize, new_cap, &err);
+	if (err) return false;
 
-    MemMove(n->data, b->data, before);
-    MemMove(n->data + n->gap_pos + n->gap_size, b->data + b->gap_pos + b->gap_size, after);
+	usize slack     = new_cap - count - gap_need - tail_need;
+	usize new_after = li->before + gap_need + slack / 2;
 
-    if (n->prev) n->prev->next = n;
-    if (n->next) n->next->prev = n;
+	if (li->items) {
+		MemMove(items, li->items, li->before * sizeof(usize));
+		MemMove(items + new_after, li->items + li->after, after_count * sizeof(usize));
+		mem_free(b->alloc, li->items, NULL);
+	}
 
-    mem_free(b->alloc, b, NULL);
-    return n;
+	li->items = items;
+	li->after = new_after;
+	li->end   = new_after + after_count;
+	li->cap   = new_cap;
+	return true;
 }
 
-internal usize
-_line_start(Q_Buffer *b, usize off)
+internal void
+_lines_free(Q_Buffer *b)
 {
-    while (off) {
-        usize r = _real(b, off - 1);
-        if (b->data[r] == '\n') break;
-        off--;
-    }
-    return off;
+	if (b->lines.items)
+		mem_free(b->alloc, b->lines.items, NULL);
+	MemZeroStruct(&b->lines);
 }
 
 internal usize
-_next_line_start(Q_Buffer *b, usize off)
+_lines_newline_count(Q_Buffer *b)
 {
-    usize len = _buf_len(b);
-    while (off < len) {
-        usize r = _real(b, off);
-        if (b->data[r] == '\n') return off + 1;
-        off++;
-    }
-    return len;
+	return b->lines.before + (b->lines.end - b->lines.after);
 }
 
+// ~geb: offset of the i-th newline in the buffer
 internal usize
-_current_column(Q_Buffer *b, int tab_width)
+_lines_newline(Q_Buffer *b, usize i)
 {
-    usize start = _line_start(b, b->gap_pos);
-    usize off = start;
-    usize col = 0;
-
-    while (off < b->gap_pos) {
-        usize r = _real(b, off);
-        u8 c = b->data[r];
-
-        u32 w = UTF8_LEN_TABLE[c];
-        if (!w) w = 1;
+	Line_Index *li = &b->lines;
+	if (i < li->before) return li->items[i];
+	return _buf_len(b) - li->items[li->after + (i - li->before)];
+}
 
-        off += w;
+///////////////////////////////////////////////
+// ~geb: Background loader
 
-        if (c == '\t') {
-            usize advance = (usize) (tab_width - (col % tab_width));
-            col += advance;
-        } else {
-            col++;
-        }
-    }
+internal void
+_loader_proc(void *data)
+{
+	Buffer_Loader *ld = cast(Buffer_Loader *) data;
 
-    return col;
-}
+	usize at    = 0;
+	usize count = 0;
 
-internal Q_Buffer *
-buffer_make(String8 name, String8 src, Q_Buffer *cur, Allocator alloc)
-{
-    usize buffer_cap = Max(src.len * 2, Kb(4));
-    usize size = sizeof(Q_Buffer) + buffer_cap + name.len;
+	while (at < ld->len && !atomic_load_explicit(&ld->cancel, memory_order_relaxed)) {
+		usize n = Min(ld->len - at, LINE_SCAN_CHUNK);
+		u8 *p = ld->src + at;
 
-    Alloc_Error err = 0;
-    Q_Buffer *b = cast(Q_Buffer *) mem_alloc_aligned(alloc, size, AlignOf(Q_Buffer), false, &err);
-    if (err) return NULL;
+		for (usize i = mem_find_byte(p, n, '\n'); i < n; i += 1 + mem_find_byte(p + i + 1, n - i - 1, '\n')) {
+			if ((count + 1) * sizeof(usize) > ld->committed) {
+				usize grow = Min(BUFFER_COMMIT_BLOCK, ld->reserved - ld->committed);
+				if (!grow || os_commit(cast(u8 *) ld->offsets + ld->committed, grow) != 0)
+					return; // ~geb: the main thread keeps scanning on its own
 
-    MemZeroStruct(b);
+				ld->committed += grow;
+			}
 
-    b->alloc = alloc;
-    b->cap   = buffer_cap;
-    b->gap_size = buffer_cap - src.len;
-	b->name = str8(cast(u8 *) b + sizeof(Q_Buffer) + buffer_cap, name.len);
-	MemMove(b->name.str, name.str, name.len);
+			ld->offsets[count++] = at + i;
+		}
 
-    if (cur) {
-        b->prev = cur;
-        b->next = cur->next;
-        if (b->next) b->next->prev = b;
-        cur->next = b;
-    }
+		at += n;
+		atomic_store_explicit(&ld->count, count, memory_order_release);
+		atomic_store_explicit(&ld->scanned, at, memory_order_release);
+	}
+}
 
-    MemMove(b->data + b->gap_size, src.str, src.len);
+internal void
+_loader_start(Q_Buffer *b)
+{
+	if (b->orig.len < LOADER_MIN_SIZE) return;
+	if (b->orig.len > USIZE_MAX / sizeof(usize)) return;
+
+	Alloc_Error err = 0;
+	Buffer_Loader *ld = cast(Buffer_Loader *) mem_alloc_aligned(b->alloc, sizeof(Buffer_Loader), AlignOf(Buffer_Loader), true, &err);
+	if (err) return;
+
+	ld->src      = b->orig.str;
+	ld->len      = b->orig.len;
+	ld->reserved = AlignPow2(ld->len * sizeof(usize), BUFFER_COMMIT_BLOCK);
+	ld->offsets  = cast(usize *) os_reserve(ld->reserved);
+
+	if (ld->offsets) {
+		ld->thread = os_thread_start(_loader_proc, ld);
+		if (ld->thread.handle) {
+			b->loader = ld;
+			return;
+		}
+		os_release(ld->offsets, ld->reserved);
+	}
 
-    return b;
+	mem_free(b->alloc, ld, NULL);
 }
 
 internal void
-buffer_delete(Q_Buffer *b)
+_loader_stop(Q_Buffer *b)
 {
-	if (!b) return;
+	Buffer_Loader *ld = b->loader;
+	if (!ld) return;
 
-	if (b->prev) b->prev->next = b->next;
-	if (b->next) b->next->prev = b->prev;
+	atomic_store_explicit(&ld->cancel, true, memory_order_relaxed);
+	os_thread_join(ld->thread);
 
-	mem_free(b->alloc, b, NULL);
+	os_release(ld->offsets, ld->reserved);
+	mem_free(b->alloc, ld, NULL);
+	b->loader = NULL;
 }
 
-internal Q_Buffer *
-buffer_insert(Q_Buffer *b, String8 text, int tab_width)
+// ~geb: folds whatever the loader finished past the scan frontier into the
+//       index. the unscanned tail is always untouched original text, so its
+//       distance from the end of the text is its distance from orig.len
+internal bool
+_lines_take_loaded(Q_Buffer *b)
 {
-    b = _grow(b, text.len);
+	Buffer_Loader *ld = b->loader;
+	Line_Index *li = &b->lines;
+	if (!ld || !li->unscanned) return false;
 
-    MemMove(b->data + b->gap_pos, text.str, text.len);
+	usize scanned = atomic_load_explicit(&ld->scanned, memory_order_acquire);
+	usize count   = atomic_load_explicit(&ld->count, memory_order_acquire);
+	usize from    = b->orig.len - li->unscanned;
 
-    for (usize i = 0; i < text.len;) {
-        u8 c = text.str[i];
-        u32 w = UTF8_LEN_TABLE[c];
-        if (!w) w = 1;
+	if (scanned <= from) return false;
 
-        i += w;
-    }
+	while (ld->taken < count && ld->offsets[ld->taken] < from)
+		ld->taken++;
 
-    b->gap_pos  += text.len;
-    b->gap_size -= text.len;
+	usize n = ld->taken;
+	while (n < count && ld->offsets[n] < scanned)
+		n++;
 
-    b->goal_col = _current_column(b, tab_width);
-    b->goal_col_valid = true;
+	if (n > ld->taken && !_lines_reserve(b, 0, n - ld->taken)) return false;
 
-    return b;
+	for (; ld->taken < n; ++ld->taken)
+		li->items[li->end++] = b->orig.len - ld->offsets[ld->taken];
+
+	li->unscanned = b->orig.len - scanned;
+	return true;
 }
 
-internal void
-buffer_erase(Q_Buffer *b)
+// ~geb: indexes the next chunk of the unscanned tail
+internal bool
+_lines_scan_chunk(Q_Buffer *b)
 {
-    usize len = _buf_len(b);
-    if (b->gap_pos >= len) return;
+	if (_lines_take_loaded(b)) return true;
+
+	Line_Index *li = &b->lines;
+	usize len  = _buf_len(b);
+	usize from = len - li->unscanned;
 
-    usize real = _real(b, b->gap_pos);
-    u8 c = b->data[real];
-    u32 w = UTF8_LEN_TABLE[c];
-    if (!w) w = 1;
+	usize avail = 0;
+	u8 *p = _chunk_at(b, from, &avail);
+	usize n = Min(avail, LINE_SCAN_CHUNK);
 
-    b->gap_size += w;
+	usize count = mem_count_byte(p, n, '\n');
+	if (count && !_lines_reserve(b, 0, count)) return false;
+
+	for (usize i = mem_find_byte(p, n, '\n'); i < n; i += 1 + mem_find_byte(p + i + 1, n - i - 1, '\n'))
+		li->items[li->end++] = len - (from + i);
+
+	li->unscanned -= n;
+	return true;
 }
 
+// ~geb: makes sure every newline in front of `off` is indexed
 internal void
-buffer_move_left(Q_Buffer *b, int tab_width)
+_lines_scan_to(Q_Buffer *b, usize off)
+{
+	while (b->lines.unscanned && _buf_len(b) - b->lines.unscanned < off) {
+		if (!_lines_scan_chunk(b)) break;
+	}
+}
+
+// ~geb: makes sure at least `count` newlines are indexed, if there are that many
+internal void
+_lines_scan_rows(Q_Buffer *b, usize count)
 {
-    if (b->gap_pos == 0) return;
+	while (b->lines.unscanned && _lines_newline_count(b) < count) {
+		if (!_lines_scan_chunk(b)) break;
+	}
+}
 
-    usize pos = b->gap_pos - 1;
+// ~geb: must be called before gap_pos itself changes
+internal void
+_lines_move_gap(Q_Buffer *b, usize off)
+{
+	_lines_scan_to(b, off);
 
-    while (pos && (b->data[_real(b, pos)] & 0xC0) == 0x80)
-        pos--;
+	Line_Index *li = &b->lines;
+	usize len = _buf_len(b);
 
-    _move_gap(b, pos);
+	if (off < b->gap_pos) {
+		while (li->before && li->items[li->before - 1] >= off) {
+			usize nl = li->items[--li->before];
+			li->items[--li->after] = len - nl;
+		}
+	} else {
+		while (li->after < li->end && len - li->items[li->after] < off) {
+			usize nl = len - li->items[li->after++];
+			li->items[li->before++] = nl;
+		}
+	}
+}
 
-    b->goal_col = _current_column(b, tab_width);
-    b->goal_col_valid = true;
+// ~geb: text has already been copied into the gap at gap_pos
+internal usize
+_lines_on_insert(Q_Buffer *b, String8 text)
+{
+	usize count = mem_count_byte(text.str, text.len, '\n');
+	if (!count || !_lines_reserve(b, count, 0)) return count;
+
+	Line_Index *li = &b->lines;
+	u8 *p = text.str;
+	usize n = text.len;
+
+	for (usize i = mem_find_byte(p, n, '\n'); i < n; i += 1 + mem_find_byte(p + i + 1, n - i - 1, '\n'))
+		li->items[li->before++] = b->gap_pos + i;
+	return count;
 }
 
-internal void
-buffer_move_right(Q_Buffer *b, int tab_width)
+// ~geb: the `size` bytes right after the gap are about to be removed,
+//       returns how many newlines go with them
+internal usize
+_lines_on_erase(Q_Buffer *b, usize size)
 {
-    usize len = _buf_len(b);
-    if (b->gap_pos >= len) return;
+	usize stop = b->gap_pos + size;
+	_lines_scan_to(b, stop);
 
-    usize real = _real(b, b->gap_pos);
-    u8 c = b->data[real];
-    u32 w = UTF8_LEN_TABLE[c];
-    if (!w) w = 1;
+	Line_Index *li = &b->lines;
+	usize len  = _buf_len(b);
+	usize from = li->after;
 
-    _move_gap(b, b->gap_pos + w);
+	while (li->after < li->end && len - li->items[li->after] < stop)
+		li->after++;
 
-    b->goal_col = _current_column(b, tab_width);
-    b->goal_col_valid = true;
+	return li->after - from;
 }
 
-internal void
-buffer_move_up(Q_Buffer *b, int tab_width)
+///////////////////////////////////////////////
+// ~geb: Marks
+
+internal bool
+_marks_reserve(Q_Buffer *b, usize gap_need)
 {
-    usize cur_start = _line_start(b, b->gap_pos);
-    if (cur_start == 0) return;
+	Mark_Set *ms = &b->marks;
+	if (ms->after - ms->before >= gap_need) return true;
 
-    if (!b->goal_col_valid) {
-        b->goal_col = _current_column(b, tab_width);
-        b->goal_col_valid = true;
-    }
+	usize after_count = ms->end - ms->after;
+	usize count       = ms->before + after_count;
+	usize new_cap     = Max(ms->cap * 2, count + gap_need + 64);
 
-    usize prev_end   = cur_start - 1;
-    usize prev_start = _line_start(b, prev_end);
+	Alloc_Error err = 0;
+	Mark_Slot *items = alloc_array_nz(b->alloc, Mark_Slot, new_cap, &err);
+	if (err) return false;
 
-    usize off = prev_start;
-    usize col = 0;
+	usize new_after = new_cap - after_count;
 
-    while (off < prev_end && col < b->goal_col) {
-        u8 c = b->data[_real(b, off)];
-        u32 w = UTF8_LEN_TABLE[c];
-        if (!w) w = 1;
+	if (ms->items) {
+		MemMove(items, ms->items, ms->before * sizeof(Mark_Slot));
+		MemMove(items + new_after, ms->items + ms->after, after_count * sizeof(Mark_Slot));
+		mem_free(b->alloc, ms->items, NULL);
+	}
 
-		if (b->data[_real(b, off)] == '\t')
-			col += 4;
-		else
-			col++;
-		off += w;
-    }
+	for (usize i = new_after; i < new_cap; ++i)
+		ms->where[items[i].id] = i;
 
-    _move_gap(b, off);
+	ms->items = items;
+	ms->after = new_after;
+	ms->end   = new_cap;
+	ms->cap   = new_cap;
+	return true;
 }
 
 internal void
-buffer_move_down(Q_Buffer *b, int tab_width)
+_marks_free(Q_Buffer *b)
+{
+	Mark_Set *ms = &b->marks;
+	if (ms->items) mem_free(b->alloc, ms->items, NULL);
+	if (ms->where) mem_free(b->alloc, ms->where, NULL);
+	MemZeroStruct(ms);
+}
+
+internal void
+_marks_put(Mark_Set *ms, usize i, Mark_Slot slot)
+{
+	ms->items[i] = slot;
+	ms->where[slot.id] = i;
+}
+
+internal usize
+_marks_offset(Q_Buffer *b, usize i)
+{
+	Mark_Set *ms = &b->marks;
+	if (i < ms->before) return ms->items[i].pos;
+	return _buf_len(b) - ms->items[i].pos;
+}
+
+// ~geb: marks in front of `off` end up before the gap, the rest behind it
+internal void
+_marks_move_gap(Q_Buffer *b, usize off)
 {
+	Mark_Set *ms = &b->marks;
 	usize len = _buf_len(b);
 
-	usize next_start = _next_line_start(b, b->gap_pos);
-	if (next_start >= len) return;
+	while (ms->before && ms->items[ms->before - 1].pos >= off) {
+		Mark_Slot s = ms->items[--ms->before];
+		s.pos = len - s.pos;
+		_marks_put(ms, --ms->after, s);
+	}
 
-	if (!b->goal_col_valid) {
-		b->goal_col = _current_column(b, tab_width);
-		b->goal_col_valid = true;
+	while (ms->after < ms->end && len - ms->items[ms->after].pos < off) {
+		Mark_Slot s = ms->items[ms->after++];
+		s.pos = len - s.pos;
+		_marks_put(ms, ms->before++, s);
 	}
+}
 
-	usize off = next_start;
-	usize col = 0;
+// ~geb: pulls the slot right behind the gap over in front of it at `off`
+internal void
+_marks_pull(Mark_Set *ms, usize i, usize off)
+{
+	Mark_Slot s = ms->items[i];
+	if (i != ms->after) _marks_put(ms, i, ms->items[ms->after]);
+	ms->after++;
 
-	while (off < len) {
-		usize r = _real(b, off);
-		if (b->data[r] == '\n') break;
-		if (col >= b->goal_col) break;
+	s.pos = off;
+	_marks_put(ms, ms->before++, s);
+}
 
-		u8 c = b->data[r];
-		u32 w = UTF8_LEN_TABLE[c];
-		if (!w) w = 1;
+// ~geb: text is about to be inserted at `off`. marks right at it that stay
+//       put are moved in front of the gap, everything behind it moves along
+//       with the end of the text.
+internal void
+_marks_on_insert(Q_Buffer *b, usize off)
+{
+	Mark_Set *ms = &b->marks;
+	if (ms->before + (ms->end - ms->after) == 0) return;
 
-		off += w;
+	_marks_move_gap(b, off);
 
-		if (b->data[r] == '\t')
-			col += 4;
-		else
-			col++;
+	usize len = _buf_len(b);
+	for (usize i = ms->after; i < ms->end && len - ms->items[i].pos == off; ++i) {
+		if (ms->items[i].gravity == Mark_Left)
+			_marks_pull(ms, i, off);
 	}
-
-	_move_gap(b, off);
 }
 
-
-internal usize
-buffer_current_indent_depth(Q_Buffer *buffer, int tab_width)
+// ~geb: [off, off + size) is about to be erased, marks inside it collapse onto `off`
+internal void
+_marks_on_erase(Q_Buffer *b, usize off, usize size)
 {
-	usize start = _line_start(buffer, buffer->gap_pos);
-	usize off = start;
-	usize col = 0;
-
-	while (off < buffer->gap_pos) {
-		usize r = _real(buffer, off);
-		u8 c = buffer->data[r];
+	Mark_Set *ms = &b->marks;
+	if (ms->before + (ms->end - ms->after) == 0) return;
 
-		if (c == ' ') {
-			col += 1;
-			off += 1;
-		}
-		else if (c == '\t') {
-			usize advance = tab_width - (col % tab_width);
-			col += advance;
-			off += 1;
-		}
-		else {
-			break;
-		}
-	}
+	_marks_move_gap(b, off);
 
-	return col / tab_width;
+	usize len = _buf_len(b);
+	while (ms->after < ms->end && len - ms->items[ms->after].pos < off + size)
+		_marks_pull(ms, ms->after, off);
 }
 
-
-internal rune
-buffer_peek(Q_Buffer *buffer)
+internal bool
+_mark_valid(Q_Buffer *b, Mark mark)
 {
-	if (!buffer) return 0;
+	Mark_Set *ms = &b->marks;
+	if (mark == MARK_NONE || mark > ms->ids) return false;
 
-	usize pos = buffer->gap_pos + buffer->gap_size;
-	usize len = buffer->cap;
-
-	if (pos >= len) return 0;
+	usize i = ms->where[mark];
+	bool in_use = i < ms->before || (i >= ms->after && i < ms->end);
+	return in_use && ms->items[i].id == mark;
+}
 
-	UTF8_Error err = 0;
-	rune cp = utf8_decode(buffer->data + pos, &err);
+// ~geb: takes the mark out of the array, its id stays reserved
+internal Mark_Slot
+_marks_take(Q_Buffer *b, Mark mark)
+{
+	Mark_Set *ms = &b->marks;
+	_marks_move_gap(b, _marks_offset(b, ms->where[mark]));
 
-	if (err) return 0;
+	usize i = ms->where[mark];
+	Mark_Slot s = ms->items[i];
+	if (i != ms->after) _marks_put(ms, i, ms->items[ms->after]);
+	ms->after++;
 
-	return cp;
+	return s;
 }
 
-internal rune
-buffer_peek_prev(Q_Buffer *buffer)
+internal void
+_marks_place(Q_Buffer *b, Mark_Slot s, usize offset)
 {
-	return 0;
+	Mark_Set *ms = &b->marks;
+	_marks_move_gap(b, offset);
+
+	s.pos = offset;
+	_marks_put(ms, ms->before++, s);
 }
 
-internal bool
-buffer_iter(Q_Buffer *b, Q_Iterator *it)
+internal Mark
+buffer_mark_add(Q_Buffer *b, usize offset, Mark_Gravity gravity)
 {
-    usize len = _buf_len(b);
-    if (it->offset >= len) return false;
+	Mark_Set *ms = &b->marks;
 
-    usize real = _real(b, it->offset);
-    u8 *ptr = b->data + real;
+	Mark id = ms->free;
+	if (id == MARK_NONE) {
+		if (ms->ids == U32_MAX) return MARK_NONE;
 
-    UTF8_Error err;
-    it->codepoint = utf8_decode(ptr, &err);
-    it->is_on_cursor = (it->offset == b->gap_pos);
+		if (ms->ids + 1 >= ms->where_cap) {
+			usize new_cap = Max(ms->where_cap * 2, 64);
 
-    u32 w = UTF8_LEN_TABLE[*ptr];
-    if (!w) w = 1;
-    it->offset += w;
+			Alloc_Error err = 0;
+			usize *where = alloc_array_nz(b->alloc, usize, new_cap, &err);
+			if (err) return MARK_NONE;
 
-    if (it->codepoint == '\n') {
-        it->position.row++;
-        it->position.col = 0;
-    } else {
-        it->position.col++;
-    }
+			if (ms->where) {
+				MemMove(where, ms->where, ms->where_cap * sizeof(usize));
+				mem_free(b->alloc, ms->where, NULL);
+			}
+			ms->where     = where;
+			ms->where_cap = new_cap;
+		}
+		id = ms->ids + 1;
+	}
 
-    return true;
-}
+	if (!_marks_reserve(b, 1)) return MARK_NONE;
 
+	if (id == ms->free) ms->free = cast(Mark) ms->where[id];
+	else                ms->ids  = id;
 
-internal String8
-buffer_slice(Q_Buffer *buffer, usize begin, usize end, Allocator alloc)
+	Mark_Slot s = { .id = id, .gravity = gravity };
+	_marks_place(b, s, Min(offset, _buf_len(b)));
+	return id;
+}
+
+internal void
+buffer_mark_remove(Q_Buffer *b, Mark mark)
 {
-    Assert(begin <= end);
-    Assert(end <= _buf_len(buffer));
+	if (!_mark_valid(b, mark)) return;
 
-    usize begin_real = _real(buffer, begin);
-    usize end_real   = _real(buffer, end);
+	_marks_take(b, mark);
 
-    usize gap_begin = buffer->gap_pos;
-    usize gap_end   = buffer->gap_pos + buffer->gap_size;
+	b->marks.where[mark] = b->marks.free;
+	b->marks.free = mark;
+}
 
-    usize size = end - begin;
+internal void
+buffer_mark_move(Q_Buffer *b, Mark mark, usize offset)
+{
+	if (!_mark_valid(b, mark)) return;
 
-    if (end_real <= gap_begin)
-    {
-        return (String8){
-            .str  = buffer->data + begin_real,
-            .len = size
-        };
-    }
+	Mark_Slot s = _marks_take(b, mark);
+	_marks_place(b, s, Min(offset, _buf_len(b)));
+}
 
-    if (begin_real >= gap_end)
-    {
-        return (String8){
-            .str  = buffer->data + begin_real,
-            .len = size
-        };
-    }
+internal usize
+buffer_mark_offset(Q_Buffer *b, Mark mark)
+{
+	if (!_mark_valid(b, mark)) return 0;
+	return _marks_offset(b, b->marks.where[mark]);
+}
 
-    u8 *dst = alloc_array_nz(alloc, u8, size, NULL);
+///////////////////////////////////////////////
+// ~geb: Folds
 
-    usize left_size  = gap_begin - begin_real;
-    usize right_size = end_real - gap_end;
+internal usize
+_fold_begin(Q_Buffer *b, Buffer_Fold *f)
+{
+	return buffer_mark_offset(b, f->begin);
+}
 
-	MemMove(dst,
-		 buffer->data + begin_real,
-		 left_size);
+internal usize
+_fold_end(Q_Buffer *b, Buffer_Fold *f)
+{
+	return buffer_mark_offset(b, f->end);
+}
 
-	MemMove(dst + left_size,
-		 buffer->data + gap_end,
-		 right_size);
+// ~geb: index of the first of `count` folds ending after `off`. an edit that
+//       empties a fold drops it, so the ones left stay sorted
+internal usize
+_folds_after(Q_Buffer *b, Buffer_Fold *items, usize count, usize off)
+{
+	usize lo = 0;
+	usize hi = count;
 
-    return (String8){
-        .str  = dst,
-        .len = size
+	while (lo < hi) {
+		usize mid = lo + (hi - lo) / 2;
+		if (_fold_end(b, &items[mid]) <= off) lo = mid + 1;
+		else                                   hi = mid;
+	}
+	return lo;
+}
+
+internal void
+_folds_release(Q_Buffer *b, Buffer_Fold *folds, usize count)
+{
+	for (usize i = 0; i < count; ++i) {
+		_folds_release(b, folds[i].children, folds[i].child_count);
+		if (folds[i].children) mem_free(b->alloc, folds[i].children, NULL);
+	}
+}
+
+internal void
+_folds_free(Q_Buffer *b)
+{
+	Fold_Set *fs = &b->folds;
+	_folds_release(b, fs->items, fs->count);
+	if (fs->items)  mem_free(b->alloc, fs->items, NULL);
+	if (fs->hidden) mem_free(b->alloc, fs->hidden, NULL);
+	MemZeroStruct(fs);
+}
+
+internal bool
+_folds_reserve(Q_Buffer *b, usize count)
+{
+	Fold_Set *fs = &b->folds;
+	if (count <= fs->cap) return true;
+
+	usize new_cap = Max(fs->cap * 2, Max(count, 16));
+
+	Alloc_Error err = 0;
+	Buffer_Fold *items = alloc_array_nz(b->alloc, Buffer_Fold, new_cap, &err);
+	if (err) return false;
+
+	usize *hidden = alloc_array_nz(b->alloc, usize, new_cap + 1, &err);
+	if (err) {
+		mem_free(b->alloc, items, NULL);
+		return false;
+	}
+
+	if (fs->items) {
+		MemMove(items, fs->items, fs->count * sizeof(Buffer_Fold));
+		mem_free(b->alloc, fs->items, NULL);
+		mem_free(b->alloc, fs->hidden, NULL);
+	}
+
+	fs->items  = items;
+	fs->hidden = hidden;
+	fs->cap    = new_cap;
+	fs->stale  = true;
+	return true;
+}
+
+// ~geb: the folds and everything under them go, marks and all
+internal void
+_folds_drop(Q_Buffer *b, Buffer_Fold *folds, usize count)
+{
+	for (usize i = 0; i < count; ++i) {
+		_folds_drop(b, folds[i].children, folds[i].child_count);
+		if (folds[i].children) mem_free(b->alloc, folds[i].children, NULL);
+		buffer_mark_remove(b, folds[i].begin);
+		buffer_mark_remove(b, folds[i].end);
+	}
+}
+
+// ~geb: drops the folds reaching over [lo, hi] that an edit emptied, or
+//       turned inside out by carrying both ends into one replacement. what
+//       was folded under one moves up to its level. `cap` is NULL for the
+//       children of a fold, which are held in an array of just their count
+internal usize
+_folds_prune(Q_Buffer *b, Buffer_Fold **items, usize count, usize *cap, usize lo, usize hi)
+{
+	usize i = lo ? _folds_after(b, *items, count, lo - 1) : 0;
+
+	while (i < count && _fold_begin(b, &(*items)[i]) <= hi) {
+		Buffer_Fold *f = &(*items)[i];
+		f->child_count = _folds_prune(b, &f->children, f->child_count, NULL, lo, hi);
+
+		if (_fold_begin(b, f) < _fold_end(b, f)) {
+			i++;
+			continue;
+		}
+
+		Buffer_Fold gone = *f;
+		buffer_mark_remove(b, gone.begin);
+		buffer_mark_remove(b, gone.end);
+		b->folds.stale = true;
+
+		usize k    = gone.child_count;
+		usize need = count - 1 + k;
+		if (k > 1) {
+			bool room = false;
+			if (cap) {
+				room = _folds_reserve(b, need);
+				*items = b->folds.items;
+			} else {
+				Alloc_Error err = 0;
+				Buffer_Fold *grown = alloc_array_nz(b->alloc, Buffer_Fold, need, &err);
+				if (!err) {
+					MemMove(grown, *items, count * sizeof(Buffer_Fold));
+					mem_free(b->alloc, *items, NULL);
+					*items = grown;
+					room = true;
+				}
+			}
+
+			// ~geb: no room to lift them, they go with it
+			if (!room) {
+				_folds_drop(b, gone.children, k);
+				k = 0;
+				need = count - 1;
+			}
+		}
+
+		MemMove(*items + i + k, *items + i + 1, (count - i - 1) * sizeof(Buffer_Fold));
+		if (k) MemMove(*items + i, gone.children, k * sizeof(Buffer_Fold));
+		if (gone.children) mem_free(b->alloc, gone.children, NULL);
+
+		// ~geb: the lifted ones were pruned already
+		count = need;
+		i += k;
+	}
+	return count;
+}
+
+// ~geb: text went in at `off` or [off, off + size) went out. only a fold
+//       around the edit can have been emptied or hide another number of rows
+internal void
+_folds_on_edit(Q_Buffer *b, usize off, usize newlines, bool erase)
+{
+	Fold_Set *fs = &b->folds;
+	if (!fs->count) return;
+
+	if (erase) fs->count = _folds_prune(b, &fs->items, fs->count, &fs->cap, off, off);
+	if (!newlines || fs->stale) return;
+
+	// ~geb: text typed right at either end of a fold stays in view
+	usize i = _folds_after(b, fs->items, fs->count, erase && off ? off - 1 : off);
+	if (i < fs->count && (erase ? _fold_begin(b, &fs->items[i]) <= off : _fold_begin(b, &fs->items[i]) < off))
+		fs->stale = true;
+}
+
+// ~geb: hidden[i] is how many rows the folds in front of fold i hide. summed
+//       up again only after the folds or the rows inside one changed
+internal void
+_folds_sum(Q_Buffer *b)
+{
+	Fold_Set *fs = &b->folds;
+	if (!fs->stale || !fs->hidden) return;
+
+	fs->hidden[0] = 0;
+	for (usize i = 0; i < fs->count; ++i) {
+		usize first = buffer_row_from_offset(b, _fold_begin(b, &fs->items[i]));
+		usize last  = buffer_row_from_offset(b, _fold_end(b, &fs->items[i]));
+		fs->hidden[i + 1] = fs->hidden[i] + (last - first);
+	}
+	fs->stale = false;
+}
+
+internal bool
+buffer_fold(Q_Buffer *b, usize first_row, usize last_row)
+{
+	usize begin = buffer_row_end(b, first_row);
+	usize end   = buffer_row_end(b, last_row);
+	if (begin >= end) return false;
+
+	// ~geb: the folds it reaches into go under it whole, it grows to fit the ones sticking out
+	Fold_Set *fs = &b->folds;
+	usize lo = _folds_after(b, fs->items, fs->count, begin);
+	usize hi = lo;
+	for (; hi < fs->count && _fold_begin(b, &fs->items[hi]) < end; ++hi) {
+		begin = Min(begin, _fold_begin(b, &fs->items[hi]));
+		end   = Max(end, _fold_end(b, &fs->items[hi]));
+	}
+
+	if (!_folds_reserve(b, fs->count + 1)) return false;
+
+	Buffer_Fold fold = { .child_count = hi - lo };
+	if (fold.child_count) {
+		Alloc_Error err = 0;
+		fold.children = alloc_array_nz(b->alloc, Buffer_Fold, fold.child_count, &err);
+		if (err) return false;
+
+		MemMove(fold.children, fs->items + lo, fold.child_count * sizeof(Buffer_Fold));
+	}
+
+	// ~geb: text typed at the end of the line in view stays in view
+	fold.begin = buffer_mark_add(b, begin, Mark_Right);
+	fold.end   = buffer_mark_add(b, end, Mark_Left);
+	if (fold.begin == MARK_NONE || fold.end == MARK_NONE) {
+		buffer_mark_remove(b, fold.begin);
+		buffer_mark_remove(b, fold.end);
+		if (fold.children) mem_free(b->alloc, fold.children, NULL);
+		return false;
+	}
+
+	MemMove(fs->items + lo + 1, fs->items + hi, (fs->count - hi) * sizeof(Buffer_Fold));
+	fs->items[lo] = fold;
+	fs->count     = fs->count - fold.child_count + 1;
+	fs->stale     = true;
+	return true;
+}
+
+internal bool
+buffer_unfold(Q_Buffer *b, usize line_end)
+{
+	Fold_Set *fs = &b->folds;
+	usize i = _folds_after(b, fs->items, fs->count, line_end);
+	if (i == fs->count || _fold_begin(b, &fs->items[i]) != line_end) return false;
+
+	Buffer_Fold fold = fs->items[i];
+	if (!_folds_reserve(b, fs->count - 1 + fold.child_count)) return false;
+
+	MemMove(fs->items + i + fold.child_count, fs->items + i + 1, (fs->count - i - 1) * sizeof(Buffer_Fold));
+	fs->count = fs->count - 1 + fold.child_count;
+	fs->stale = true;
+
+	if (fold.children) {
+		MemMove(fs->items + i, fold.children, fold.child_count * sizeof(Buffer_Fold));
+		mem_free(b->alloc, fold.children, NULL);
+	}
+	buffer_mark_remove(b, fold.begin);
+	buffer_mark_remove(b, fold.end);
+	return true;
+}
+
+internal bool
+buffer_fold_next(Q_Buffer *b, usize off, usize *begin, usize *end)
+{
+	usize i = _folds_after(b, b->folds.items, b->folds.count, off);
+	if (i == b->folds.count) return false;
+
+	*begin = _fold_begin(b, &b->folds.items[i]);
+	*end   = _fold_end(b, &b->folds.items[i]);
+	return true;
+}
+
+internal usize
+_fold_first_row(Q_Buffer *b, usize i)
+{
+	return buffer_row_from_offset(b, _fold_begin(b, &b->folds.items[i]));
+}
+
+// ~geb: a fold's first row in view never goes down from one fold to the next,
+//       so the folds in front of `visible_row` are found by a binary search
+internal usize
+buffer_row_from_visible(Q_Buffer *b, usize visible_row)
+{
+	Fold_Set *fs = &b->folds;
+	_folds_sum(b);
+
+	usize lo = 0;
+	usize hi = fs->count;
+	while (lo < hi) {
+		usize mid = lo + (hi - lo) / 2;
+		if (_fold_first_row(b, mid) - fs->hidden[mid] < visible_row) lo = mid + 1;
+		else                                                          hi = mid;
+	}
+	return visible_row + (lo ? fs->hidden[lo] : 0);
+}
+
+// ~geb: a hidden row is where the line its fold is on is
+internal usize
+buffer_visible_row(Q_Buffer *b, usize row)
+{
+	Fold_Set *fs = &b->folds;
+	_folds_sum(b);
+
+	usize lo = 0;
+	usize hi = fs->count;
+	while (lo < hi) {
+		usize mid = lo + (hi - lo) / 2;
+		if (_fold_first_row(b, mid) < row) lo = mid + 1;
+		else                               hi = mid;
+	}
+	if (!lo) return row;
+
+	usize first = _fold_first_row(b, lo - 1);
+	usize last  = buffer_row_from_offset(b, _fold_end(b, &fs->items[lo - 1]));
+	if (row <= last) return first - fs->hidden[lo - 1];
+	return row - fs->hidden[lo];
+}
+
+///////////////////////////////////////////////
+// ~geb: Watchers
+
+internal bool
+buffer_watch(Q_Buffer *b, Buffer_Dirty *dirty)
+{
+	for (usize i = 0; i < BUFFER_WATCHERS; ++i) {
+		if (b->watchers[i]) continue;
+
+		b->watchers[i] = dirty;
+		*dirty = (Buffer_Dirty){0};
+		return true;
+	}
+	return false;
+}
+
+internal void
+buffer_unwatch(Q_Buffer *b, Buffer_Dirty *dirty)
+{
+	for (usize i = 0; i < BUFFER_WATCHERS; ++i) {
+		if (b->watchers[i] == dirty) b->watchers[i] = NULL;
+	}
+}
+
+// ~geb: `size` bytes inserted or erased at `off`, `rows` newlines more or fewer.
+//       an edit in front of a dirty range pulls its start along, the range
+//       only ever grows to cover whatever moved in between
+internal void
+_watchers_on_edit(Q_Buffer *b, usize off, usize size, isize rows, bool erase)
+{
+	for (usize i = 0; i < BUFFER_WATCHERS; ++i) {
+		Buffer_Dirty *d = b->watchers[i];
+		if (!d) continue;
+
+		if (!d->any) {
+			*d = (Buffer_Dirty){ .any = true, .begin = off, .end = erase ? off : off + size, .rows = rows };
+			continue;
+		}
+
+		if (!erase)                 d->end = off <= d->end ? d->end + size : off + size;
+		else if (off + size <= d->end) d->end -= size;
+		else                        d->end = off;
+
+		d->begin = Min(d->begin, off);
+		d->rows += rows;
+	}
+}
+
+///////////////////////////////////////////////
+
+internal bool
+_grow(Q_Buffer *b, usize need)
+{
+    if (b->gap_size >= need) return true;
+
+    usize new_cap = b->cap * 2 + need;
+
+    Alloc_Error err = 0;
+    u8 *data = alloc_array_nz(b->alloc, u8, new_cap, &err);
+    if (err) return false;
+
+    usize before = b->gap_pos - b->orig_head;
+    usize after  = b->cap - (before + b->gap_size);
+    usize gap    = new_cap - (before + after);
+
+    MemMove(data, b->data, before);
+    MemMove(data + before + gap, b->data + before + b->gap_size, after);
+
+    mem_free(b->alloc, b->data, NULL);
+
+    b->data     = data;
+    b->cap      = new_cap;
+    b->gap_size = gap;
+    return true;
+}
+
+// ~geb: makes room for `front` bytes before the gap and `back` bytes after it.
+//       heap buffers reallocate, virtual ones just commit the pages at either end
+internal bool
+_make_room(Q_Buffer *b, usize front, usize back)
+{
+	if (front + back > b->cap) {
+		if (b->flags & Buffer_Flag_Virtual) return false;
+		return _grow(b, front + back - _data_len(b));
+	}
+
+	if (!(b->flags & Buffer_Flag_Virtual)) return true;
+
+	if (front > b->commit_front) {
+		usize to = Min(AlignPow2(front, BUFFER_COMMIT_BLOCK), b->cap);
+		if (os_commit(b->data + b->commit_front, to - b->commit_front) != 0) return false;
+		b->commit_front = to;
+	}
+
+	if (back > b->commit_back) {
+		usize to = Min(AlignPow2(back, BUFFER_COMMIT_BLOCK), b->cap);
+		if (os_commit(b->data + b->cap - to, to - b->commit_back) != 0) return false;
+		b->commit_back = to;
+	}
+
+	return true;
+}
+
+// ~geb: hands back pages the gap has moved away from
+internal void
+_trim_commit(Q_Buffer *b)
+{
+	if (!(b->flags & Buffer_Flag_Virtual)) return;
+	if (b->commit_front + b->commit_back >= b->cap) return;
+
+	usize front = b->gap_pos - b->orig_head;
+	usize back  = _data_len(b) - front;
+
+	usize keep_front = AlignPow2(front + BUFFER_COMMIT_SLACK, BUFFER_COMMIT_BLOCK);
+	if (b->commit_front > keep_front) {
+		os_decommit(b->data + keep_front, b->commit_front - keep_front);
+		b->commit_front = keep_front;
+	}
+
+	usize keep_back = AlignPow2(back + BUFFER_COMMIT_SLACK, BUFFER_COMMIT_BLOCK);
+	if (b->commit_back > keep_back) {
+		os_decommit(b->data + b->cap - b->commit_back, b->commit_back - keep_back);
+		b->commit_back = keep_back;
+	}
+}
+
+// ~geb: `off` must lie inside the edit window
+internal bool
+_move_gap(Q_Buffer *b, usize off)
+{
+    if (off == b->gap_pos) return true;
+
+    usize at  = off - b->orig_head;
+    usize gap = b->gap_pos - b->orig_head;
+
+    if (!_make_room(b, at, _data_len(b) - at)) return false;
+
+    _lines_move_gap(b, off);
+
+    if (at < gap) {
+        usize n = gap - at;
+        MemMove(b->data + at + b->gap_size,
+                b->data + at,
+                n);
+    } else {
+        usize n = at - gap;
+        MemMove(b->data + gap,
+                b->data + gap + b->gap_size,
+                n);
+    }
+
+    b->gap_pos = off;
+    return true;
+}
+
+internal void
+_mapping_release(Buffer_Mapping *m, Allocator alloc)
+{
+	if (!m || --m->refs) return;
+
+	os_file_unmap(m->bytes.str, m->bytes.len);
+	mem_free(alloc, m, NULL);
+}
+
+internal void
+_release_orig(Q_Buffer *b)
+{
+	_loader_stop(b);
+	_mapping_release(b->mapping, b->alloc);
+	b->mapping = NULL;
+	b->orig = (String8){0};
+	b->orig_head = b->orig_tail = 0;
+}
+
+// ~geb: makes sure `off` lies inside the edit window, copying in only the
+//       original bytes between the window and `off`
+internal bool
+_edit_window(Q_Buffer *b, usize off)
+{
+	if (!b->orig.len) return true;
+
+	if (!_data_len(b) && b->orig_head == b->orig_tail) {
+		// ~geb: nothing was edited yet, the window can be re-anchored for free
+		_lines_move_gap(b, off);
+		b->gap_pos = b->orig_head = b->orig_tail = off;
+		return true;
+	}
+
+	if (off < b->orig_head) {
+		usize n = b->orig_head - off;
+		if (!_make_room(b, 0, _data_len(b) + n)) return false;
+
+		_move_gap(b, b->orig_head);
+		MemMove(b->data + b->gap_size - n, b->orig.str + off, n);
+
+		_lines_move_gap(b, off);
+		b->gap_size -= n;
+		b->gap_pos   = off;
+		b->orig_head = off;
+	}
+
+	usize win_end = b->orig_head + _data_len(b);
+	if (off > win_end) {
+		usize n = off - win_end;
+		if (!_make_room(b, _data_len(b) + n, 0)) return false;
+
+		_move_gap(b, win_end);
+		MemMove(b->data + (win_end - b->orig_head), b->orig.str + b->orig_tail, n);
+
+		_lines_move_gap(b, off);
+		b->gap_size  -= n;
+		b->gap_pos    = off;
+		b->orig_tail += n;
+	}
+
+	if (b->orig_head == 0 && b->orig_tail == b->orig.len)
+		_release_orig(b);
+
+	return true;
+}
+
+// ~geb: the text as up to four contiguous spans, in order
+internal usize
+_spans(Q_Buffer *b, String8 out[4])
+{
+	usize count = 0;
+	usize pre   = b->gap_pos - b->orig_head;
+	usize post  = _data_len(b) - pre;
+
+	String8 all[4] = {
+		str8(b->orig.str, b->orig_head),
+		str8(b->data, pre),
+		str8(b->data + pre + b->gap_size, post),
+		str8(b->orig.str + b->orig_tail, b->orig.len - b->orig_tail),
+	};
+
+	for (usize i = 0; i < 4; ++i) {
+		if (all[i].len) out[count++] = all[i];
+	}
+
+	return count;
+}
+
+// ~geb: brings the gap over to `off`, only ever called right before an edit
+//       lands there so moving around the text never shuffles any bytes
+internal bool
+_gap_to(Q_Buffer *b, usize off)
+{
+	if (off == b->gap_pos) return true;
+
+	if (!_edit_window(b, off)) return false;
+	if (!_move_gap(b, off)) return false;
+
+	_trim_commit(b);
+	return true;
+}
+
+internal void
+_move_cursor(Q_Buffer *b, usize off)
+{
+	// ~geb: typing somewhere else is a new undo step
+	if (off != b->cursor) b->history.open = false;
+
+	b->cursor = off;
+}
+
+////////////////////////////////
+// ~geb: undo history
+
+internal Edit_Record *
+_history_at(Q_Buffer *b, usize pos)
+{
+	Arena *arena = cast(Arena *) b->history.log.data;
+	return cast(Edit_Record *) (arena->base + pos);
+}
+
+internal usize
+_history_end(Q_Buffer *b, usize pos)
+{
+	if (pos == HISTORY_NONE) return 0;
+	return pos + sizeof(Edit_Record) + _history_at(b, pos)->len;
+}
+
+internal usize
+_history_next(Q_Buffer *b, usize pos)
+{
+	return AlignPow2(_history_end(b, pos), AlignOf(Edit_Record));
+}
+
+internal void
+_history_clear(Q_Buffer *b)
+{
+	Arena *arena = cast(Arena *) b->history.log.data;
+	if (arena) arena->pos = 0;
+
+	b->history.top  = HISTORY_NONE;
+	b->history.open = false;
+}
+
+// ~geb: logs an edit of `len` bytes at `offset` that is about to happen and
+//       returns where its text has to be copied, NULL when there is nothing
+//       to copy. typing next to the top record grows it in place, erasing
+//       the tail of what was just typed shrinks it instead of logging more.
+internal u8 *
+_history_record(Q_Buffer *b, Edit_Kind kind, usize offset, usize len)
+{
+	Edit_History *h = &b->history;
+	if (!h->log.data || h->applying || !len) return NULL;
+
+	Arena *arena = cast(Arena *) h->log.data;
+	arena->pos = _history_end(b, h->top);
+
+	if (h->open && h->top != HISTORY_NONE) {
+		Edit_Record *r = _history_at(b, h->top);
+		u8 *text = cast(u8 *) (r + 1);
+
+		if (r->group == h->group && r->kind == Edit_Insert && kind == Edit_Erase &&
+			offset >= r->offset && offset + len == r->offset + r->len)
+		{
+			r->len -= len;
+			arena->pos -= len;
+
+			if (!r->len) {
+				arena->pos = h->top;
+				h->top = r->prev;
+			}
+			return NULL;
+		}
+
+		bool same    = r->group == h->group && r->kind == kind;
+		bool append  = same && offset == r->offset + (kind == Edit_Insert ? r->len : 0);
+		bool prepend = same && kind == Edit_Erase && offset + len == r->offset;
+
+		if (append || prepend) {
+			usize size = sizeof(Edit_Record) + r->len;
+
+			Alloc_Error err = 0;
+			mem_resize_aligned(h->log, r, size, size + len, AlignOf(Edit_Record), false, &err);
+			if (err) {
+				_history_clear(b);
+				return NULL;
+			}
+
+			u8 *dst = text + r->len;
+			if (prepend) {
+				MemMove(text + len, text, r->len);
+				r->offset = offset;
+				dst = text;
+			}
+
+			r->len += len;
+			return dst;
+		}
+	}
+
+	if (!h->open) {
+		h->group++;
+		h->open = true;
+	}
+
+	Alloc_Error err = 0;
+	Edit_Record *r = cast(Edit_Record *) mem_alloc_aligned(h->log, sizeof(Edit_Record) + len, AlignOf(Edit_Record), false, &err);
+	if (err) {
+		_history_clear(b);
+		return NULL;
+	}
+
+	*r = (Edit_Record) {
+		.prev   = h->top,
+		.offset = offset,
+		.len    = len,
+		.group  = h->group,
+		.kind   = kind,
+	};
+
+	h->top = cast(usize) (cast(u8 *) r - arena->base);
+	return cast(u8 *) (r + 1);
+}
+
+// ~geb: records in a group are laid down in the order they were made, so
+//       reverting them back to front (and replaying them front to back)
+//       walks the gap across the touched range once, however many there are
+internal void
+_history_apply(Q_Buffer *b, Edit_Record *r, bool revert, int tab_width)
+{
+	String8 text = str8(cast(u8 *) (r + 1), r->len);
+
+	if ((r->kind == Edit_Insert) != revert)
+		buffer_replace_range(b, r->offset, r->offset, text, tab_width);
+	else
+		buffer_erase_range(b, r->offset, r->offset + r->len);
+}
+
+internal usize
+_line_start(Q_Buffer *b, usize off)
+{
+	return buffer_offset_from_row(b, buffer_row_from_offset(b, off));
+}
+
+internal usize
+_next_line_start(Q_Buffer *b, usize off)
+{
+	usize row = buffer_row_from_offset(b, off);
+	usize end = buffer_row_end(b, row);
+	return end < _buf_len(b) ? end + 1 : end;
+}
+
+// ~geb: column reached at `to`, `from` sitting at column `col`
+internal usize
+_columns(Q_Buffer *b, usize from, usize to, usize col, int tab_width)
+{
+	for (Q_Span_Iterator it = buffer_spans(b, from, to); buffer_span_next(b, &it);) {
+		u8 *p = it.span.str;
+
+		for (usize i = 0; i < it.span.len; ++i) {
+			u8 c = p[i];
+
+			if (c == '\t')
+				col += (usize) (tab_width - (col % tab_width));
+			else if ((c & 0xC0) != 0x80)
+				col++;
+		}
+	}
+
+	return col;
+}
+
+///////////////////////////////////////////////
+// ~geb: Column checkpoints
+
+internal Column_Checkpoints *
+_checkpoints_for(Q_Buffer *b, usize line_start, int tab_width)
+{
+	Column_Cache *cc = &b->columns;
+
+	if (cc->tab_width != tab_width) {
+		for (usize i = 0; i < COLUMN_CACHE_LINES; ++i)
+			cc->lines[i].count = 0;
+		cc->tab_width = tab_width;
+	}
+
+	Column_Checkpoints *slot = &cc->lines[0];
+	for (usize i = 0; i < COLUMN_CACHE_LINES; ++i) {
+		Column_Checkpoints *cp = &cc->lines[i];
+		if (cp->used && cp->line_start == line_start) {
+			cp->used = ++cc->clock;
+			return cp;
+		}
+		if (cp->used < slot->used) slot = cp;
+	}
+
+	slot->line_start = line_start;
+	slot->count = 0;
+	slot->used  = ++cc->clock;
+	return slot;
+}
+
+// ~geb: makes sure the first `count` checkpoints of the line exist
+internal void
+_checkpoints_extend(Q_Buffer *b, Column_Checkpoints *cp, usize count)
+{
+	if (count > cp->cap) {
+		usize new_cap = Max(count, cp->cap * 2);
+
+		Alloc_Error err = 0;
+		usize *cols = alloc_array_nz(b->alloc, usize, new_cap, &err);
+		if (err) return;
+
+		if (cp->cols) {
+			MemMove(cols, cp->cols, cp->count * sizeof(usize));
+			mem_free(b->alloc, cp->cols, NULL);
+		}
+		cp->cols = cols;
+		cp->cap  = new_cap;
+	}
+
+	while (cp->count < count) {
+		usize from = cp->line_start + cp->count * COLUMN_CHECKPOINT_STRIDE;
+		usize col  = cp->count ? cp->cols[cp->count - 1] : 0;
+
+		cp->cols[cp->count] = _columns(b, from, from + COLUMN_CHECKPOINT_STRIDE, col, b->columns.tab_width);
+		cp->count++;
+	}
+}
+
+// ~geb: an edit of `size` bytes at `off`, checkpoints in front of it still
+//       hold, the ones past it are dropped and rebuilt on the next lookup
+internal void
+_checkpoints_on_edit(Q_Buffer *b, usize off, usize size, bool erase)
+{
+	for (usize i = 0; i < COLUMN_CACHE_LINES; ++i) {
+		Column_Checkpoints *cp = &b->columns.lines[i];
+		if (!cp->used) continue;
+
+		if (off >= cp->line_start) {
+			cp->count = Min(cp->count, (off - cp->line_start) / COLUMN_CHECKPOINT_STRIDE);
+		}
+		else if (!erase) {
+			cp->line_start += size;
+		}
+		else if (off + size < cp->line_start) {
+			cp->line_start -= size;
+		}
+		else {
+			cp->used  = 0; // ~geb: the newline in front of the line went away
+			cp->count = 0;
+		}
+	}
+}
+
+internal void
+_checkpoints_free(Q_Buffer *b)
+{
+	for (usize i = 0; i < COLUMN_CACHE_LINES; ++i) {
+		if (b->columns.lines[i].cols)
+			mem_free(b->alloc, b->columns.lines[i].cols, NULL);
+	}
+	MemZeroStruct(&b->columns);
+}
+
+// ~geb: visual column of `off`, which lies on the line starting at `line_start`
+internal usize
+_column_at(Q_Buffer *b, usize line_start, usize off, int tab_width)
+{
+	usize k = (off - line_start) / COLUMN_CHECKPOINT_STRIDE;
+	if (!k) return _columns(b, line_start, off, 0, tab_width);
+
+	Column_Checkpoints *cp = _checkpoints_for(b, line_start, tab_width);
+	_checkpoints_extend(b, cp, k);
+
+	k = Min(k, cp->count);
+	usize from = line_start + k * COLUMN_CHECKPOINT_STRIDE;
+	usize col  = k ? cp->cols[k - 1] : 0;
+
+	return _columns(b, from, off, col, tab_width);
+}
+
+// ~geb: first offset on [line_start, line_end] whose column reaches `goal`
+internal usize
+_offset_at_column(Q_Buffer *b, usize line_start, usize line_end, usize goal, int tab_width)
+{
+	usize off = line_start;
+	usize col = 0;
+
+	if (line_end - line_start > COLUMN_CHECKPOINT_STRIDE) {
+		Column_Checkpoints *cp = _checkpoints_for(b, line_start, tab_width);
+		usize full = (line_end - line_start) / COLUMN_CHECKPOINT_STRIDE;
+
+		while (cp->count < full && (!cp->count || cp->cols[cp->count - 1] < goal)) {
+			usize before = cp->count;
+			_checkpoints_extend(b, cp, Min(full, Max(cp->count * 2, 16)));
+			if (cp->count == before) break;
+		}
+
+		// ~geb: the last checkpoint still short of the goal is where the walk starts
+		usize lo = 0, hi = cp->count;
+		while (lo < hi) {
+			usize mid = lo + (hi - lo) / 2;
+			if (cp->cols[mid] < goal) lo = mid + 1;
+			else                      hi = mid;
+		}
+
+		if (lo) {
+			off = line_start + lo * COLUMN_CHECKPOINT_STRIDE;
+			col = cp->cols[lo - 1];
+			while (off < line_end && (_byte(b, off) & 0xC0) == 0x80)
+				off++;
+		}
+	}
+
+	while (off < line_end && col < goal) {
+		u8 c = _byte(b, off);
+		u32 w = UTF8_LEN_TABLE[c];
+		if (!w) w = 1;
+
+		if (c == '\t')
+			col += (usize) (tab_width - (col % tab_width));
+		else
+			col++;
+		off += w;
+	}
+
+	return Min(off, line_end);
+}
+
+internal usize
+_current_column(Q_Buffer *b, int tab_width)
+{
+	return _column_at(b, _line_start(b, b->cursor), b->cursor, tab_width);
+}
+
+// ~geb: fresh, empty text storage of at least `cap` bytes, reserved
+//       address space when it fits so it can grow in place
+internal bool
+_storage_alloc(Q_Buffer *b, usize cap)
+{
+	b->data  = NULL;
+	b->flags &= ~Buffer_Flag_Virtual;
+	b->commit_front = b->commit_back = 0;
+
+	if (ARCH_64BIT && cap <= BUFFER_RESERVE_SIZE / 2) {
+		b->data = os_reserve(BUFFER_RESERVE_SIZE);
+		if (b->data) {
+			b->flags |= Buffer_Flag_Virtual;
+			cap = BUFFER_RESERVE_SIZE;
+		}
+	}
+
+	if (!b->data) {
+		Alloc_Error err = 0;
+		b->data = alloc_array_nz(b->alloc, u8, cap, &err);
+		if (err) return false;
+	}
+
+	b->cap      = cap;
+	b->gap_size = cap;
+	return true;
+}
+
+internal void
+_storage_release(Q_Buffer *b)
+{
+	if (b->flags & Buffer_Flag_Virtual)
+		os_release(b->data, b->cap);
+	else
+		mem_free(b->alloc, b->data, NULL);
+}
+
+internal Q_Buffer *
+_buffer_alloc(String8 name, usize cap, Q_Buffer *cur, Allocator alloc)
+{
+    usize size = sizeof(Q_Buffer) + name.len;
+
+    Alloc_Error err = 0;
+    Q_Buffer *b = cast(Q_Buffer *) mem_alloc_aligned(alloc, size, AlignOf(Q_Buffer), false, &err);
+    if (err) return NULL;
+
+    MemZeroStruct(b);
+    b->alloc = alloc;
+
+    if (!_storage_alloc(b, cap)) {
+        mem_free(alloc, b, NULL);
+        return NULL;
+    }
+
+    b->history.log = arena_allocator(HISTORY_RESERVE_SIZE);
+    b->history.top = HISTORY_NONE;
+	b->name = str8(cast(u8 *) b + sizeof(Q_Buffer), name.len);
+	MemMove(b->name.str, name.str, name.len);
+
+    if (cur) {
+        b->prev = cur;
+        b->next = cur->next;
+        if (b->next) b->next->prev = b;
+        cur->next = b;
+    }
+
+    return b;
+}
+
+internal Q_Buffer *
+buffer_make(String8 name, String8 src, Q_Buffer *cur, Allocator alloc)
+{
+    Q_Buffer *b = _buffer_alloc(name, Max(src.len * 2, Kb(4)), cur, alloc);
+    if (!b) return NULL;
+
+    if (!_make_room(b, 0, src.len)) {
+        buffer_delete(b);
+        return NULL;
+    }
+
+    b->gap_size -= src.len;
+    MemMove(b->data + b->gap_size, src.str, src.len);
+
+    b->lines.unscanned = src.len;
+
+    return b;
+}
+
+// ~geb: takes ownership of `mapping`, nothing in it is read or copied
+//       until it is looked at or edited
+internal Q_Buffer *
+buffer_make_mapped(String8 name, String8 mapping, Q_Buffer *cur, Allocator alloc)
+{
+    Buffer_Mapping *m = cast(Buffer_Mapping *) mem_alloc_aligned(alloc, sizeof(Buffer_Mapping), AlignOf(Buffer_Mapping), false, NULL);
+    Q_Buffer *b = m ? _buffer_alloc(name, Kb(4), cur, alloc) : NULL;
+    if (!b) {
+        if (m) mem_free(alloc, m, NULL);
+        os_file_unmap(mapping.str, mapping.len);
+        return NULL;
+    }
+
+    *m = (Buffer_Mapping){ .bytes = mapping, .refs = 1 };
+    b->mapping = m;
+    b->orig    = mapping;
+    b->lines.unscanned = mapping.len;
+
+    _loader_start(b);
+
+    return b;
+}
+
+internal void
+buffer_delete(Q_Buffer *b)
+{
+	if (!b) return;
+
+	if (b->prev) b->prev->next = b->next;
+	if (b->next) b->next->prev = b->prev;
+
+	_loader_stop(b);
+	_release_orig(b);
+	_lines_free(b);
+	_folds_free(b);
+	_marks_free(b);
+	_checkpoints_free(b);
+	arena_allocator_release(b->history.log);
+	_storage_release(b);
+
+	mem_free(b->alloc, b, NULL);
+}
+
+internal void
+buffer_insert(Q_Buffer *b, String8 text, int tab_width)
+{
+    if (!_gap_to(b, b->cursor)) return;
+
+    usize front = b->gap_pos - b->orig_head;
+    if (!_make_room(b, front + text.len, _data_len(b) - front)) return;
+
+    u8 *logged = _history_record(b, Edit_Insert, b->gap_pos, text.len);
+    if (logged) MemMove(logged, text.str, text.len);
+
+    // ~geb: a finished line is its own undo step
+    if (logged && mem_find_byte(text.str, text.len, '\n') < text.len)
+        b->history.open = false;
+
+    MemMove(b->data + front, text.str, text.len);
+
+    usize newlines = _lines_on_insert(b, text);
+    _marks_on_insert(b, b->gap_pos);
+    _checkpoints_on_edit(b, b->gap_pos, text.len, false);
+    _watchers_on_edit(b, b->gap_pos, text.len, cast(isize) newlines, false);
+
+    b->gap_pos  += text.len;
+    b->gap_size -= text.len;
+    b->cursor    = b->gap_pos;
+    _folds_on_edit(b, b->gap_pos - text.len, newlines, false);
+
+    b->goal_col = _current_column(b, tab_width);
+    b->goal_col_valid = true;
+}
+
+// ~geb: removes the `size` bytes right after the gap in one step
+internal void
+_erase(Q_Buffer *b, usize size)
+{
+    u8 *logged = _history_record(b, Edit_Erase, b->gap_pos, size);
+    if (logged) {
+        for (Q_Span_Iterator it = buffer_spans(b, b->gap_pos, b->gap_pos + size); buffer_span_next(b, &it);)
+            MemMove(logged + (it.offset - b->gap_pos), it.span.str, it.span.len);
+    }
+
+    usize newlines = _lines_on_erase(b, size);
+    _marks_on_erase(b, b->gap_pos, size);
+    _checkpoints_on_edit(b, b->gap_pos, size, true);
+    _watchers_on_edit(b, b->gap_pos, size, -cast(isize) newlines, true);
+
+    // ~geb: whatever is not in the window is dropped from the original span
+    usize post = b->cap - (b->gap_pos - b->orig_head) - b->gap_size;
+    usize from_data = Min(size, post);
+
+    b->gap_size  += from_data;
+    b->orig_tail += size - from_data;
+
+    _folds_on_edit(b, b->gap_pos, newlines, true);
+}
+
+internal void
+buffer_erase(Q_Buffer *b)
+{
+    usize len = _buf_len(b);
+    if (b->cursor >= len) return;
+    if (!_gap_to(b, b->cursor)) return;
+
+    _erase(b, Min(_width_at(b, b->cursor), len - b->cursor));
+}
+
+internal void
+buffer_erase_range(Q_Buffer *b, usize begin, usize end)
+{
+	usize len = _buf_len(b);
+	end   = Min(end, len);
+	begin = Min(begin, end);
+
+	if (!_gap_to(b, begin)) return;
+	b->cursor = begin;
+
+	if (end > begin) _erase(b, end - begin);
+
+	b->goal_col_valid = false;
+}
+
+internal void
+buffer_replace_range(Q_Buffer *b, usize begin, usize end, String8 text, int tab_width)
+{
+	buffer_erase_range(b, begin, end);
+	if (b->cursor != Min(begin, _buf_len(b))) return;
+
+	if (text.len) buffer_insert(b, text, tab_width);
+}
+
+// ~geb: reverts the newest undo step, leaves the cursor where it started
+internal bool
+buffer_undo(Q_Buffer *b, int tab_width)
+{
+	Edit_History *h = &b->history;
+	if (h->top == HISTORY_NONE) return false;
+
+	u32 group = _history_at(b, h->top)->group;
+
+	h->applying = true;
+	while (h->top != HISTORY_NONE) {
+		Edit_Record *r = _history_at(b, h->top);
+		if (r->group != group) break;
+
+		_history_apply(b, r, true, tab_width);
+		h->top = r->prev;
+	}
+	h->applying = false;
+	h->open = false;
+
+	return true;
+}
+
+internal bool
+buffer_redo(Q_Buffer *b, int tab_width)
+{
+	Edit_History *h = &b->history;
+	if (!h->log.data) return false;
+
+	Arena *arena = cast(Arena *) h->log.data;
+	usize pos = _history_next(b, h->top);
+	if (pos >= arena->pos) return false;
+
+	u32 group = _history_at(b, pos)->group;
+
+	h->applying = true;
+	while (pos < arena->pos) {
+		Edit_Record *r = _history_at(b, pos);
+		if (r->group != group) break;
+
+		_history_apply(b, r, false, tab_width);
+		h->top = pos;
+		pos = _history_next(b, pos);
+	}
+	h->applying = false;
+	h->open = false;
+
+	return true;
+}
+
+// ~geb: the next edit starts a new undo step
+internal void
+buffer_history_break(Q_Buffer *b)
+{
+	b->history.open = false;
+}
+
+// ~geb: offset `count` codepoints away from `off`, clamped to the buffer
+internal usize
+buffer_offset_by_codepoints(Q_Buffer *b, usize off, isize count)
+{
+	usize len = _buf_len(b);
+
+	for (; count < 0 && off > 0; ++count) {
+		off--;
+		while (off && (_byte(b, off) & 0xC0) == 0x80)
+			off--;
+	}
+
+	for (; count > 0 && off < len; --count)
+		off = Min(off + _width_at(b, off), len);
+
+	return off;
+}
+
+internal void
+buffer_set_cursor(Q_Buffer *b, usize off)
+{
+	_move_cursor(b, Min(off, _buf_len(b)));
+	b->goal_col_valid = false;
+}
+
+// ~geb: offset at the same visual column `rows` lines away from `off`
+internal usize
+buffer_offset_by_rows(Q_Buffer *b, usize off, isize rows, int tab_width)
+{
+	usize row   = buffer_row_from_offset(b, off);
+	usize start = buffer_offset_from_row(b, row);
+	usize col   = _column_at(b, start, off, tab_width);
+
+	usize target = rows < 0
+		? row - Min(row, cast(usize) -rows)
+		: row + cast(usize) rows;
+
+	usize target_start = buffer_offset_from_row(b, target);
+	usize target_end   = buffer_row_end(b, buffer_row_from_offset(b, target_start));
+
+	return _offset_at_column(b, target_start, target_end, col, tab_width);
+}
+
+///////////////////////////////////////////////
+// ~geb: Multi cursor edits
+//
+// the cursors are sorted, so walking them front to back only ever moves the
+// gap forward: one keystroke at N cursors costs a single pass over the text
+// between the first and the last one. every edit of a sweep lands in the
+// same undo step, undoing it walks the gap back once.
+
+internal usize
+_cursors_dedupe(usize *cursors, usize count)
+{
+	usize n = 0;
+	for (usize i = 0; i < count; ++i) {
+		if (!n || cursors[n - 1] != cursors[i])
+			cursors[n++] = cursors[i];
+	}
+	return n;
+}
+
+internal usize
+buffer_insert_multi(Q_Buffer *b, usize *cursors, usize count, usize primary, String8 text, int tab_width)
+{
+	if (!count || !text.len) return count;
+
+	buffer_history_break(b);
+	u32 group = b->history.group;
+
+	usize shift = 0;
+	for (usize i = 0; i < count; ++i) {
+		usize len = _buf_len(b);
+
+		b->cursor = Min(cursors[i] + shift, len);
+		buffer_insert(b, text, tab_width);
+		b->history.open = b->history.group != group; // ~geb: once the sweep has logged something
+
+		cursors[i] = b->cursor;
+		shift += _buf_len(b) - len;
+	}
+
+	b->cursor = cursors[Min(primary, count - 1)];
+	b->goal_col_valid = false;
+
+	return _cursors_dedupe(cursors, count);
+}
+
+// ~geb: erases `codepoints` away from every cursor, negative goes backwards
+internal usize
+buffer_erase_multi(Q_Buffer *b, usize *cursors, usize count, usize primary, isize codepoints)
+{
+	if (!count || !codepoints) return count;
+
+	buffer_history_break(b);
+	u32 group = b->history.group;
+
+	usize removed = 0;
+	usize fence   = 0; // ~geb: where the cursor before ended up, never erase past it
+	for (usize i = 0; i < count; ++i) {
+		usize at    = Max(cursors[i] - Min(cursors[i], removed), fence);
+		usize other = buffer_offset_by_codepoints(b, at, codepoints);
+
+		usize begin = Max(Min(at, other), fence);
+		usize end   = Max(Max(at, other), begin);
+
+		usize len = _buf_len(b);
+		buffer_erase_range(b, begin, end);
+		b->history.open = b->history.group != group;
+
+		cursors[i] = begin;
+		removed += len - _buf_len(b);
+		fence    = begin;
+	}
+
+	b->cursor = cursors[Min(primary, count - 1)];
+	b->goal_col_valid = false;
+
+	return _cursors_dedupe(cursors, count);
+}
+
+internal void
+buffer_move_left(Q_Buffer *b, int tab_width)
+{
+    if (b->cursor == 0) return;
+
+    usize pos = b->cursor - 1;
+
+    while (pos && (_byte(b, pos) & 0xC0) == 0x80)
+        pos--;
+
+    _move_cursor(b, pos);
+
+    b->goal_col = _current_column(b, tab_width);
+    b->goal_col_valid = true;
+}
+
+internal void
+buffer_move_right(Q_Buffer *b, int tab_width)
+{
+    usize len = _buf_len(b);
+    if (b->cursor >= len) return;
+
+    usize w = _width_at(b, b->cursor);
+
+    _move_cursor(b, Min(b->cursor + w, len));
+
+    b->goal_col = _current_column(b, tab_width);
+    b->goal_col_valid = true;
+}
+
+internal void
+buffer_move_up(Q_Buffer *b, int tab_width)
+{
+    usize cur_start = _line_start(b, b->cursor);
+    if (cur_start == 0) return;
+
+    if (!b->goal_col_valid) {
+        b->goal_col = _current_column(b, tab_width);
+        b->goal_col_valid = true;
+    }
+
+    usize prev_end = cur_start - 1;
+
+    // ~geb: a fold right above is stepped over onto the line it leaves in view
+    usize fold_begin = 0, fold_end = 0;
+    if (prev_end && buffer_fold_next(b, prev_end - 1, &fold_begin, &fold_end) && fold_end == prev_end)
+        prev_end = fold_begin;
+
+    usize prev_start = _line_start(b, prev_end);
+
+    _move_cursor(b, _offset_at_column(b, prev_start, prev_end, b->goal_col, tab_width));
+}
+
+internal void
+buffer_move_down(Q_Buffer *b, int tab_width)
+{
+	usize len = _buf_len(b);
+
+	usize next_start = _next_line_start(b, b->cursor);
+	if (next_start >= len) return;
+
+	// ~geb: the lines a fold hides below are stepped over as one
+	usize fold_begin = 0, fold_end = 0;
+	if (buffer_fold_next(b, next_start - 1, &fold_begin, &fold_end) && fold_begin == next_start - 1) {
+		if (fold_end >= len) return;
+		next_start = fold_end + 1;
+	}
+
+	if (!b->goal_col_valid) {
+		b->goal_col = _current_column(b, tab_width);
+		b->goal_col_valid = true;
+	}
+
+	usize next_end = buffer_row_end(b, buffer_row_from_offset(b, next_start));
+
+	_move_cursor(b, _offset_at_column(b, next_start, next_end, b->goal_col, tab_width));
+}
+
+internal usize
+buffer_len(Q_Buffer *b)
+{
+	return _buf_len(b);
+}
+
+internal usize
+buffer_line_count(Q_Buffer *b)
+{
+	_lines_scan_to(b, _buf_len(b));
+	return _lines_newline_count(b) + 1;
+}
+
+internal usize
+buffer_row_from_offset(Q_Buffer *b, usize off)
+{
+	_lines_scan_to(b, off);
+
+	usize lo = 0;
+	usize hi = _lines_newline_count(b);
+
+	while (lo < hi) {
+		usize mid = lo + (hi - lo) / 2;
+		if (_lines_newline(b, mid) < off) lo = mid + 1;
+		else                              hi = mid;
+	}
+
+	return lo;
+}
+
+internal usize
+buffer_offset_from_row(Q_Buffer *b, usize row)
+{
+	if (row == 0) return 0;
+
+	_lines_scan_rows(b, row);
+
+	usize count = _lines_newline_count(b);
+	if (row > count) row = count;
+	if (row == 0) return 0;
+
+	return _lines_newline(b, row - 1) + 1;
+}
+
+// ~geb: offset of the newline ending `row`, or the buffer length on the last row
+internal usize
+buffer_row_end(Q_Buffer *b, usize row)
+{
+	_lines_scan_rows(b, row + 1);
+
+	if (row >= _lines_newline_count(b)) return _buf_len(b);
+	return _lines_newline(b, row);
+}
+
+internal usize
+buffer_current_indent_depth(Q_Buffer *buffer, int tab_width)
+{
+	usize start = _line_start(buffer, buffer->cursor);
+	usize off = start;
+	usize col = 0;
+
+	while (off < buffer->cursor) {
+		u8 c = _byte(buffer, off);
+
+		if (c == ' ') {
+			col += 1;
+			off += 1;
+		}
+		else if (c == '\t') {
+			usize advance = tab_width - (col % tab_width);
+			col += advance;
+			off += 1;
+		}
+		else {
+			break;
+		}
+	}
+
+	return col / tab_width;
+}
+
+
+internal rune
+buffer_peek(Q_Buffer *buffer)
+{
+	if (!buffer) return 0;
+	if (buffer->cursor >= _buf_len(buffer)) return 0;
+
+	return _decode(buffer, buffer->cursor);
+}
+
+internal rune
+buffer_peek_prev(Q_Buffer *buffer)
+{
+	return 0;
+}
+
+// ~geb: one lookup per fold, however much it hides. folds an edit left
+//       touching are stepped over together
+internal void
+_iter_skip_folds(Q_Buffer *b, Q_Iterator *it)
+{
+	it->folded = false;
+
+	for (;;) {
+		if (it->offset >= it->fold_end) {
+			if (!buffer_fold_next(b, it->offset, &it->fold_begin, &it->fold_end))
+				it->fold_begin = it->fold_end = USIZE_MAX;
+		}
+		if (it->offset < it->fold_begin || it->offset >= it->fold_end) break;
+
+		it->offset = it->fold_end;
+		it->folded = true;
+	}
+
+	if (it->folded)
+		it->position.row = buffer_row_from_offset(b, it->offset);
+}
+
+internal bool
+buffer_iter(Q_Buffer *b, Q_Iterator *it)
+{
+    usize from = it->offset;
+    if (it->skip_folds) _iter_skip_folds(b, it);
+
+    usize len = _buf_len(b);
+    if (it->offset >= len) return false;
+
+    // ~geb: the step over a fold stands in for everything it hid
+    it->is_on_cursor = (it->offset == b->cursor) ||
+        (it->folded && b->cursor >= from && b->cursor < it->offset);
+
+    usize avail = 0;
+    u8 *p = _chunk_at(b, it->offset, &avail);
+
+    if (*p < RUNE_SELF) {
+        it->codepoint = *p;
+        it->offset += 1;
+    } else {
+        u32 w = UTF8_LEN_TABLE[*p];
+        it->codepoint = _decode(b, it->offset);
+        it->offset += w ? w : 1;
+    }
+
+    if (it->codepoint == '\n') {
+        it->position.row++;
+        it->position.col = 0;
+    } else {
+        it->position.col++;
+    }
+
+    return true;
+}
+
+
+internal Q_Span_Iterator
+buffer_spans(Q_Buffer *b, usize begin, usize end)
+{
+	usize len = _buf_len(b);
+	end   = Min(end, len);
+	begin = Min(begin, end);
+
+	return (Q_Span_Iterator){
+		.offset = begin,
+		.end    = end,
+	};
+}
+
+internal bool
+buffer_span_next(Q_Buffer *b, Q_Span_Iterator *it)
+{
+	usize at = it->offset + it->span.len;
+	if (at >= it->end) return false;
+
+	usize avail = 0;
+	u8 *p = _chunk_at(b, at, &avail);
+
+	it->offset = at;
+	it->span   = str8(p, Min(avail, it->end - at));
+	return true;
+}
+
+internal String8
+buffer_slice(Q_Buffer *buffer, usize begin, usize end, Allocator alloc)
+{
+    Assert(begin <= end);
+    Assert(end <= _buf_len(buffer));
+
+    usize size = end - begin;
+    if (!size) return (String8){0};
+
+    usize avail = 0;
+    u8 *first = _chunk_at(buffer, begin, &avail);
+
+    if (avail >= size)
+    {
+        return (String8){
+            .str = first,
+            .len = size
+        };
+    }
+
+    u8 *dst = alloc_array_nz(alloc, u8, size, NULL);
+    if (!dst) return (String8){0};
+
+    for (Q_Span_Iterator it = buffer_spans(buffer, begin, end); buffer_span_next(buffer, &it);)
+    {
+        MemMove(dst + (it.offset - begin), it.span.str, it.span.len);
+    }
+
+    return (String8){
+        .str  = dst,
+        .len = size
     };
 }
+
+// ~geb: streams the text straight out of the buffer, no copy around the gap
+internal bool
+buffer_save(Q_Buffer *buffer, String8 path, OS_Sync_Policy sync)
+{
+	String8 spans[4];
+	usize count = _spans(buffer, spans);
+
+	return os_replace_path(path, spans, count, sync);
+}
+
+// ~geb: the copy of the edited window sits in front of an empty gap, so the
+//       snapshot reads through the same span walk as the buffer itself
+internal bool
+buffer_snapshot(Q_Buffer *b, Q_Buffer *out)
+{
+	usize n   = _data_len(b);
+	usize pre = b->gap_pos - b->orig_head;
+
+	u8 *copy = NULL;
+	if (n) {
+		copy = alloc_array_nz(b->alloc, u8, n, NULL);
+		if (!copy) return false;
+
+		MemMove(copy, b->data, pre);
+		MemMove(copy + pre, b->data + pre + b->gap_size, n - pre);
+	}
+
+	*out = (Q_Buffer){
+		.alloc     = b->alloc,
+		.gap_pos   = b->orig_head + n,
+		.cap       = n,
+		.orig      = b->orig,
+		.orig_head = b->orig_head,
+		.orig_tail = b->orig_tail,
+		.mapping   = b->mapping,
+		.data      = copy,
+	};
+
+	if (b->mapping) b->mapping->refs++;
+	return true;
+}
+
+internal void
+buffer_snapshot_release(Q_Buffer *s)
+{
+	if (s->data) mem_free(s->alloc, s->data, NULL);
+	_mapping_release(s->mapping, s->alloc);
+	MemZeroStruct(s);
+}
+
+// ~geb: called once a frame, takes in what the loader got through since
+internal void
+buffer_load_pump(Q_Buffer *b)
+{
+	if (!b || !b->loader) return;
+
+	_lines_take_loaded(b);
+
+	if (!b->lines.unscanned)
+		_loader_stop(b);
+}
+
+// ~geb: fraction of the text the line index covers, 1 once it is complete
+internal f32
+buffer_load_progress(Q_Buffer *b)
+{
+	usize len = _buf_len(b);
+	if (!len || !b->lines.unscanned) return 1.0f;
+
+	return cast(f32) (len - b->lines.unscanned) / cast(f32) len;
+}
+
+///////////////////////////////////////////////
+// ~geb: Search
+//
+// the pair kernels test the needle's first and last byte a vector at a time
+// and leave only candidates to verify. that keeps up with memory for any
+// needle length, horspool only gets ahead of them when they are the scalar
+// ones and the needle is long enough to skip a few words at once. the text
+// is searched span by span where it lies, only the bytes around a span
+// boundary get stitched together.
+
+#define SEARCH_HORSPOOL_MIN 16
+#define SEARCH_STITCH_LOCAL 256
+
+force_inline u8
+_ascii_lower(u8 c)
+{
+	return c + (cast(u8) (c - 'A') < 26 ? 0x20 : 0);
+}
+
+internal void
+_search_compile(Buffer_Search *s, String8 needle, Search_Flags flags)
+{
+	usize m = needle.len;
+
+	s->needle = needle;
+	s->fold   = (flags & Search_Flag_Ignore_Case) != 0;
+
+	u8 first = needle.str[0];
+	u8 last  = needle.str[m - 1];
+	if (s->fold) {
+		first = _ascii_lower(first);
+		last  = _ascii_lower(last);
+	}
+
+	s->pair = (Mem_Pair){
+		.first      = first,
+		.first_fold = s->fold && Is_Between('a', first, 'z') ? 0x20 : 0,
+		.last       = last,
+		.last_fold  = s->fold && Is_Between('a', last, 'z') ? 0x20 : 0,
+		.dist       = m - 1,
+	};
+
+	s->horspool = m >= SEARCH_HORSPOOL_MIN && g_mem_scan.width <= 8;
+	if (!s->horspool) return;
+
+	for (usize c = 0; c < 256; ++c) {
+		s->skip[c]     = m;
+		s->skip_rev[c] = m;
+	}
+
+	// ~geb: when folding, both cases of a letter get its shift
+	for (usize j = 0; j + 1 < m; ++j) {
+		u8 c = needle.str[j];
+		u8 l = _ascii_lower(c);
+
+		s->skip[c] = m - 1 - j;
+		if (s->fold && Is_Between('a', l, 'z')) s->skip[l] = s->skip[l - 0x20] = m - 1 - j;
+	}
+
+	for (usize j = m - 1; j > 0; --j) {
+		u8 c = needle.str[j];
+		u8 l = _ascii_lower(c);
+
+		s->skip_rev[c] = j;
+		if (s->fold && Is_Between('a', l, 'z')) s->skip_rev[l] = s->skip_rev[l - 0x20] = j;
+	}
+}
+
+internal bool
+_search_eq(Buffer_Search *s, u8 *p)
+{
+	if (!s->fold) return MemCompare(p, s->needle.str, s->needle.len) == 0;
+
+	for (usize i = 0; i < s->needle.len; ++i) {
+		if (_ascii_lower(p[i]) != _ascii_lower(s->needle.str[i])) return false;
+	}
+	return true;
+}
+
+// ~geb: first match in [ptr, ptr + len), len if none
+internal usize
+_search_span(Buffer_Search *s, u8 *ptr, usize len)
+{
+	usize m = s->needle.len;
+	if (len < m) return len;
+
+	if (!s->horspool) {
+		for (usize i = 0;; ++i) {
+			usize at = mem_find_pair(ptr + i, len - i, &s->pair);
+			if (at >= len - i) return len;
+
+			i += at;
+			if (_search_eq(s, ptr + i)) return i;
+		}
+	}
+
+	for (usize i = 0; i + m <= len; i += s->skip[ptr[i + m - 1]]) {
+		if ((ptr[i + m - 1] | s->pair.last_fold) == s->pair.last && _search_eq(s, ptr + i))
+			return i;
+	}
+	return len;
+}
+
+// ~geb: last match in [ptr, ptr + len), len if none
+internal usize
+_search_span_rev(Buffer_Search *s, u8 *ptr, usize len)
+{
+	usize m = s->needle.len;
+	if (len < m) return len;
+
+	if (!s->horspool) {
+		for (usize end = len;;) {
+			usize at = mem_find_pair_rev(ptr, end, &s->pair);
+			if (at >= end) return len;
+
+			if (_search_eq(s, ptr + at)) return at;
+			end = at + s->pair.dist;
+		}
+	}
+
+	for (usize i = len - m;;) {
+		if ((ptr[i] | s->pair.first_fold) == s->pair.first && _search_eq(s, ptr + i))
+			return i;
+
+		usize step = s->skip_rev[ptr[i]];
+		if (i < step) return len;
+		i -= step;
+	}
+}
+
+// ~geb: copies [begin, end) out, only ever a needle's length around a span boundary
+internal u8 *
+_search_stitch(Q_Buffer *b, usize begin, usize end, u8 *local, usize local_size)
+{
+	u8 *dst = local;
+	if (end - begin > local_size) {
+		dst = alloc_array_nz(b->alloc, u8, end - begin, NULL);
+		if (!dst) return NULL;
+	}
+
+	for (Q_Span_Iterator it = buffer_spans(b, begin, end); buffer_span_next(b, &it);)
+		MemMove(dst + (it.offset - begin), it.span.str, it.span.len);
+
+	return dst;
+}
+
+internal bool
+buffer_find_in(Q_Buffer *b, usize from, usize to, String8 needle, Search_Flags flags, usize *at)
+{
+	usize len = Min(to, _buf_len(b));
+	usize m   = needle.len;
+	if (!m || from > len || len - from < m) return false;
+
+	Buffer_Search s;
+	_search_compile(&s, needle, flags);
+
+	String8 spans[4];
+	usize count = _spans(b, spans);
+
+	u8 local[SEARCH_STITCH_LOCAL];
+	usize start = 0;
+
+	for (usize k = 0; k < count && start < len; start += spans[k++].len) {
+		usize end = Min(start + spans[k].len, len);
+		if (end <= from) continue;
+
+		usize lo  = Max(start, from);
+		usize hit = _search_span(&s, spans[k].str + (lo - start), end - lo);
+		if (hit < end - lo) {
+			*at = lo + hit;
+			return true;
+		}
+
+		// ~geb: matches starting in the span's last m - 1 bytes run into the next one
+		if (end == len || m == 1) continue;
+
+		usize wlo = end - Min(m - 1, end - lo);
+		usize whi = Min(len, end + m - 1);
+
+		u8 *window = _search_stitch(b, wlo, whi, local, sizeof(local));
+		if (!window) return false;
+
+		hit = _search_span(&s, window, whi - wlo);
+		if (window != local) mem_free(b->alloc, window, NULL);
+
+		if (hit < whi - wlo) {
+			*at = wlo + hit;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+internal bool
+buffer_find_next(Q_Buffer *b, usize from, String8 needle, Search_Flags flags, usize *at)
+{
+	return buffer_find_in(b, from, _buf_len(b), needle, flags, at);
+}
+
+internal bool
+buffer_find_prev(Q_Buffer *b, usize from, String8 needle, Search_Flags flags, usize *at)
+{
+	usize len = _buf_len(b);
+	usize m   = needle.len;
+	if (!m || !from || len < m) return false;
+
+	from = Min(from, len);
+
+	Buffer_Search s;
+	_search_compile(&s, needle, flags);
+
+	String8 spans[4];
+	usize count = _spans(b, spans);
+
+	u8 local[SEARCH_STITCH_LOCAL];
+	usize end = len;
+
+	for (usize k = count; k-- > 0; end -= spans[k].len) {
+		usize start = end - spans[k].len;
+		if (start >= from) continue;
+
+		// ~geb: the ones running into the next span start behind any inside this one
+		if (end < len && m > 1) {
+			usize wlo = end - Min(m - 1, end - start);
+			usize whi = Min(Min(len, end + m - 1), from + m - 1);
+
+			if (whi >= wlo + m) {
+				u8 *window = _search_stitch(b, wlo, whi, local, sizeof(local));
+				if (!window) return false;
+
+				usize hit = _search_span_rev(&s, window, whi - wlo);
+				if (window != local) mem_free(b->alloc, window, NULL);
+
+				if (hit < whi - wlo) {
+					*at = wlo + hit;
+					return true;
+				}
+			}
+		}
+
+		usize hi  = Min(end, from + m - 1);
+		usize hit = _search_span_rev(&s, spans[k].str, hi - start);
+		if (hit < hi - start) {
+			*at = start + hit;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+internal bool
+buffer_match_at(Q_Buffer *b, usize at, String8 needle, Search_Flags flags)
+{
+	usize len = _buf_len(b);
+	if (at > len || len - at < needle.len) return false;
+
+	bool fold = (flags & Search_Flag_Ignore_Case) != 0;
+
+	for (usize i = 0; i < needle.len;) {
+		usize avail = 0;
+		u8   *p = _chunk_at(b, at + i, &avail);
+		usize n = Min(avail, needle.len - i);
+
+		if (fold) {
+			for (usize j = 0; j < n; ++j) {
+				if (_ascii_lower(p[j]) != _ascii_lower(needle.str[i + j])) return false;
+			}
+		} else if (MemCompare(p, needle.str + i, n) != 0) {
+			return false;
+		}
+		i += n;
+	}
+	return true;
+}
+
+internal void
+buffer_search_prepare(Buffer_Search *s, String8 needle, Search_Flags flags)
+{
+	if (needle.len) _search_compile(s, needle, flags);
+	else            MemZeroStruct(s);
+}
+
+internal usize
+buffer_search_memory(Buffer_Search *s, u8 *ptr, usize len)
+{
+	if (!s->needle.len) return len;
+	return _search_span(s, ptr, len);
+}
+
+///////////////////////////////////////////////
+// ~geb: Regex search
+
+internal i32
+_byte_or_edge(Q_Buffer *b, usize off, usize len)
+{
+	return off < len ? _byte(b, off) : -1;
+}
+
+// ~geb: feeds [begin, end) to a back to front scan, spans last to first
+internal void
+_regex_feed_back(Q_Buffer *b, Regex_Scan *scan, usize begin, usize end)
+{
+	String8 spans[4];
+	usize count = _spans(b, spans);
+	usize hi    = _buf_len(b);
+
+	for (usize k = count; k-- > 0; hi -= spans[k].len) {
+		usize lo = hi - spans[k].len;
+		if (lo >= end) continue;
+		if (hi <= begin) break;
+
+		usize from = Max(lo, begin);
+		usize to   = Min(hi, end);
+		if (!regex_scan_feed(scan, spans[k].str + (from - lo), to - from)) return;
+	}
+
+	regex_scan_finish(scan, begin ? _byte(b, begin - 1) : -1);
+}
+
+// ~geb: where the match ending at `end` begins, it cannot begin before `floor`
+internal usize
+_regex_match_start(Q_Buffer *b, Regex *re, usize floor, usize end)
+{
+	Regex_Scan scan;
+	regex_scan_begin(re, &scan, Regex_Scan_Start, _byte_or_edge(b, end, _buf_len(b)));
+	_regex_feed_back(b, &scan, floor, end);
+
+	return scan.match == USIZE_MAX ? end : end - scan.match;
+}
+
+internal bool
+buffer_regex_next(Q_Buffer *b, Regex *re, usize from, usize *begin, usize *end)
+{
+	usize len = _buf_len(b);
+	if (from > len) return false;
+
+	Regex_Scan scan;
+	regex_scan_begin(re, &scan, Regex_Scan_Forward, from ? _byte(b, from - 1) : -1);
+
+	bool more = true;
+	for (Q_Span_Iterator it = buffer_spans(b, from, len); more && buffer_span_next(b, &it);)
+		more = regex_scan_feed(&scan, it.span.str, it.span.len);
+
+	if (more) regex_scan_finish(&scan, -1);
+	if (scan.match == USIZE_MAX) return false;
+
+	*end   = from + scan.match;
+	*begin = _regex_match_start(b, re, from, *end);
+	return true;
+}
+
+///////////////////////////////////////////////
+// ~geb: Substitute
+//
+// the matches are all found first, then the new text is written out into
+// fresh storage front to back in one go, so the cost is one read and one
+// write of the buffer however many matches there are. the history gets the
+// same records a left to right run of erase + insert would have logged,
+// undoing walks them back through the gap once.
+
+typedef struct {
+	usize begin;
+	usize end;
+} Subst_Match;
+
+// ~geb: bytes the replacement expands to, `amps` of them copies of the match
+internal usize
+_subst_literal_len(String8 rep, usize *amps)
+{
+	usize n = 0;
+	*amps = 0;
+
+	for (usize i = 0; i < rep.len; ++i) {
+		if (rep.str[i] == '\\' && i + 1 < rep.len) { i++; n++; }
+		else if (rep.str[i] == '&') (*amps)++;
+		else n++;
+	}
+	return n;
+}
+
+// ~geb: writes the replacement for the match [begin, end) of `src` to `dst`
+internal u8 *
+_subst_expand(Q_Buffer *src, String8 rep, usize begin, usize end, u8 *dst)
+{
+	for (usize i = 0; i < rep.len; ++i) {
+		u8 c = rep.str[i];
+
+		if (c == '\\' && i + 1 < rep.len) {
+			c = rep.str[++i];
+			*dst++ = c == 'n' ? '\n' : c == 't' ? '\t' : c;
+		} else if (c == '&') {
+			for (Q_Span_Iterator it = buffer_spans(src, begin, end); buffer_span_next(src, &it);) {
+				MemMove(dst, it.span.str, it.span.len);
+				dst += it.span.len;
+			}
+		} else {
+			*dst++ = c;
+		}
+	}
+	return dst;
+}
+
+// ~geb: marks of both gravities in one match part ways, a right one in front
+//       of a left one ends up behind it. an insertion sort over the slots in
+//       order puts them back, only the ones that crossed are moved
+internal void
+_marks_resort(Q_Buffer *b)
+{
+	Mark_Set *ms = &b->marks;
+	usize count = ms->before + (ms->end - ms->after);
+
+	for (usize n = 1; n < count; ++n) {
+		for (usize j = n; j > 0; --j) {
+			usize lo = j - 1 < ms->before ? j - 1 : ms->after + (j - 1 - ms->before);
+			usize hi = j     < ms->before ? j     : ms->after + (j     - ms->before);
+
+			usize lo_at = _marks_offset(b, lo);
+			usize hi_at = _marks_offset(b, hi);
+			if (lo_at <= hi_at) break;
+
+			Mark_Slot l = ms->items[lo], h = ms->items[hi];
+			l.pos = hi < ms->before ? lo_at : _buf_len(b) - lo_at;
+			h.pos = lo < ms->before ? hi_at : _buf_len(b) - hi_at;
+			_marks_put(ms, lo, h);
+			_marks_put(ms, hi, l);
+		}
+	}
+}
+
+// ~geb: the slots hold their marks in order of offset
+internal bool
+_marks_sorted(Q_Buffer *b)
+{
+	Mark_Set *ms = &b->marks;
+	usize prev = 0;
+
+	usize k = ms->before ? 0 : ms->after;
+	for (; k < ms->end; k = k + 1 == ms->before ? ms->after : k + 1) {
+		usize at = _marks_offset(b, k);
+		if (at < prev) return false;
+		prev = at;
+	}
+	return true;
+}
+
+// ~geb: marks end up where a left to right run of erase + insert would have
+//       put them. one inside a match or on either end of it lands on the start
+//       of the replacement, or past it with right gravity
+internal void
+_subst_marks(Q_Buffer *b, Subst_Match *m, usize count, usize *rep_len, usize old_len, usize new_len)
+{
+	Mark_Set *ms = &b->marks;
+
+	usize i = 0;
+	isize shift = 0;
+
+	// ~geb: the slots in front of the gap then the ones behind it, in order
+	usize k = ms->before ? 0 : ms->after;
+	for (; k < ms->end; k = k + 1 == ms->before ? ms->after : k + 1) {
+		Mark_Slot *slot = &ms->items[k];
+		usize pos = k < ms->before ? slot->pos : old_len - slot->pos;
+
+		while (i < count && m[i].end < pos) {
+			shift += cast(isize) rep_len[i] - cast(isize) (m[i].end - m[i].begin);
+			i++;
+		}
+
+		usize at = pos + shift;
+		if (i < count && m[i].begin <= pos) {
+			usize j  = i;
+			isize sh = shift;
+
+			// ~geb: a right mark is pushed on through matches that follow back to back
+			if (slot->gravity == Mark_Right) {
+				while (j + 1 < count && m[j + 1].begin == m[j].end) {
+					sh += cast(isize) rep_len[j] - cast(isize) (m[j].end - m[j].begin);
+					j++;
+				}
+			}
+
+			at = m[j].begin + sh + (slot->gravity == Mark_Right ? rep_len[j] : 0);
+		}
+
+		slot->pos = k < ms->before ? at : new_len - at;
+	}
+
+	_marks_resort(b);
+}
+
+internal usize
+buffer_substitute(Q_Buffer *b, Regex *re, usize begin, usize end, String8 replacement, Substitute_Flags flags)
+{
+	usize len = _buf_len(b);
+	end = Min(end, len);
+	if (begin > end) return 0;
+
+	Dynamic_Array matches = dynamic_array(b->alloc, Subst_Match, 0);
+
+	usize from = begin;
+	usize last = USIZE_MAX;
+	usize mb = 0, me = 0;
+
+	while (from <= end && buffer_regex_next(b, re, from, &mb, &me) && me <= end) {
+		// ~geb: no empty match right where the last one ended
+		if (mb == me && mb == last) {
+			if (mb == len) break;
+			from = buffer_offset_by_codepoints(b, mb, 1);
+			continue;
+		}
+
+		dyn_arr_append(&matches, Subst_Match, ((Subst_Match){ mb, me }));
+		last = me;
+		from = me > mb ? me : buffer_offset_by_codepoints(b, me, 1);
+		if (me == len) break;
+
+		if (!(flags & Substitute_Flag_Global)) {
+			usize row_end = buffer_row_end(b, buffer_row_from_offset(b, mb));
+			if (row_end == len) break;
+			from = Max(from, row_end + 1);
+		}
+	}
+
+	usize count = matches.len;
+	Subst_Match *m = dyn_arr_data(&matches, Subst_Match);
+
+	usize *rep_len = count ? alloc_array_nz(b->alloc, usize, count, NULL) : NULL;
+	if (!rep_len) {
+		dynamic_array_delete(&matches);
+		return 0;
+	}
+
+	usize amps    = 0;
+	usize literal = _subst_literal_len(replacement, &amps);
+	usize new_len = len;
+	for (usize i = 0; i < count; ++i) {
+		usize n = m[i].end - m[i].begin;
+		rep_len[i] = literal + amps * n;
+		new_len    = new_len - n + rep_len[i];
+	}
+
+	Q_Buffer old = *b;
+	if (!_storage_alloc(b, Max(new_len * 2, Kb(4))) || !_make_room(b, 0, new_len)) {
+		if (b->data) _storage_release(b);
+		*b = old;
+
+		mem_free(b->alloc, rep_len, NULL);
+		dynamic_array_delete(&matches);
+		return 0;
+	}
+
+	_loader_stop(b);
+
+	// ~geb: the new text goes to the back, the gap in front of it like a fresh buffer
+	b->mapping = NULL;
+	b->orig = (String8){0};
+	b->orig_head = b->orig_tail = 0;
+	b->gap_pos   = 0;
+	b->gap_size  = b->cap - new_len;
+
+	u8 *dst   = b->data + b->gap_size;
+	usize pos = 0;
+	for (usize i = 0; i < count; ++i) {
+		for (Q_Span_Iterator it = buffer_spans(&old, pos, m[i].begin); buffer_span_next(&old, &it);) {
+			MemMove(dst, it.span.str, it.span.len);
+			dst += it.span.len;
+		}
+		dst = _subst_expand(&old, replacement, m[i].begin, m[i].end, dst);
+		pos = m[i].end;
+	}
+	for (Q_Span_Iterator it = buffer_spans(&old, pos, len); buffer_span_next(&old, &it);) {
+		MemMove(dst, it.span.str, it.span.len);
+		dst += it.span.len;
+	}
+
+	// ~geb: one undo step, laid down as the erase + insert at each match in turn
+	buffer_history_break(b);
+	u32 group = b->history.group;
+
+	u8   *text  = b->data + b->gap_size;
+	isize shift = 0;
+	usize at    = 0;
+	for (usize i = 0; i < count; ++i) {
+		at = m[i].begin + shift;
+		usize n  = m[i].end - m[i].begin;
+
+		u8 *logged = _history_record(b, Edit_Erase, at, n);
+		if (logged) {
+			for (Q_Span_Iterator it = buffer_spans(&old, m[i].begin, m[i].end); buffer_span_next(&old, &it);)
+				MemMove(logged + (it.offset - m[i].begin), it.span.str, it.span.len);
+		}
+		b->history.open = b->history.group != group;
+
+		logged = _history_record(b, Edit_Insert, at, rep_len[i]);
+		if (logged) MemMove(logged, text + at, rep_len[i]);
+		b->history.open = b->history.group != group;
+
+		shift += cast(isize) rep_len[i] - cast(isize) n;
+	}
+	b->history.open = false;
+
+	_subst_marks(b, m, count, rep_len, len, new_len);
+	Assert(_marks_sorted(b));
+
+	Fold_Set *fs = &b->folds;
+	fs->count = _folds_prune(b, &fs->items, fs->count, &fs->cap, 0, USIZE_MAX);
+	fs->stale = true;
+
+	_lines_free(b);
+	b->lines.unscanned = new_len;
+
+	for (usize i = 0; i < COLUMN_CACHE_LINES; ++i) {
+		b->columns.lines[i].used  = 0;
+		b->columns.lines[i].count = 0;
+	}
+
+	// ~geb: the new line count is not known until the text is indexed again,
+	//       so watchers see the whole text change
+	for (usize i = 0; i < BUFFER_WATCHERS; ++i) {
+		if (b->watchers[i]) *b->watchers[i] = (Buffer_Dirty){ .any = true, .end = new_len };
+	}
+
+	b->cursor = at; // ~geb: on the last replacement
+	b->goal_col_valid = false;
+
+	_mapping_release(old.mapping, b->alloc);
+	_storage_release(&old);
+
+	mem_free(b->alloc, rep_len, NULL);
+	dynamic_array_delete(&matches);
+	return count;
+}
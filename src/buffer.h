@@ -10,23 +10,227 @@
 
 #include "base.h"
 
+// ~geb: newline offsets stored as a gap array that follows the text gap.
+//       entries before the gap are absolute offsets, entries after it
+//       are the distance from the end of the text, so an edit at the gap
+//       never has to touch the entries on either side of it.
+typedef struct {
+	usize *items;
+	usize  before; // [0, before)  newlines in front of the gap
+	usize  after;  // [after, end) newlines behind the gap
+	usize  end;
+	usize  cap;
+
+	usize  unscanned; // bytes at the end of the text not indexed yet
+} Line_Index;
+
+// ~geb: indexes a mapped file on a worker thread. the worker walks the
+//       mapping front to back, faulting it in and writing down newline
+//       offsets, the main thread folds what is done into `lines` between frames.
+typedef struct {
+	OS_Thread thread;
+
+	u8   *src;
+	usize len;
+
+	usize *offsets;   // os_reserve'd, committed by the worker as it fills it
+	usize  reserved;  // bytes
+	usize  committed;
+
+	_Atomic usize scanned; // bytes of `src` the offsets are complete for
+	_Atomic usize count;
+	_Atomic bool  cancel;
+
+	usize taken; // offsets already folded into the index, main thread only
+} Buffer_Loader;
+
+// ~geb: visual column checkpoints for the few long lines being worked on,
+//       one every COLUMN_CHECKPOINT_STRIDE bytes from the start of the line,
+//       so finding a column never scans more than one stride of text.
+typedef struct {
+	usize  line_start;
+	usize *cols;  // cols[i] is the column at line_start + (i + 1) * stride
+	usize  count; // checkpoints that are still valid
+	usize  cap;
+	u64    used;  // lru stamp, 0 for an empty slot
+} Column_Checkpoints;
+
+#define COLUMN_CACHE_LINES 4
+
+typedef struct {
+	Column_Checkpoints lines[COLUMN_CACHE_LINES];
+	u64 clock;
+	int tab_width;
+} Column_Cache;
+
+// ~geb: positions that follow the text as it is edited. kept sorted in a gap
+//       array laid out like the line index, so an edit only has to step over
+//       the marks between the last edit and this one, the rest shift for free.
+//       a mark is addressed through its id, `where` maps it to its slot.
+typedef u8 Mark_Gravity;
+enum {
+	Mark_Left = 0, // text inserted right at the mark goes after it
+	Mark_Right,    // the mark ends up after text inserted right at it
+};
+
+typedef u32 Mark;
+#define MARK_NONE 0
+
+typedef struct {
+	usize        pos; // absolute in front of the gap, distance from the end behind it
+	Mark         id;
+	Mark_Gravity gravity;
+} Mark_Slot;
+
+typedef struct {
+	Mark_Slot *items;
+	usize      before;
+	usize      after;
+	usize      end;
+	usize      cap;
+
+	usize *where;     // where[id] is the slot of mark `id`, or the next free id
+	usize  where_cap;
+	Mark   ids;       // ids handed out so far
+	Mark   free;      // first id that can be handed out again, MARK_NONE if none
+} Mark_Set;
+
+// ~geb: a collapsed fold hides whole lines, the range [begin, end) from the
+//       newline ending the line left in view to the newline ending the last
+//       hidden one, held as marks so edits carry it along. the folds at the
+//       top are sorted and apart from each other, the ones collapsed inside
+//       a fold are kept as its children and are back once it is opened.
+typedef struct Buffer_Fold Buffer_Fold;
+struct Buffer_Fold {
+	Mark begin;
+	Mark end;
+	Buffer_Fold *children;
+	usize        child_count;
+};
+
+typedef struct {
+	Buffer_Fold *items;
+	usize        count;
+	usize        cap;
+
+	usize *hidden; // rows hidden by the folds in front of each one, count + 1 of them
+	bool   stale;  // `hidden` is summed up again before it is next read
+} Fold_Set;
+
+typedef u32 Search_Flags;
+enum {
+	Search_Flag_Ignore_Case = Bit(0), // ascii letters only
+};
+
+typedef u32 Substitute_Flags;
+enum {
+	Substitute_Flag_Global = Bit(0), // every match on a line, not just the first
+};
+
+// ~geb: a needle prepared for searching, the horspool tables are only
+//       filled in when it goes through horspool
+typedef struct {
+	String8  needle;
+	bool     fold;
+	bool     horspool;
+	Mem_Pair pair;
+	usize    skip[256];     // shift keyed on the byte under the needle's last byte
+	usize    skip_rev[256]; // shift keyed on the byte under its first, going backwards
+} Buffer_Search;
+
+// ~geb: a file mapping shared by a buffer and the snapshots taken of it,
+//       unmapped once the last of them lets go. main thread only
+typedef struct {
+	String8 bytes;
+	u32     refs;
+} Buffer_Mapping;
+
+// ~geb: the part of the text edited since the owner last cleared it, for
+//       caches kept outside the buffer that go by rows. only [begin, end)
+//       changed, the text behind it moved by `rows` lines and nothing else.
+//       registered with buffer_watch, every edit from then on widens it.
+typedef struct {
+	bool  any;
+	usize begin; // offsets into the text as it is now
+	usize end;
+	isize rows;
+} Buffer_Dirty;
+
+#define BUFFER_WATCHERS 4
+
+typedef u32 Buffer_Flags;
+enum {
+	// ~geb: `data` is an os_reserve'd range of `cap` bytes, only the pages
+	//       at either end of the gap are committed, so growing never moves text
+	Buffer_Flag_Virtual = Bit(0),
+};
+
+// ~geb: one insert or erase, its text stored right behind it in the
+//       history arena. records are never freed one by one, undo just
+//       walks `top` back and a new edit cuts the redo tail off.
+typedef u8 Edit_Kind;
+enum {
+	Edit_Insert = 0,
+	Edit_Erase,
+};
+
+typedef struct {
+	usize     prev;   // log position of the record before, HISTORY_NONE if first
+	usize     offset; // where the text was inserted / erased
+	usize     len;
+	u32       group;  // records sharing a group are undone as one step
+	Edit_Kind kind;
+} Edit_Record;
+
+#define HISTORY_NONE USIZE_MAX
+
+typedef struct {
+	Allocator log;   // arena holding the records back to back
+	usize     top;   // newest applied record, anything after it is redo
+	u32       group;
+	bool      open;  // new edits may still join the top record / group
+	bool      applying;
+} Edit_History;
+
 typedef struct Q_Buffer Q_Buffer;
 struct Q_Buffer {
     Allocator alloc;
+	Buffer_Flags flags;
 
 	String8 name;
 
     Q_Buffer *prev;
     Q_Buffer *next;
 
+    usize cursor;   // logical offset, the gap only catches up on an edit
     usize gap_pos;
     usize gap_size;
     usize cap;
 
+	usize commit_front; // committed bytes from the start of `data`
+	usize commit_back;  // committed bytes up to `data + cap`
+
+	// ~geb: read-only file mapping backing the parts of the text that were
+	//       never edited. The buffer reads as
+	//           orig[0, orig_head) ++ data (around the gap) ++ orig[orig_tail, orig.len)
+	//       so only the window that actually got edited is ever copied.
+	String8 orig;
+	usize   orig_head;
+	usize   orig_tail;
+	Buffer_Mapping *mapping; // owns `orig`, NULL when there is none
+
 	usize goal_col;
 	bool goal_col_valid;
+	Column_Cache columns;
 
-    u8 data[];
+	Line_Index lines;
+	Mark_Set   marks;
+	Fold_Set   folds;
+	Buffer_Loader *loader;
+	Edit_History history;
+	Buffer_Dirty *watchers[BUFFER_WATCHERS];
+
+    u8 *data;
 };
 
 typedef struct {
@@ -39,16 +243,81 @@ typedef struct {
 	rune codepoint;
 	Buffer_Position position;
 	bool is_on_cursor;
+
+	// ~geb: set `skip_folds` to step over what collapsed folds hide, `folded`
+	//       tells the step that did. [fold_begin, fold_end) is the next fold,
+	//       only looked up again once the iterator is past it
+	bool  skip_folds;
+	bool  folded;
+	usize fold_begin;
+	usize fold_end;
 } Q_Iterator;
 
 internal bool buffer_iter(Q_Buffer *buf, Q_Iterator *itr);
 
+// ~geb: walks the raw bytes of a range as the contiguous spans they are
+//       stored in, for consumers that want to chew through memory linearly.
+//       spans are cut at storage boundaries, not at codepoint boundaries.
+typedef struct {
+	usize   offset; // buffer offset of span.str[0]
+	String8 span;
+	usize   end;
+} Q_Span_Iterator;
+
+internal Q_Span_Iterator buffer_spans(Q_Buffer *buf, usize begin, usize end);
+internal bool            buffer_span_next(Q_Buffer *buf, Q_Span_Iterator *itr);
+
 internal Q_Buffer *buffer_make(String8 name, String8 src, Q_Buffer *current, Allocator alloc);
+internal Q_Buffer *buffer_make_mapped(String8 name, String8 mapping, Q_Buffer *current, Allocator alloc);
 internal void      buffer_delete(Q_Buffer *buffer);
 
-internal Q_Buffer *buffer_insert(Q_Buffer *buf, String8 text, int tab_width);
+internal void buffer_load_pump(Q_Buffer *buffer);
+internal f32  buffer_load_progress(Q_Buffer *buffer);
+
+internal void buffer_insert(Q_Buffer *buf, String8 text, int tab_width);
 internal void buffer_erase(Q_Buffer *buf);
+internal void buffer_erase_range(Q_Buffer *buf, usize begin, usize end);
+internal void buffer_replace_range(Q_Buffer *buf, usize begin, usize end, String8 text, int tab_width);
+
+internal bool buffer_undo(Q_Buffer *buf, int tab_width);
+internal bool buffer_redo(Q_Buffer *buf, int tab_width);
+internal void buffer_history_break(Q_Buffer *buf);
+
+internal usize buffer_offset_by_codepoints(Q_Buffer *buf, usize offset, isize count);
+internal usize buffer_offset_by_rows(Q_Buffer *buf, usize offset, isize rows, int tab_width);
+
+// ~geb: one edit at every cursor in a single sweep. `cursors` must be sorted
+//       and is updated in place, cursors that end up on top of each other are
+//       merged and the new count is returned. the buffer's own cursor follows
+//       the one at index `primary`.
+internal usize buffer_insert_multi(Q_Buffer *buf, usize *cursors, usize count, usize primary, String8 text, int tab_width);
+internal usize buffer_erase_multi(Q_Buffer *buf, usize *cursors, usize count, usize primary, isize codepoints);
+
+// ~geb: ids stay valid until the mark is removed or the buffer is deleted,
+//       MARK_NONE is returned when there is no memory for one more
+internal Mark  buffer_mark_add(Q_Buffer *buf, usize offset, Mark_Gravity gravity);
+internal void  buffer_mark_remove(Q_Buffer *buf, Mark mark);
+internal void  buffer_mark_move(Q_Buffer *buf, Mark mark, usize offset);
+internal usize buffer_mark_offset(Q_Buffer *buf, Mark mark);
 
+// ~geb: false when every slot is taken. a watcher has to be removed before
+//       it goes away, the buffer only keeps the pointer
+internal bool buffer_watch(Q_Buffer *buf, Buffer_Dirty *dirty);
+internal void buffer_unwatch(Q_Buffer *buf, Buffer_Dirty *dirty);
+
+// ~geb: hides the lines after `first_row` up to `last_row`, folds collapsed
+//       in there go under the new one. false when there is nothing to hide
+internal bool buffer_fold(Q_Buffer *buf, usize first_row, usize last_row);
+// ~geb: opens the fold hiding the lines after the one ending at `line_end`
+internal bool buffer_unfold(Q_Buffer *buf, usize line_end);
+// ~geb: the first fold at the top ending after `offset`, as the range it hides
+internal bool buffer_fold_next(Q_Buffer *buf, usize offset, usize *begin, usize *end);
+// ~geb: going between rows of the text and rows in view with the folds
+//       taken out, a binary search over the folds at the top
+internal usize buffer_row_from_visible(Q_Buffer *buf, usize visible_row);
+internal usize buffer_visible_row(Q_Buffer *buf, usize row);
+
+internal void buffer_set_cursor(Q_Buffer *buffer, usize offset);
 internal void buffer_move_left(Q_Buffer *buffer, int tab_width);
 internal void buffer_move_right(Q_Buffer *buffer, int tab_width);
 internal void buffer_move_up(Q_Buffer *b, int tab_width);
@@ -57,9 +326,45 @@ internal void buffer_move_down(Q_Buffer *b, int tab_width);
 internal Buffer_Position buffer_line_start(Q_Buffer *buffer);
 internal Buffer_Position buffer_line_end(Q_Buffer *buffer);
 
+internal usize buffer_len(Q_Buffer *buffer);
+internal usize buffer_line_count(Q_Buffer *buffer);
+internal usize buffer_row_from_offset(Q_Buffer *buffer, usize offset);
+internal usize buffer_offset_from_row(Q_Buffer *buffer, usize row);
+internal usize buffer_row_end(Q_Buffer *buffer, usize row);
+
 internal usize   buffer_current_indent_depth(Q_Buffer *buffer, int tab_width);
 internal rune    buffer_peek(Q_Buffer *buffer);
 internal rune    buffer_peek_prev(Q_Buffer *buffer);
 internal String8 buffer_slice(Q_Buffer *buffer, usize begin, usize end, Allocator alloc);
 
+// ~geb: first match starting at or after `from` / last one starting before
+//       it. the text is searched where it lies, nothing gets copied.
+internal bool buffer_find_next(Q_Buffer *buffer, usize from, String8 needle, Search_Flags flags, usize *at);
+internal bool buffer_find_prev(Q_Buffer *buffer, usize from, String8 needle, Search_Flags flags, usize *at);
+// ~geb: first match lying wholly inside [from, to)
+internal bool buffer_find_in(Q_Buffer *buffer, usize from, usize to, String8 needle, Search_Flags flags, usize *at);
+internal bool buffer_match_at(Q_Buffer *buffer, usize at, String8 needle, Search_Flags flags);
+// ~geb: the same search over plain memory, for text that never went into a
+//       buffer. a prepared search is only read, threads can share one.
+internal void  buffer_search_prepare(Buffer_Search *search, String8 needle, Search_Flags flags);
+internal usize buffer_search_memory(Buffer_Search *search, u8 *ptr, usize len); // len if none
+
+// ~geb: leftmost match of `re` starting at or after `from`, as [begin, end).
+//       matches can be empty.
+internal bool buffer_regex_next(Q_Buffer *buffer, Regex *re, usize from, usize *begin, usize *end);
+
+// ~geb: replaces the matches of `re` inside [begin, end) in one pass over
+//       the text, as a single undo step. `&` in the replacement stands for the
+//       match, `\` takes the byte after it as is, `\n` and `\t` being a newline
+//       and a tab. returns how many were replaced.
+internal usize buffer_substitute(Q_Buffer *buffer, Regex *re, usize begin, usize end, String8 replacement, Substitute_Flags flags);
+
+// ~geb: freezes the text as it is now into `out` for other threads to read.
+//       the original file text is shared, only the edited window is copied.
+//       a snapshot only takes the read side of the api, spans and searches.
+internal bool buffer_snapshot(Q_Buffer *buffer, Q_Buffer *out);
+internal void buffer_snapshot_release(Q_Buffer *snapshot);
+
+internal bool buffer_save(Q_Buffer *buffer, String8 path, OS_Sync_Policy sync);
+
 #endif
@@ -1,26 +1,1131 @@
 #include "editor.h"
 
+///////////////////////////////////////////////
+// ~geb: Cursors
+
+internal bool
+_multi_cursor(Editor_Context *ctx)
+{
+	return ctx->active_buffer && ctx->cursors.len > 1;
+}
+
+internal void
+_cursors_clear(Editor_Context *ctx)
+{
+	dynamic_array_clear(&ctx->cursors);
+}
+
+// ~geb: first cursor not in front of `off`
+internal usize
+_cursors_lower_bound(Editor_Context *ctx, usize off)
+{
+	usize *c  = dyn_arr_data(&ctx->cursors, usize);
+	usize lo = 0, hi = ctx->cursors.len;
+
+	while (lo < hi) {
+		usize mid = lo + (hi - lo) / 2;
+		if (c[mid] < off) lo = mid + 1;
+		else              hi = mid;
+	}
+	return lo;
+}
+
+internal usize
+_cursors_primary(Editor_Context *ctx)
+{
+	return _cursors_lower_bound(ctx, ctx->active_buffer->cursor);
+}
+
+internal int
+_cursor_compare(const void *a, const void *b)
+{
+	usize x = *(const usize *)a;
+	usize y = *(const usize *)b;
+	return (x > y) - (x < y);
+}
+
+// ~geb: cursors can cross or meet after moving, put them back in order
+internal void
+_cursors_normalize(Editor_Context *ctx)
+{
+	usize *c = dyn_arr_data(&ctx->cursors, usize);
+	qsort(c, ctx->cursors.len, sizeof(usize), _cursor_compare);
+
+	usize n = 0;
+	for (usize i = 0; i < ctx->cursors.len; ++i) {
+		if (!n || c[n - 1] != c[i])
+			c[n++] = c[i];
+	}
+	ctx->cursors.len = n;
+}
+
+///////////////////////////////////////////////
+// ~geb: Search
+
+internal String8
+_search_pattern(Editor_Search *s)
+{
+	return str8(cast(u8 *) s->pattern.data, s->pattern.len);
+}
+
+internal void
+_search_reset(Editor_Search *s)
+{
+	dynamic_array_clear(&s->pattern);
+	dynamic_array_clear(&s->hits);
+	s->scanned  = 0;
+	s->overflow = false;
+	s->match    = USIZE_MAX;
+}
+
+// ~geb: first hit not in front of `off`
+internal usize
+_search_lower_bound(Editor_Search *s, usize off)
+{
+	usize *h  = dyn_arr_data(&s->hits, usize);
+	usize lo = 0, hi = s->hits.len;
+
+	while (lo < hi) {
+		usize mid = lo + (hi - lo) / 2;
+		if (h[mid] < off) lo = mid + 1;
+		else              hi = mid;
+	}
+	return lo;
+}
+
+// ~geb: smart case, an upper case letter makes the search exact
+internal Search_Flags
+_search_flags(String8 pattern)
+{
+	for (usize i = 0; i < pattern.len; ++i) {
+		if (Is_Between('A', pattern.str[i], 'Z')) return 0;
+	}
+	return Search_Flag_Ignore_Case;
+}
+
+// ~geb: first match at or after `from`, wrapping around to the top
+internal usize
+_search_first(Editor_Search *s, Q_Buffer *buf, usize from)
+{
+	String8 pattern = _search_pattern(s);
+	usize at = 0;
+
+	usize i = _search_lower_bound(s, from);
+	if (i < s->hits.len) return dyn_arr_data(&s->hits, usize)[i];
+
+	if (buffer_find_next(buf, Max(from, s->scanned), pattern, s->flags, &at)) return at;
+
+	if (s->hits.len) return dyn_arr_data(&s->hits, usize)[0];
+	if (buffer_find_in(buf, 0, from + pattern.len - 1, pattern, s->flags, &at)) return at;
+
+	return USIZE_MAX;
+}
+
+// ~geb: the cli buffer changed, bring the hits and the cursor up to date
+internal void
+_search_update(Editor_Context *ctx)
+{
+	Editor_Search *s = &ctx->search;
+	Q_Buffer *buf = ctx->active_buffer;
+	if (!buf) return;
+
+	String8 next = buffer_slice(ctx->cli_buffer, 0, buffer_len(ctx->cli_buffer), ctx->frame_alloc);
+	String8 prev = _search_pattern(s);
+	Search_Flags flags = _search_flags(next);
+
+	bool extends = !s->overflow && prev.len && next.len >= prev.len &&
+		flags == s->flags && MemCompare(next.str, prev.str, prev.len) == 0;
+
+	usize from = extends && s->match != USIZE_MAX ? s->match : s->origin;
+
+	if (extends) {
+		// ~geb: keep the hits the longer pattern still matches at
+		usize *h = dyn_arr_data(&s->hits, usize);
+		usize  n = 0;
+		for (usize i = 0; i < s->hits.len; ++i) {
+			if (buffer_match_at(buf, h[i], next, flags))
+				h[n++] = h[i];
+		}
+		s->hits.len = n;
+	} else {
+		_search_reset(s);
+	}
+
+	s->match = USIZE_MAX;
+	if (!dynamic_array_reserve(&s->pattern, 1, 1, next.len)) {
+		_search_reset(s);
+		return;
+	}
+	MemMove(s->pattern.data, next.str, next.len);
+	s->pattern.len = next.len;
+	s->flags = flags;
+
+	if (next.len)
+		s->match = _search_first(s, buf, from);
+
+	buffer_set_cursor(buf, s->match != USIZE_MAX ? s->match : s->origin);
+}
+
+internal void
+editor_search_pump(Editor_Context *ctx)
+{
+	Editor_Search *s = &ctx->search;
+	Q_Buffer *buf = ctx->active_buffer;
+	if (ctx->mode != Mode_CLI || !buf || !s->pattern.len || s->overflow) return;
+
+	usize len = buffer_len(buf);
+	if (s->scanned >= len) return;
+
+	String8 pattern = _search_pattern(s);
+	usize limit = Min(len, s->scanned + SEARCH_SCAN_BUDGET);
+	usize to    = Min(len, limit + pattern.len - 1);
+
+	usize from = s->scanned;
+	usize at   = 0;
+	while (buffer_find_in(buf, from, to, pattern, s->flags, &at) && at < limit) {
+		if (s->hits.len == SEARCH_MAX_HITS) {
+			dynamic_array_clear(&s->hits);
+			s->scanned  = 0;
+			s->overflow = true;
+			return;
+		}
+		dyn_arr_append(&s->hits, usize, at);
+		from = at + 1;
+	}
+	s->scanned = limit;
+}
+
+internal Search_Highlights
+editor_search_visible(Editor_Search *s, Q_Buffer *buf, usize first_row, usize rows, usize row_bytes, Allocator alloc)
+{
+	Search_Highlights hl = { .current = s->match };
+
+	String8 pattern = _search_pattern(s);
+	if (!pattern.len || !buf) return hl;
+
+	Dynamic_Array starts = dynamic_array(alloc, usize, 64);
+	usize len = buffer_len(buf);
+
+	for (usize r = first_row; r < first_row + rows; ++r) {
+		usize begin = buffer_offset_from_row(buf, r);
+		usize end   = buffer_row_end(buf, r);
+
+		// ~geb: past `row_bytes` the row runs off the screen
+		usize limit = Min(end, begin + row_bytes);
+
+		if (!s->overflow && s->scanned >= limit) {
+			usize *h = dyn_arr_data(&s->hits, usize);
+			for (usize i = _search_lower_bound(s, begin); i < s->hits.len && h[i] < limit; ++i)
+				dyn_arr_append(&starts, usize, h[i]);
+		} else {
+			usize to   = Min(end, limit + pattern.len - 1);
+			usize from = begin;
+			usize at   = 0;
+			while (buffer_find_in(buf, from, to, pattern, s->flags, &at) && at < limit) {
+				dyn_arr_append(&starts, usize, at);
+				from = at + 1;
+			}
+		}
+
+		if (end == len) break;
+	}
+
+	hl.starts = dyn_arr_data(&starts, usize);
+	hl.count  = starts.len;
+	hl.len    = pattern.len;
+	return hl;
+}
+
+///////////////////////////////////////////////
+// ~geb: Search All Buffers
+
+// ~geb: false once the search got cancelled while waiting for room
+internal bool
+_search_all_push(Search_All *sa, Search_All_Worker *w, Search_All_Hit hit)
+{
+	usize head = atomic_load_explicit(&w->head, memory_order_relaxed);
+
+	while (head - atomic_load_explicit(&w->tail, memory_order_acquire) == SEARCH_ALL_RING) {
+		if (atomic_load_explicit(&sa->cancel, memory_order_relaxed)) return false;
+		os_sleep_ns(100000);
+	}
+
+	w->ring[head & (SEARCH_ALL_RING - 1)] = hit;
+	atomic_store_explicit(&w->head, head + 1, memory_order_release);
+	return true;
+}
+
+internal void
+_search_all_proc(void *data)
+{
+	Search_All_Worker *w  = cast(Search_All_Worker *) data;
+	Search_All        *sa = w->owner;
+
+	while (!atomic_load_explicit(&sa->cancel, memory_order_relaxed)) {
+		u32 j = atomic_fetch_add_explicit(&sa->next_job, 1, memory_order_relaxed);
+		if (j >= sa->job_count) break;
+
+		Search_All_Job *job = &sa->jobs[j];
+		Q_Buffer *text = &sa->sources[job->source].snapshot;
+
+		// ~geb: a match starting in the job may run past its end
+		usize to   = Min(buffer_len(text), job->end + sa->pattern.len - 1);
+		usize from = job->begin;
+		usize at   = 0;
+
+		bool more = true;
+		while (more && buffer_find_in(text, from, to, sa->pattern, sa->flags, &at) && at < job->end) {
+			more = _search_all_push(sa, w, (Search_All_Hit){ .job = j, .at = at });
+			from = at + 1;
+		}
+	}
+
+	atomic_store_explicit(&w->done, true, memory_order_release);
+}
+
+internal void
+_search_all_join(Search_All *sa)
+{
+	if (!sa->running) return;
+
+	for (u32 i = 0; i < sa->worker_count; ++i)
+		os_thread_join(sa->workers[i].thread);
+
+	for (u32 i = 0; i < sa->source_count; ++i)
+		buffer_snapshot_release(&sa->sources[i].snapshot);
+
+	sa->running = false;
+}
+
+internal void
+_search_all_stop(Editor_Context *ctx)
+{
+	Search_All *sa = ctx->search_all;
+	if (!sa) return;
+
+	atomic_store_explicit(&sa->cancel, true, memory_order_relaxed);
+	_search_all_join(sa);
+
+	for (u32 i = 0; i < sa->worker_count; ++i)
+		mem_free(sa->alloc, sa->workers[i].ring, NULL);
+
+	for (u32 i = 0; i < sa->job_count; ++i)
+		dynamic_array_delete(&sa->jobs[i].hits);
+
+	if (sa->jobs)    mem_free(sa->alloc, sa->jobs, NULL);
+	if (sa->sources) mem_free(sa->alloc, sa->sources, NULL);
+	mem_free(sa->alloc, sa->pattern.str, NULL);
+	mem_free(sa->alloc, sa, NULL);
+
+	ctx->search_all = NULL;
+}
+
+internal void
+_search_all_begin(Editor_Context *ctx, String8 pattern)
+{
+	_search_all_stop(ctx);
+	if (!pattern.len) return;
+
+	Allocator alloc = ctx->alloc;
+
+	u32 buffers = 0;
+	usize jobs  = 0;
+	for (Q_Buffer *b = ctx->buffer_list; b; b = b->next) {
+		buffers++;
+		jobs += (buffer_len(b) + SEARCH_ALL_JOB_BYTES - 1) / SEARCH_ALL_JOB_BYTES;
+	}
+	if (!jobs || jobs > U32_MAX) return;
+
+	Search_All *sa = alloc_array(alloc, Search_All, 1, NULL);
+	if (!sa) return;
+	ctx->search_all = sa;
+
+	sa->alloc   = alloc;
+	sa->pattern = str8_copy(pattern, alloc);
+	sa->flags   = _search_flags(pattern);
+	sa->current = USIZE_MAX;
+	sa->sources = alloc_array(alloc, Search_All_Source, buffers, NULL);
+	sa->jobs    = alloc_array(alloc, Search_All_Job, jobs, NULL);
+
+	if (!sa->pattern.str || !sa->sources || !sa->jobs) {
+		_search_all_stop(ctx);
+		return;
+	}
+
+	// ~geb: from here on the buffers can be edited, closed or even
+	//       substituted away, the workers only ever see the snapshots
+	for (Q_Buffer *b = ctx->buffer_list; b; b = b->next) {
+		Search_All_Source *src = &sa->sources[sa->source_count];
+		if (!buffer_snapshot(b, &src->snapshot)) continue;
+		src->buffer = b;
+
+		usize len = buffer_len(b);
+		for (usize at = 0; at < len; at += SEARCH_ALL_JOB_BYTES) {
+			sa->jobs[sa->job_count++] = (Search_All_Job){
+				.source = sa->source_count,
+				.begin  = at,
+				.end    = Min(len, at + SEARCH_ALL_JOB_BYTES),
+				.hits   = dynamic_array(alloc, usize, 0),
+			};
+		}
+		sa->source_count++;
+	}
+
+	u32 workers = Min(Max(os_core_count(), 2) - 1, SEARCH_ALL_MAX_WORKERS);
+	workers = Min(workers, sa->job_count);
+
+	sa->running = true;
+	for (u32 i = 0; i < workers; ++i) {
+		Search_All_Worker *w = &sa->workers[sa->worker_count];
+		w->owner = sa;
+		w->ring  = alloc_array_nz(alloc, Search_All_Hit, SEARCH_ALL_RING, NULL);
+		if (!w->ring) break;
+
+		w->thread = os_thread_start(_search_all_proc, w);
+		if (!w->thread.handle) {
+			mem_free(alloc, w->ring, NULL);
+			break;
+		}
+		sa->worker_count++;
+	}
+
+	if (!sa->worker_count) {
+		log_error("could not start any search workers");
+		_search_all_stop(ctx);
+	}
+}
+
+internal void
+editor_search_all_pump(Editor_Context *ctx)
+{
+	Search_All *sa = ctx->search_all;
+	if (!sa || !sa->running) return;
+
+	bool done = true;
+	for (u32 i = 0; i < sa->worker_count; ++i) {
+		Search_All_Worker *w = &sa->workers[i];
+
+		// ~geb: `done` is read first, anything pushed before it was set is in `head`
+		done &= atomic_load_explicit(&w->done, memory_order_acquire);
+
+		usize head = atomic_load_explicit(&w->head, memory_order_acquire);
+		usize tail = atomic_load_explicit(&w->tail, memory_order_relaxed);
+
+		for (; tail != head; ++tail) {
+			Search_All_Hit hit = w->ring[tail & (SEARCH_ALL_RING - 1)];
+			if (sa->overflow) continue;
+
+			dyn_arr_append(&sa->jobs[hit.job].hits, usize, hit.at);
+			if (++sa->hit_count == SEARCH_MAX_HITS) {
+				sa->overflow = true;
+				atomic_store_explicit(&sa->cancel, true, memory_order_relaxed);
+			}
+		}
+
+		atomic_store_explicit(&w->tail, tail, memory_order_release);
+	}
+
+	if (done) _search_all_join(sa);
+}
+
+// ~geb: sends the cursor to the hit after the last one, into whichever
+//       buffer it is in. hits in closed buffers are stepped over
+internal void
+_search_all_next(Editor_Context *ctx)
+{
+	Search_All *sa = ctx->search_all;
+	if (!sa || !sa->hit_count) return;
+
+	u32   j = sa->current == USIZE_MAX ? 0 : sa->current_job;
+	usize i = sa->current == USIZE_MAX ? 0 : sa->current + 1;
+
+	for (u32 n = 0; n <= sa->job_count; ++n) {
+		Search_All_Job *job = &sa->jobs[j];
+		Q_Buffer *b = sa->sources[job->source].buffer;
+
+		if (b && i < job->hits.len) {
+			sa->current_job = j;
+			sa->current     = i;
+
+			_cursors_clear(ctx);
+			ctx->active_buffer = b;
+
+			// ~geb: the buffer may have been edited since it was searched
+			usize at = dyn_arr_data(&job->hits, usize)[i];
+			buffer_set_cursor(b, Min(at, buffer_len(b)));
+			return;
+		}
+
+		j = (j + 1) % sa->job_count;
+		i = 0;
+	}
+}
+
+internal String8
+editor_search_all_status(Editor_Context *ctx, Allocator alloc)
+{
+	Search_All *sa = ctx->search_all;
+	if (!sa) return (String8){0};
+
+	return str8_tprintf(alloc, "all/" STR "  [%zu%s]%s",
+		s_fmt(sa->pattern), sa->hit_count, sa->overflow ? "+" : "",
+		sa->running ? " searching" : "");
+}
+
+///////////////////////////////////////////////
+// ~geb: Find In Files
+
+#define FIND_COMMIT_BLOCK Kb(64)
+
+internal bool
+_find_list_file(Find_In_Files *ff, String8 path)
+{
+	usize count = atomic_load_explicit(&ff->file_count, memory_order_relaxed);
+	if (count == FIND_MAX_FILES) return false;
+
+	if ((count + 1) * sizeof(String8) > ff->files_committed) {
+		if (os_commit(cast(u8 *) ff->files + ff->files_committed, FIND_COMMIT_BLOCK) != 0) return false;
+		ff->files_committed += FIND_COMMIT_BLOCK;
+	}
+
+	ff->files[count] = path;
+	atomic_store_explicit(&ff->file_count, count + 1, memory_order_release);
+	return true;
+}
+
+// ~geb: depth first with an explicit stack, hidden entries and symlinks are
+//       left out so a tree can never be walked into twice
+internal void
+_find_walk_proc(void *data)
+{
+	Find_In_Files *ff = cast(Find_In_Files *) data;
+
+	Dynamic_Array dirs = dynamic_array(ff->alloc, String8, 64);
+	dyn_arr_append(&dirs, String8, ff->root);
+
+	OS_Dir_Iter *it = alloc_array_nz(ff->alloc, OS_Dir_Iter, 1, NULL);
+
+	while (it && dirs.len && !atomic_load_explicit(&ff->cancel, memory_order_relaxed)) {
+		String8 dir = dyn_arr_data(&dirs, String8)[--dirs.len];
+		if (!os_dir_open(dir, it)) continue;
+
+		OS_Dir_Entry e;
+		while (os_dir_next(it, &e)) {
+			if (e.name.str[0] == '.' || (e.flags & (OS_FileFlag_Symlink | OS_FileFlag_Special))) continue;
+
+			usize len = dir.len + 1 + e.name.len;
+			u8 *p = alloc_array_nz(ff->paths, u8, len, NULL);
+			if (!p) break;
+
+			MemMove(p, dir.str, dir.len);
+			p[dir.len] = '/';
+			MemMove(p + dir.len + 1, e.name.str, e.name.len);
+			String8 path = str8(p, len);
+
+			if (e.flags & OS_FileFlag_Directory) dyn_arr_append(&dirs, String8, path);
+			else if (!_find_list_file(ff, path)) break;
+		}
+		os_dir_close(it);
+	}
+
+	if (it) mem_free(ff->alloc, it, NULL);
+	dynamic_array_delete(&dirs);
+	atomic_store_explicit(&ff->walked, true, memory_order_release);
+}
+
+// ~geb: false once the search got cancelled while waiting for room
+internal bool
+_find_push(Find_In_Files *ff, Find_Worker *w, Find_Hit *hit)
+{
+	usize head = atomic_load_explicit(&w->head, memory_order_relaxed);
+
+	while (head - atomic_load_explicit(&w->tail, memory_order_acquire) == FIND_RING) {
+		if (atomic_load_explicit(&ff->cancel, memory_order_relaxed)) return false;
+		os_sleep_ns(100000);
+	}
+
+	w->ring[head & (FIND_RING - 1)] = *hit;
+	atomic_store_explicit(&w->head, head + 1, memory_order_release);
+	return true;
+}
+
+// ~geb: index of the next file to search, waiting on the walker if it is
+//       behind. USIZE_MAX once there are no more
+internal usize
+_find_claim(Find_In_Files *ff)
+{
+	usize i = atomic_fetch_add_explicit(&ff->next_file, 1, memory_order_relaxed);
+
+	for (;;) {
+		if (atomic_load_explicit(&ff->cancel, memory_order_relaxed)) return USIZE_MAX;
+
+		bool walked = atomic_load_explicit(&ff->walked, memory_order_acquire);
+		if (i < atomic_load_explicit(&ff->file_count, memory_order_acquire)) return i;
+		if (walked) return USIZE_MAX;
+
+		os_sleep_ns(200000);
+	}
+}
+
+// ~geb: every hit in one file, lines are counted only up to each hit
+internal bool
+_find_search_file(Find_In_Files *ff, Find_Worker *w, u32 file, String8 text)
+{
+	usize m = ff->pattern.len;
+	usize line    = 0;
+	usize counted = 0;
+
+	for (usize at = 0; at + m <= text.len;) {
+		usize hit = buffer_search_memory(&ff->search, text.str + at, text.len - at);
+		if (hit == text.len - at) break;
+
+		usize off = at + hit;
+		line   += mem_count_byte(text.str + counted, off - counted, '\n');
+		counted = off;
+
+		// ~geb: the preview starts at the line, or a little in front of the hit on a long one
+		usize back  = Min(off, FIND_PREVIEW / 3);
+		usize nl    = mem_find_byte_rev(text.str + off - back, back, '\n');
+		usize begin = nl < back ? off - back + nl + 1 : off - back;
+		usize room  = Min(text.len - begin, FIND_PREVIEW);
+
+		Find_Hit h = {
+			.file   = file,
+			.line   = cast(u32) Min(line, U32_MAX),
+			.offset = off,
+		};
+		h.preview_len = cast(u8) mem_find_byte(text.str + begin, room, '\n');
+		MemMove(h.preview, text.str + begin, h.preview_len);
+
+		if (!_find_push(ff, w, &h)) return false;
+		at = off + 1;
+	}
+	return true;
+}
+
+internal void
+_find_proc(void *data)
+{
+	Find_Worker   *w  = cast(Find_Worker *) data;
+	Find_In_Files *ff = w->owner;
+
+	for (usize i = _find_claim(ff); i != USIZE_MAX; i = _find_claim(ff)) {
+		OS_Handle file = os_file_open(OS_AccessFlag_Read, ff->files[i]);
+		OS_FileProps props = os_properties_from_file(file);
+
+		// ~geb: most files in a tree are small, reading them is cheaper than
+		//       setting up and tearing down a mapping for each
+		String8 text = {0};
+		bool mapped = props.size > FIND_READ_MAX;
+		if (mapped) text = str8(os_file_map(file, props.size), props.size);
+		else        text = str8(w->scratch, os_file_read(file, 0, props.size, w->scratch));
+		os_file_close(file);
+
+		if (!text.str) text.len = 0;
+
+		bool binary = mem_find_byte(text.str, Min(text.len, FIND_SNIFF), 0) < Min(text.len, FIND_SNIFF);
+		bool more   = binary || !text.len || _find_search_file(ff, w, cast(u32) i, text);
+
+		if (mapped) os_file_unmap(text.str, text.len);
+		atomic_fetch_add_explicit(&ff->files_done, 1, memory_order_relaxed);
+		if (!more) break;
+	}
+
+	atomic_store_explicit(&w->done, true, memory_order_release);
+}
+
+internal void
+_find_join(Find_In_Files *ff)
+{
+	if (!ff->running) return;
+
+	os_thread_join(ff->walker);
+	for (u32 i = 0; i < ff->worker_count; ++i)
+		os_thread_join(ff->workers[i].thread);
+
+	ff->running = false;
+}
+
+internal void
+_find_stop(Editor_Context *ctx)
+{
+	Find_In_Files *ff = ctx->find;
+	if (!ff) return;
+
+	atomic_store_explicit(&ff->cancel, true, memory_order_relaxed);
+	_find_join(ff);
+
+	for (u32 i = 0; i < ff->worker_count; ++i) {
+		mem_free(ff->alloc, ff->workers[i].ring, NULL);
+		mem_free(ff->alloc, ff->workers[i].scratch, NULL);
+	}
+
+	if (ff->files)         os_release(ff->files, FIND_MAX_FILES * sizeof(String8));
+	if (ff->paths.data)    arena_allocator_release(ff->paths);
+	if (ff->previews.data) arena_allocator_release(ff->previews);
+	dynamic_array_delete(&ff->results);
+	mem_free(ff->alloc, ff->pattern.str, NULL);
+	mem_free(ff->alloc, ff->root.str, NULL);
+	mem_free(ff->alloc, ff, NULL);
+
+	ctx->find = NULL;
+}
+
+internal void
+_find_begin(Editor_Context *ctx, String8 root, String8 pattern)
+{
+	_find_stop(ctx);
+	if (!pattern.len) return;
+
+	Allocator alloc = ctx->alloc;
+	Find_In_Files *ff = alloc_array(alloc, Find_In_Files, 1, NULL);
+	if (!ff) return;
+	ctx->find = ff;
+
+	ff->alloc    = alloc;
+	ff->root     = str8_copy(root, alloc);
+	ff->pattern  = str8_copy(pattern, alloc);
+	ff->paths    = arena_allocator(Gb(1));
+	ff->previews = arena_allocator(Gb(1));
+	ff->files    = cast(String8 *) os_reserve(FIND_MAX_FILES * sizeof(String8));
+	ff->results  = dynamic_array(alloc, Find_Result, 0);
+	ff->showing  = true;
+
+	if (!ff->root.str || !ff->pattern.str || !ff->paths.data || !ff->previews.data || !ff->files) {
+		_find_stop(ctx);
+		return;
+	}
+
+	buffer_search_prepare(&ff->search, ff->pattern, _search_flags(pattern));
+
+	ff->walker = os_thread_start(_find_walk_proc, ff);
+	if (!ff->walker.handle) {
+		_find_stop(ctx);
+		return;
+	}
+	ff->running = true;
+
+	u32 workers = Min(Max(os_core_count(), 2) - 1, SEARCH_ALL_MAX_WORKERS);
+	for (u32 i = 0; i < workers; ++i) {
+		Find_Worker *w = &ff->workers[ff->worker_count];
+		w->owner = ff;
+		w->ring    = alloc_array_nz(alloc, Find_Hit, FIND_RING, NULL);
+		w->scratch = alloc_array_nz(alloc, u8, FIND_READ_MAX, NULL);
+
+		w->thread = w->ring && w->scratch ? os_thread_start(_find_proc, w) : (OS_Thread){0};
+		if (!w->thread.handle) {
+			if (w->ring)    mem_free(alloc, w->ring, NULL);
+			if (w->scratch) mem_free(alloc, w->scratch, NULL);
+			break;
+		}
+		ff->worker_count++;
+	}
+
+	if (!ff->worker_count) {
+		log_error("could not start any search workers");
+		_find_stop(ctx);
+	}
+}
+
+internal void
+editor_find_pump(Editor_Context *ctx)
+{
+	Find_In_Files *ff = ctx->find;
+	if (!ff || !ff->running) return;
+
+	bool done = true;
+	for (u32 i = 0; i < ff->worker_count; ++i) {
+		Find_Worker *w = &ff->workers[i];
+		done &= atomic_load_explicit(&w->done, memory_order_acquire);
+
+		usize head = atomic_load_explicit(&w->head, memory_order_acquire);
+		usize tail = atomic_load_explicit(&w->tail, memory_order_relaxed);
+
+		for (; tail != head; ++tail) {
+			Find_Hit *h = &w->ring[tail & (FIND_RING - 1)];
+			if (ff->overflow) continue;
+
+			Find_Result r = { .file = h->file, .line = h->line, .offset = h->offset };
+			r.preview = str8_copy(str8(h->preview, h->preview_len), ff->previews);
+			dyn_arr_append(&ff->results, Find_Result, r);
+
+			if (ff->results.len == SEARCH_MAX_HITS) {
+				ff->overflow = true;
+				atomic_store_explicit(&ff->cancel, true, memory_order_relaxed);
+			}
+		}
+
+		atomic_store_explicit(&w->tail, tail, memory_order_release);
+	}
+
+	if (done) _find_join(ff);
+}
+
+// ~geb: `path:line: preview` for one row of the results
+internal String8
+editor_find_row(Find_In_Files *ff, usize row, Allocator alloc)
+{
+	if (row >= ff->results.len) return (String8){0};
+
+	Find_Result *r = &dyn_arr_data(&ff->results, Find_Result)[row];
+	return str8_tprintf(alloc, STR ":%u: " STR, s_fmt(ff->files[r->file]), r->line + 1, s_fmt(r->preview));
+}
+
+internal String8
+editor_find_status(Find_In_Files *ff, Allocator alloc)
+{
+	usize files = atomic_load_explicit(&ff->file_count, memory_order_acquire);
+	usize done  = atomic_load_explicit(&ff->files_done, memory_order_relaxed);
+
+	return str8_tprintf(alloc, " grep/" STR "  [%zu%s]  %zu/%zu files%s",
+		s_fmt(ff->pattern), ff->results.len, ff->overflow ? "+" : "",
+		done, files, ff->running ? " searching" : "");
+}
+
+///////////////////////////////////////////////
+// ~geb: Views
+
+internal void
+_view_release(Editor_View *v)
+{
+	if (!v->buffer) return;
+
+	buffer_mark_remove(v->buffer, v->cursor);
+	buffer_mark_remove(v->buffer, v->top);
+	*v = (Editor_View){0};
+}
+
+// ~geb: the view shows `buf` from the row the buffer's cursor is on
+internal void
+_view_attach(Editor_View *v, Q_Buffer *buf)
+{
+	usize top = buffer_offset_from_row(buf, buffer_row_from_offset(buf, buf->cursor));
+
+	v->buffer = buf;
+	v->cursor = buffer_mark_add(buf, buf->cursor, Mark_Right);
+	v->top    = buffer_mark_add(buf, top, Mark_Left);
+}
+
+internal void
+_view_remove(Editor_Context *ctx, u32 i)
+{
+	_view_release(&ctx->views[i]);
+
+	MemMove(ctx->views + i, ctx->views + i + 1, (ctx->view_count - 1 - i) * sizeof(Editor_View));
+	ctx->view_count--;
+	if (ctx->view > i) ctx->view--;
+}
+
+// ~geb: the buffer's cursor goes back into the mark of the view losing
+//       focus and comes out of the one getting it. no text moves
+internal void
+_view_focus(Editor_Context *ctx, u32 i)
+{
+	Editor_View *v = &ctx->views[ctx->view];
+	if (v->buffer) buffer_mark_move(v->buffer, v->cursor, v->buffer->cursor);
+
+	ctx->view = i;
+	v = &ctx->views[i];
+
+	_cursors_clear(ctx);
+	ctx->active_buffer = v->buffer;
+	if (v->buffer) buffer_set_cursor(v->buffer, buffer_mark_offset(v->buffer, v->cursor));
+}
+
+// ~geb: run after every command, the focused view goes wherever the active
+//       buffer went
+internal void
+_view_follow(Editor_Context *ctx)
+{
+	Q_Buffer *b = ctx->active_buffer;
+
+	if (!ctx->view_count) {
+		if (!b) return;
+		ctx->views[0]   = (Editor_View){0};
+		ctx->view_count = 1;
+		ctx->view       = 0;
+	}
+
+	Editor_View *v = &ctx->views[ctx->view];
+	if (v->buffer == b) return;
+
+	_view_release(v);
+	if (b) _view_attach(v, b);
+}
+
+// ~geb: the new view shows what the focused one does and takes the focus,
+//       the cursor stays the buffer's
+internal void
+_cmd_view_split(Editor_Context *ctx)
+{
+	Q_Buffer *b = ctx->active_buffer;
+	if (!b || !ctx->view_count || ctx->view_count >= EDITOR_MAX_VIEWS) return;
+
+	Editor_View *from = &ctx->views[ctx->view];
+	buffer_mark_move(b, from->cursor, b->cursor);
+
+	Editor_View v = {
+		.buffer = b,
+		.cursor = buffer_mark_add(b, b->cursor, Mark_Right),
+		.top    = buffer_mark_add(b, buffer_mark_offset(b, from->top), Mark_Left),
+	};
+
+	u32 at = ctx->view + 1;
+	MemMove(ctx->views + at + 1, ctx->views + at, (ctx->view_count - at) * sizeof(Editor_View));
+	ctx->views[at] = v;
+	ctx->view_count++;
+	ctx->view = at;
+}
+
+internal void
+_cmd_view_close(Editor_Context *ctx)
+{
+	if (ctx->view_count < 2) return;
+
+	_view_remove(ctx, ctx->view);
+	ctx->view = Min(ctx->view, ctx->view_count - 1);
+
+	// ~geb: nothing to hand back to the view that is gone
+	Editor_View *v = &ctx->views[ctx->view];
+	_cursors_clear(ctx);
+	ctx->active_buffer = v->buffer;
+	if (v->buffer) buffer_set_cursor(v->buffer, buffer_mark_offset(v->buffer, v->cursor));
+}
+
+// ~geb: the top moves by display rows, so it lands on the start of one
+internal void
+_cmd_scroll(Editor_Context *ctx, Scroll cmd)
+{
+	if (!ctx->view_count) return;
+
+	Editor_View *v = &ctx->views[ctx->view];
+	Q_Buffer    *b = v->buffer;
+	if (!b || !cmd.rows) return;
+
+	usize row = editor_view_top_row(ctx, ctx->view);
+	row = cmd.rows < 0 && cast(usize) -cmd.rows > row ? 0 : row + cast(usize) cmd.rows;
+
+	usize top = 0;
+	Wrap_Layout *wl = editor_wrap(ctx, b);
+	if (wl) {
+		usize cell = 0;
+		top = wrap_offset_from_row(wl, row, &cell);
+	} else {
+		top = buffer_offset_from_row(b, buffer_row_from_visible(b, row));
+	}
+
+	buffer_mark_move(b, v->top, top);
+}
+
+internal usize
+editor_view_cursor(Editor_Context *ctx, u32 view)
+{
+	Editor_View *v = &ctx->views[view];
+	if (!v->buffer) return 0;
+
+	return view == ctx->view ? v->buffer->cursor : buffer_mark_offset(v->buffer, v->cursor);
+}
+
+// ~geb: display rows while wrapping, otherwise the rows the folds leave in view
+internal usize
+editor_view_top_row(Editor_Context *ctx, u32 view)
+{
+	Editor_View *v = &ctx->views[view];
+	if (!v->buffer) return 0;
+
+	usize top = buffer_mark_offset(v->buffer, v->top);
+
+	Wrap_Layout *wl = editor_wrap(ctx, v->buffer);
+	if (wl) return wrap_row_from_offset(wl, top);
+
+	return buffer_visible_row(v->buffer, buffer_row_from_offset(v->buffer, top));
+}
+
+///////////////////////////////////////////////
+// ~geb: Commands
+
+// ~geb: the text up to the next unescaped `delim`, which is stepped over.
+//       `\delim` stands for the delimiter itself, every other escape is left
+//       for the regex or the replacement to read.
+internal String8
+_command_field(String8 line, usize *at, u8 delim, Allocator alloc)
+{
+	u8   *out = alloc_array_nz(alloc, u8, line.len + 1, NULL);
+	usize n   = 0;
+	usize i   = *at;
+
+	for (; i < line.len && line.str[i] != delim; ++i) {
+		if (line.str[i] == '\\' && i + 1 < line.len) {
+			if (line.str[i + 1] != delim) out[n++] = '\\';
+			++i;
+		}
+		out[n++] = line.str[i];
+	}
+
+	*at = i < line.len ? i + 1 : i;
+	return str8(out, n);
+}
+
+// ~geb: layouts are made again as buffers are shown with wrapping back on
+internal void
+_wrap_toggle(Editor_Context *ctx)
+{
+	ctx->wrap = !ctx->wrap;
+	if (ctx->wrap) return;
+
+	Buffer_Caches *caches = dyn_arr_data(&ctx->caches, Buffer_Caches);
+	for (usize i = 0; i < ctx->caches.len; ++i) {
+		wrap_delete(caches[i].wrap);
+		caches[i].wrap = NULL;
+	}
+}
+
+// ~geb: `s/pattern/replacement/flags` on the cursor's line, `%s/...` on the
+//       whole buffer. any byte after the `s` can stand in for the `/`. `g`
+//       replaces every match on a line instead of the first, `i` ignores case.
+internal void
+_command_run(Editor_Context *ctx, String8 line)
+{
+	// ~geb: `grep pattern` searches the files under the working directory,
+	//       everything after the space is the pattern
+	String8 grep = S("grep ");
+	if (line.len > grep.len && MemCompare(line.str, grep.str, grep.len) == 0) {
+		_find_begin(ctx, S("."), str8_slice(line, grep.len, line.len));
+		return;
+	}
+
+	if (str8_equal(line, S("wrap"))) {
+		_wrap_toggle(ctx);
+		return;
+	}
+
+	// ~geb: `w` saves the active buffer to its name, `w path` saves it to path
+	String8 write = S("w ");
+	if (str8_equal(line, S("w")) || (line.len > write.len && MemCompare(line.str, write.str, write.len) == 0)) {
+		String8 path = line.len > write.len ? str8_slice(line, write.len, line.len) : (String8){0};
+		editor_push_cmd(ctx, (Editor_Cmd){ .type = Cmd_Buffer_Save, .buffer_save = { .path = path } });
+		return;
+	}
+
+	if (str8_equal(line, S("split"))) {
+		_cmd_view_split(ctx);
+		return;
+	}
+
+	if (str8_equal(line, S("close"))) {
+		_cmd_view_close(ctx);
+		return;
+	}
+
+	Q_Buffer *buf = ctx->active_buffer;
+	if (!buf || !line.len) return;
+
+	usize at = 0;
+	bool whole = line.str[at] == '%';
+	if (whole) ++at;
+
+	if (at + 1 >= line.len || line.str[at] != 's') {
+		log_error("unknown command " STR, s_fmt(line));
+		return;
+	}
+
+	u8 delim = line.str[at + 1];
+	at += 2;
+
+	String8 pattern     = _command_field(line, &at, delim, ctx->frame_alloc);
+	String8 replacement = _command_field(line, &at, delim, ctx->frame_alloc);
+
+	Substitute_Flags flags    = 0;
+	Regex_Flags      re_flags = 0;
+	for (; at < line.len; ++at) {
+		switch (line.str[at]) {
+			case 'g': flags    |= Substitute_Flag_Global; break;
+			case 'i': re_flags |= Regex_Flag_Ignore_Case; break;
+			default:
+				log_error("unknown substitute flag '%c'", line.str[at]);
+				return;
+		}
+	}
+
+	String8 error = {0};
+	Regex *re = regex_compile(pattern, re_flags, ctx->alloc, &error);
+	if (!re) {
+		log_error("bad pattern " STR ": " STR, s_fmt(pattern), s_fmt(error));
+		return;
+	}
+
+	usize begin = 0;
+	usize end   = buffer_len(buf);
+	if (!whole) {
+		usize row = buffer_row_from_offset(buf, buf->cursor);
+		begin = buffer_offset_from_row(buf, row);
+		end   = buffer_row_end(buf, row);
+	}
+
+	_cursors_clear(ctx);
+	buffer_substitute(buf, re, begin, end, replacement, flags);
+	regex_release(re);
+}
+
 ///////////////////////////////////////////////
 // ~geb: Command Handlers
 
+internal void
+_cmd_cursor_add(Editor_Context *ctx, Cursor_Add cmd)
+{
+	Q_Buffer *buf = ctx->active_buffer;
+	if (!buf) return;
+
+	if (!ctx->cursors.len)
+		dyn_arr_append(&ctx->cursors, usize, buf->cursor);
+
+	Wrap_Layout *wl = editor_wrap(ctx, buf);
+
+	usize at = wl
+		? wrap_offset_by_rows(wl, buf->cursor, cmd.rows)
+		: buffer_offset_by_rows(buf, buf->cursor, cmd.rows, ctx->tab_width);
+	usize i  = _cursors_lower_bound(ctx, at);
+
+	if (i == ctx->cursors.len || dyn_arr_data(&ctx->cursors, usize)[i] != at) {
+		dyn_arr_append(&ctx->cursors, usize, 0);
+
+		usize *c = dyn_arr_data(&ctx->cursors, usize);
+		MemMove(c + i + 1, c + i, (ctx->cursors.len - 1 - i) * sizeof(usize));
+		c[i] = at;
+	}
+
+	buffer_set_cursor(buf, at);
+}
+
 internal void
 _cmd_mode_change(Editor_Context *ctx, Mode_Change cmd)
 {
 	ctx->mode = cmd.to;
+
+	if (ctx->active_buffer)
+		buffer_history_break(ctx->active_buffer);
 }
 
 internal void
 _cmd_buffer_open(Editor_Context *ctx, Buffer_New cmd)
 {
-	String8 src = os_data_from_path(cmd.name, ctx->frame_alloc);
+	String8 mapping = os_map_from_path(cmd.name);
 
-	Q_Buffer *b = buffer_make(cmd.name,
-	                          src,
-	                          ctx->active_buffer,
-	                          ctx->alloc);
+	Q_Buffer *b = mapping.len
+		? buffer_make_mapped(cmd.name, mapping, ctx->active_buffer, ctx->alloc)
+		: buffer_make(cmd.name, S(""), ctx->active_buffer, ctx->alloc);
 
 	if (!b) return;
 
+	Syntax_Language *lang = syntax_language_for(cmd.name);
+
+	Buffer_Caches bc = {0};
+	bc.buffer = b;
+	bc.syntax = lang ? syntax_cache_make(b, lang, ctx->alloc) : NULL;
+	bc.pairs  = pairs_make(b, ctx->alloc);
+	dyn_arr_append(&ctx->caches, Buffer_Caches, bc);
+
+	_cursors_clear(ctx);
 	ctx->active_buffer = b;
 
 	if (!ctx->buffer_list)
@@ -33,8 +1138,35 @@ _cmd_buffer_close(Editor_Context *ctx, Buffer_Close cmd)
 	Q_Buffer *b = cmd.buffer;
 	if (!b) return;
 
-	if (ctx->active_buffer == b)
+	if (ctx->active_buffer == b) {
+		_cursors_clear(ctx);
 		ctx->active_buffer = b->next ? b->next : b->prev;
+	}
+
+	Search_All *sa = ctx->search_all;
+	for (u32 i = 0; sa && i < sa->source_count; ++i) {
+		if (sa->sources[i].buffer == b) sa->sources[i].buffer = NULL;
+	}
+
+	// ~geb: the other views onto it close, the focused one follows the
+	//       buffer made active
+	for (u32 i = ctx->view_count; i-- > 0;) {
+		if (ctx->views[i].buffer != b) continue;
+
+		if (i == ctx->view) _view_release(&ctx->views[i]);
+		else                _view_remove(ctx, i);
+	}
+
+	Buffer_Caches *caches = dyn_arr_data(&ctx->caches, Buffer_Caches);
+	for (usize i = 0; i < ctx->caches.len; ++i) {
+		if (caches[i].buffer != b) continue;
+
+		if (caches[i].syntax) syntax_cache_delete(caches[i].syntax);
+		if (caches[i].pairs)  pairs_delete(caches[i].pairs);
+		if (caches[i].wrap)   wrap_delete(caches[i].wrap);
+		caches[i] = caches[--ctx->caches.len];
+		break;
+	}
 
 	if (ctx->buffer_list == b)
 		ctx->buffer_list = b->next;
@@ -42,19 +1174,82 @@ _cmd_buffer_close(Editor_Context *ctx, Buffer_Close cmd)
 	buffer_delete(b);
 }
 
+internal void
+_cmd_buffer_save(Editor_Context *ctx, Buffer_Save cmd)
+{
+	Q_Buffer *b = cmd.buffer ? cmd.buffer : ctx->active_buffer;
+	if (!b) return;
+
+	String8 path = cmd.path.len ? cmd.path : b->name;
+
+	if (!buffer_save(b, path, ctx->save_sync))
+		log_error("failed to save " STR, s_fmt(path));
+}
+
+internal void
+_cmd_prompt_begin(Editor_Context *ctx, Prompt_Kind kind)
+{
+	if (!ctx->active_buffer || ctx->mode == Mode_CLI) return;
+
+	_cursors_clear(ctx);
+	buffer_history_break(ctx->active_buffer);
+
+	Editor_Search *s = &ctx->search;
+	_search_reset(s);
+	s->origin = ctx->active_buffer->cursor;
+
+	buffer_erase_range(ctx->cli_buffer, 0, buffer_len(ctx->cli_buffer));
+	ctx->prompt        = kind;
+	ctx->prompt_return = ctx->mode;
+	ctx->mode = Mode_CLI;
+}
+
+internal void
+_cmd_prompt_end(Editor_Context *ctx, bool accept)
+{
+	if (ctx->mode != Mode_CLI) return;
+
+	Editor_Search *s = &ctx->search;
+	if (ctx->prompt == Prompt_Search && !accept && ctx->active_buffer)
+		buffer_set_cursor(ctx->active_buffer, s->origin);
+
+	_search_reset(s);
+	ctx->mode = ctx->prompt_return;
+
+	if (!accept || ctx->prompt == Prompt_Search) return;
+
+	String8 line = buffer_slice(ctx->cli_buffer, 0, buffer_len(ctx->cli_buffer), ctx->frame_alloc);
+	if (ctx->prompt == Prompt_Command) _command_run(ctx, line);
+	else                               _search_all_begin(ctx, line);
+}
+
 internal void
 _cmd_text_insert(Editor_Context *ctx, Text_Insert cmd)
 {
+	if (ctx->mode == Mode_CLI) {
+		buffer_insert(ctx->cli_buffer, cmd.text, ctx->tab_width);
+		if (ctx->prompt == Prompt_Search) _search_update(ctx);
+		return;
+	}
+
 	if (ctx->mode != Mode_Insert) return;
 
 	if (!ctx || !ctx->active_buffer) return;
 	if (cmd.text.len == 0) return;
 
 	Q_Buffer *buf = ctx->active_buffer;
+
+	if (_multi_cursor(ctx)) {
+		ctx->cursors.len = buffer_insert_multi(buf,
+			dyn_arr_data(&ctx->cursors, usize), ctx->cursors.len,
+			_cursors_primary(ctx), cmd.text, ctx->tab_width);
+		return;
+	}
+
 	UTF8_Error err = 0;
 	u32 cp = utf8_decode(cmd.text.str, &err);
 	if (err) {
-		ctx->active_buffer = buffer_insert(buf, cmd.text, ctx->tab_width);
+		buffer_insert(buf, cmd.text, ctx->tab_width);
 		return;
 	}
 
@@ -69,7 +1264,7 @@ _cmd_text_insert(Editor_Context *ctx, Text_Insert cmd)
 		return;
 	}
 
-	ctx->active_buffer = buffer_insert(buf, cmd.text, ctx->tab_width);
+	buffer_insert(buf, cmd.text, ctx->tab_width);
 
 	rune cursor_cp = buffer_peek(buf);
 	bool should_pair = cursor_cp == 0 || is_space(cursor_cp) || is_pair_end(cursor_cp) || is_pair_begin(cursor_cp);
@@ -77,8 +1272,8 @@ _cmd_text_insert(Editor_Context *ctx, Text_Insert cmd)
 	if (single_codepoint && should_pair) {
 		String8 pair = get_pair_end(cp);
 		if (pair.len) {
-			ctx->active_buffer = buffer_insert(ctx->active_buffer, pair, ctx->tab_width);
-			buffer_move_left(ctx->active_buffer, ctx->tab_width);
+			buffer_insert(buf, pair, ctx->tab_width);
+			buffer_move_left(buf, ctx->tab_width);
 		}
 	}
 }
@@ -86,20 +1281,58 @@ _cmd_text_insert(Editor_Context *ctx, Text_Insert cmd)
 internal void
 _cmd_text_delete(Editor_Context *ctx, Text_Delete cmd)
 {
+	if (ctx->mode == Mode_CLI) {
+		Q_Buffer *cli = ctx->cli_buffer;
+		usize other = buffer_offset_by_codepoints(cli, cli->cursor, cmd.move ? -cast(isize) cmd.amount : cast(isize) cmd.amount);
+		buffer_erase_range(cli, Min(cli->cursor, other), Max(cli->cursor, other));
+		if (ctx->prompt == Prompt_Search) _search_update(ctx);
+		return;
+	}
+
 	if (ctx->mode != Mode_Insert) return;	
 
 	if (!ctx->active_buffer) return;
 
 	Q_Buffer *buf = ctx->active_buffer;
 
-	for (int i = 0; i < cmd.amount; ++i) {
-		if (cmd.move) {
-			if (buf->gap_pos <= 0) break;
-			buffer_move_left(buf, ctx->tab_width);
+	if (_multi_cursor(ctx)) {
+		if (cmd.unit == Delete_Codepoints) {
+			isize amount = cmd.move ? -cast(isize) cmd.amount : cast(isize) cmd.amount;
+			ctx->cursors.len = buffer_erase_multi(buf,
+				dyn_arr_data(&ctx->cursors, usize), ctx->cursors.len,
+				_cursors_primary(ctx), amount);
+			return;
 		}
+		_cursors_clear(ctx);
+	}
+
+	usize begin = cmd.begin;
+	usize end   = cmd.end;
+	usize cursor = buf->cursor;
+	isize amount = cmd.move ? -cast(isize) cmd.amount : cast(isize) cmd.amount;
 
-		buffer_erase(buf);
+	switch (cmd.unit) {
+		case Delete_Codepoints: {
+			usize other = buffer_offset_by_codepoints(buf, cursor, amount);
+			begin = Min(cursor, other);
+			end   = Max(cursor, other);
+		} break;
+
+		case Delete_Bytes: {
+			usize len = buffer_len(buf);
+			begin = cmd.move ? cursor - Min(cursor, cast(usize) cmd.amount) : cursor;
+			end   = cmd.move ? cursor : Min(cursor + cast(usize) cmd.amount, len);
+		} break;
 	}
+
+	if (begin >= end) return;
+
+	// ~geb: a range delete never coalesces with the typing around it
+	if (cmd.unit == Delete_Range) buffer_history_break(buf);
+
+	buffer_erase_range(buf, begin, end);
+
+	if (cmd.unit == Delete_Range) buffer_history_break(buf);
 }
 
 internal void
@@ -109,6 +1342,24 @@ _cmd_cursor_move(Editor_Context *ctx, Cursor_Move cmd)
 
 	Q_Buffer *buf = ctx->active_buffer;
 
+	// ~geb: up and down go by display rows while wrapping
+	Wrap_Layout *wl = cmd.dy ? editor_wrap(ctx, buf) : NULL;
+
+	if (_multi_cursor(ctx)) {
+		usize *c = dyn_arr_data(&ctx->cursors, usize);
+		usize primary = _cursors_primary(ctx);
+
+		for (usize i = 0; i < ctx->cursors.len; ++i) {
+			if (cmd.dx) c[i] = buffer_offset_by_codepoints(buf, c[i], cmd.dx);
+			if (cmd.dy && wl) c[i] = wrap_offset_by_rows(wl, c[i], cmd.dy);
+			else if (cmd.dy)  c[i] = buffer_offset_by_rows(buf, c[i], cmd.dy, ctx->tab_width);
+		}
+
+		buffer_set_cursor(buf, c[primary]);
+		_cursors_normalize(ctx);
+		return;
+	}
+
 	if (cmd.dx < 0) {
 		for (int i = 0; i < -cmd.dx; ++i)
 			buffer_move_left(buf, ctx->tab_width);
@@ -118,7 +1369,10 @@ _cmd_cursor_move(Editor_Context *ctx, Cursor_Move cmd)
 			buffer_move_right(buf, ctx->tab_width);
 	}
 
-	if (cmd.dy < 0) {
+	if (wl) {
+		buffer_set_cursor(buf, wrap_offset_by_rows(wl, buf->cursor, cmd.dy));
+	}
+	else if (cmd.dy < 0) {
 		for (int i = 0; i < -cmd.dy; ++i)
 			buffer_move_up(buf, ctx->tab_width);
 	}
@@ -128,7 +1382,253 @@ _cmd_cursor_move(Editor_Context *ctx, Cursor_Move cmd)
 	}
 }
 
+internal void
+_cmd_undo(Editor_Context *ctx)
+{
+	if (!ctx->active_buffer) return;
+	_cursors_clear(ctx);
+	buffer_undo(ctx->active_buffer, ctx->tab_width);
+}
+
+internal void
+_cmd_redo(Editor_Context *ctx)
+{
+	if (!ctx->active_buffer) return;
+	_cursors_clear(ctx);
+	buffer_redo(ctx->active_buffer, ctx->tab_width);
+}
+
+internal void
+_cmd_find_select(Editor_Context *ctx, Find_Select cmd)
+{
+	Find_In_Files *ff = ctx->find;
+	if (!ff || !ff->showing || !ff->results.len) return;
+
+	isize last = cast(isize) ff->results.len - 1;
+	isize to   = cast(isize) ff->selected + cmd.rows;
+	ff->selected = cast(usize) Clamp(0, to, last);
+}
+
+// ~geb: goes to the selected hit, in the buffer already open on its file if
+//       there is one
+internal void
+_cmd_find_open(Editor_Context *ctx)
+{
+	Find_In_Files *ff = ctx->find;
+	if (!ff || !ff->showing || ff->selected >= ff->results.len) return;
+
+	Find_Result *r = &dyn_arr_data(&ff->results, Find_Result)[ff->selected];
+	String8 path = ff->files[r->file];
+
+	Q_Buffer *b = ctx->buffer_list;
+	while (b && !str8_equal(b->name, path))
+		b = b->next;
+
+	if (b) {
+		_cursors_clear(ctx);
+		ctx->active_buffer = b;
+	} else {
+		editor_push_cmd(ctx, (Editor_Cmd){ .type = Cmd_Buffer_Open, .buffer_open = { .name = path } });
+		if (!ctx->active_buffer || !str8_equal(ctx->active_buffer->name, path)) return;
+	}
+
+	// ~geb: the file may have changed since it was searched
+	buffer_set_cursor(ctx->active_buffer, Min(r->offset, buffer_len(ctx->active_buffer)));
+	ff->showing = false;
+}
+
+///////////////////////////////////////////////
+// ~geb: Buffer caches
+
+internal Buffer_Caches *
+editor_caches(Editor_Context *ctx, Q_Buffer *buf)
+{
+	Buffer_Caches *caches = dyn_arr_data(&ctx->caches, Buffer_Caches);
+	for (usize i = 0; i < ctx->caches.len; ++i) {
+		if (caches[i].buffer == buf) return &caches[i];
+	}
+	return NULL;
+}
+
+// ~geb: only the buffers in view are indexed ahead, the others catch up once shown
+internal void
+editor_caches_pump(Editor_Context *ctx)
+{
+	for (u32 i = 0; i < ctx->view_count; ++i) {
+		Q_Buffer *b = ctx->views[i].buffer;
+
+		bool pumped = false;
+		for (u32 j = 0; j < i; ++j)
+			pumped |= ctx->views[j].buffer == b;
+
+		Buffer_Caches *bc = b && !pumped ? editor_caches(ctx, b) : NULL;
+		if (!bc) continue;
+
+		if (bc->syntax) syntax_pump(bc->syntax, ctx->frame_alloc);
+		if (bc->pairs)  pairs_pump(bc->pairs);
+		wrap_pump(editor_wrap(ctx, b));
+	}
+}
+
+// ~geb: the layout is made the first time a buffer is shown wrapped
+internal Wrap_Layout *
+editor_wrap(Editor_Context *ctx, Q_Buffer *buf)
+{
+	Buffer_Caches *bc = ctx->wrap && buf ? editor_caches(ctx, buf) : NULL;
+	if (!bc) return NULL;
+
+	if (!bc->wrap)
+		bc->wrap = wrap_make(buf, ctx->wrap_cols, ctx->alloc);
+	return bc->wrap;
+}
+
+internal void
+editor_wrap_resize(Editor_Context *ctx, usize cols)
+{
+	ctx->wrap_cols = cols;
+
+	Buffer_Caches *caches = dyn_arr_data(&ctx->caches, Buffer_Caches);
+	for (usize i = 0; i < ctx->caches.len; ++i) {
+		if (caches[i].wrap) wrap_set_cols(caches[i].wrap, cols);
+	}
+}
+
+///////////////////////////////////////////////
+// ~geb: Brackets
+
+internal Editor_Selection
+editor_selection(Editor_Context *ctx)
+{
+	Editor_Selection sel = {0};
+	if (!ctx->active_buffer || ctx->select_begin == MARK_NONE) return sel;
+
+	sel.begin = buffer_mark_offset(ctx->active_buffer, ctx->select_begin);
+	sel.end   = buffer_mark_offset(ctx->active_buffer, ctx->select_end);
+	return sel;
+}
+
+internal void
+_selection_clear(Editor_Context *ctx)
+{
+	if (ctx->select_begin == MARK_NONE) return;
+
+	buffer_mark_remove(ctx->active_buffer, ctx->select_begin);
+	buffer_mark_remove(ctx->active_buffer, ctx->select_end);
+	ctx->select_begin = ctx->select_end = MARK_NONE;
+}
+
+// ~geb: the bracket under the cursor, or else the one right in front of it
+internal void
+_cmd_pair_jump(Editor_Context *ctx)
+{
+	Q_Buffer *b = ctx->active_buffer;
+	Buffer_Caches *bc = b ? editor_caches(ctx, b) : NULL;
+	if (!bc || !bc->pairs) return;
+
+	usize at = b->cursor, match;
+	bool found = pairs_match(bc->pairs, at, &match);
+	if (!found && at > 0) found = pairs_match(bc->pairs, at - 1, &match);
+	if (!found) return;
+
+	_cursors_clear(ctx);
+	buffer_set_cursor(b, match);
+}
+
+// ~geb: the first time selects the innermost pair around the cursor, then
+//       every time the pair around that, brackets included
+internal void
+_cmd_pair_select(Editor_Context *ctx)
+{
+	Q_Buffer *b = ctx->active_buffer;
+	Buffer_Caches *bc = b ? editor_caches(ctx, b) : NULL;
+	if (!bc || !bc->pairs) return;
+
+	Editor_Selection sel = editor_selection(ctx);
+	if (ctx->select_begin == MARK_NONE) sel.begin = sel.end = b->cursor;
+
+	usize open, close;
+	if (!pairs_enclosing(bc->pairs, sel.begin, sel.end, &open, &close)) return;
+
+	_selection_clear(ctx);
+	ctx->select_begin = buffer_mark_add(b, open, Mark_Left);
+	ctx->select_end   = buffer_mark_add(b, close + 1, Mark_Left);
+	if (ctx->select_end == MARK_NONE) _selection_clear(ctx);
+
+	_cursors_clear(ctx);
+	buffer_set_cursor(b, close);
+}
+
 ///////////////////////////////////////////////
+// ~geb: Folds
+
+// ~geb: columns in front of the first thing on `row`, USIZE_MAX when it is blank
+internal usize
+_fold_indent(Q_Buffer *b, usize row, int tab_width)
+{
+	usize col = 0;
+	usize end = buffer_row_end(b, row);
+
+	for (Q_Span_Iterator it = buffer_spans(b, buffer_offset_from_row(b, row), end); buffer_span_next(b, &it);) {
+		for (usize i = 0; i < it.span.len; ++i) {
+			u8 c = it.span.str[i];
+			if      (c == ' ')  col += 1;
+			else if (c == '\t') col += tab_width - (col % tab_width);
+			else                return col;
+		}
+	}
+	return USIZE_MAX;
+}
+
+// ~geb: opens the fold on the cursor's line if there is one. otherwise folds
+//       the lines right below it that are indented deeper, or when there are
+//       none the lines inside the innermost brackets around the cursor
+internal void
+_cmd_fold_toggle(Editor_Context *ctx)
+{
+	Q_Buffer *b = ctx->active_buffer;
+	if (!b) return;
+
+	usize row = buffer_row_from_offset(b, b->cursor);
+	if (buffer_unfold(b, buffer_row_end(b, row))) return;
+
+	usize first = row;
+	usize last  = row;
+
+	usize indent = _fold_indent(b, row, ctx->tab_width);
+	for (usize r = row + 1; indent != USIZE_MAX; ++r) {
+		if (buffer_row_end(b, r - 1) >= buffer_len(b)) break;
+
+		usize depth = _fold_indent(b, r, ctx->tab_width);
+		if (depth == USIZE_MAX) continue;
+		if (depth <= indent)    break;
+		last = r;
+	}
+
+	// ~geb: brackets with no whole line between them are looked past
+	Buffer_Caches *bc = editor_caches(ctx, b);
+	usize open  = b->cursor, close = 0;
+	usize end   = b->cursor;
+	bool  found = last != row;
+	while (!found && bc && bc->pairs && pairs_enclosing(bc->pairs, open, end, &open, &close)) {
+		usize from = buffer_row_from_offset(b, open);
+		usize to   = buffer_row_from_offset(b, close);
+		if (to > from + 1) {
+			first = from;
+			last  = to - 1;
+			found = true;
+		}
+		end = close + 1;
+	}
+
+	if (!buffer_fold(b, first, last)) return;
+
+	// ~geb: no cursor is left where it cannot be seen
+	_cursors_clear(ctx);
+
+	usize hide_begin = 0, hide_end = 0;
+	if (buffer_fold_next(b, buffer_row_end(b, first), &hide_begin, &hide_end) && b->cursor > hide_begin && b->cursor < hide_end)
+		buffer_set_cursor(b, hide_begin);
+}
 
 internal Editor_Context
 editor_context(Allocator alloc, Allocator frame_alloc)
@@ -139,21 +1639,57 @@ editor_context(Allocator alloc, Allocator frame_alloc)
 	editor.alloc = alloc;
 	editor.frame_alloc = frame_alloc;
 	editor.tab_width = 4;
+	editor.save_sync = OS_Sync_Data;
 
 
 	editor.cli_buffer = buffer_make(S(""), S(""), NULL, alloc);
+	editor.cursors    = dynamic_array(alloc, usize, 0);
+
+	editor.search.pattern = dynamic_array(alloc, u8, 0);
+	editor.search.hits    = dynamic_array(alloc, usize, 0);
+	editor.search.match   = USIZE_MAX;
+
+	editor.caches = dynamic_array(alloc, Buffer_Caches, 0);
 	return editor;
 }
 
 internal void
 editor_push_cmd(Editor_Context *ctx, Editor_Cmd cmd)
 {
+	if (cmd.type != Cmd_Pair_Select && cmd.type != Cmd_Scroll)
+		_selection_clear(ctx);
+
 	switch (cmd.type) {
 		case Cmd_Mode_Change:  _cmd_mode_change(ctx, cmd.mode); break;
 		case Cmd_Buffer_Open:  _cmd_buffer_open(ctx, cmd.buffer_open); break;
 		case Cmd_Buffer_Close: _cmd_buffer_close(ctx, cmd.buffer_close); break;
+		case Cmd_Buffer_Save:  _cmd_buffer_save(ctx, cmd.buffer_save); break;
 		case Cmd_Insert_Text:  _cmd_text_insert(ctx, cmd.text_insert); break;
 		case Cmd_Delete_Text:  _cmd_text_delete(ctx, cmd.text_delete); break;
 		case Cmd_Cursor_Move:  _cmd_cursor_move(ctx, cmd.cursor); break;
+		case Cmd_Undo:         _cmd_undo(ctx); break;
+		case Cmd_Redo:         _cmd_redo(ctx); break;
+		case Cmd_Cursor_Add:   _cmd_cursor_add(ctx, cmd.cursor_add); break;
+		case Cmd_Cursor_Clear: _cursors_clear(ctx); break;
+		case Cmd_Search_Begin:  _cmd_prompt_begin(ctx, Prompt_Search); break;
+		case Cmd_Command_Begin: _cmd_prompt_begin(ctx, Prompt_Command); break;
+		case Cmd_Prompt_Accept: _cmd_prompt_end(ctx, true); break;
+		case Cmd_Prompt_Cancel: _cmd_prompt_end(ctx, false); break;
+		case Cmd_Search_All_Begin: _cmd_prompt_begin(ctx, Prompt_Search_All); break;
+		case Cmd_Search_All_Next:  _search_all_next(ctx); break;
+		case Cmd_Find_Select: _cmd_find_select(ctx, cmd.find_select); break;
+		case Cmd_Find_Open:   _cmd_find_open(ctx); break;
+		case Cmd_Find_Toggle: if (ctx->find) ctx->find->showing = !ctx->find->showing; break;
+		case Cmd_Pair_Jump:   _cmd_pair_jump(ctx); break;
+		case Cmd_Pair_Select: _cmd_pair_select(ctx); break;
+		case Cmd_Fold_Toggle: _cmd_fold_toggle(ctx); break;
+		case Cmd_Scroll:      _cmd_scroll(ctx, cmd.scroll); break;
+		case Cmd_View_Split:  _cmd_view_split(ctx); break;
+		case Cmd_View_Close:  _cmd_view_close(ctx); break;
+		case Cmd_View_Next:
+			if (ctx->view_count > 1) _view_focus(ctx, (ctx->view + 1) % ctx->view_count);
+			break;
 	}
+
+	_view_follow(ctx);
 }
@@ -3,6 +3,9 @@
 
 #include "base.h"
 #include "buffer.h"
+#include "syntax.h"
+#include "pairs.h"
+#include "wrap.h"
 
 typedef u32 Editor_Mode;
 enum {
@@ -13,6 +16,198 @@ enum {
 	Mode_Count,
 };
 
+// ~geb: search as you type. `hits` holds the start of every match of
+//       `pattern` in front of `scanned`, gathered a slice of the buffer per
+//       frame. a match of a longer pattern is a match of its prefix too, so
+//       typing one more byte only rechecks the hits instead of the buffer.
+#define SEARCH_SCAN_BUDGET Mb(8) // bytes gathered per frame
+#define SEARCH_MAX_HITS    Mb(1) // past this the hits are dropped
+
+typedef struct {
+	Dynamic_Array pattern; // u8, what `hits` were found for
+	Search_Flags  flags;
+	Dynamic_Array hits;    // usize, sorted
+	usize scanned;
+	bool  overflow;        // too many to keep, visible rows get searched directly
+
+	usize origin;          // cursor when the search began, cancelling goes back to it
+	usize match;           // the match the cursor is on, USIZE_MAX if there is none
+} Editor_Search;
+
+// ~geb: what the text typed into the cli buffer is for
+typedef u32 Prompt_Kind;
+enum {
+	Prompt_Search = 0, // searched for as it is typed
+	Prompt_Command,    // run on enter, `[%]s/pattern/replacement/[gi]` or `grep pattern`
+	Prompt_Search_All, // searched for in every open buffer on enter
+};
+
+// ~geb: a search through every open buffer at once, off the main thread.
+//       each buffer is frozen into a snapshot and cut into jobs the workers
+//       pull off a shared counter. a worker hands its hits back through a
+//       ring of its own that the main thread drains between frames, so the
+//       main thread never waits on a worker and a worker only waits when
+//       its ring is full.
+#define SEARCH_ALL_JOB_BYTES   Mb(4)
+#define SEARCH_ALL_RING        Kb(16) // hits in flight per worker, a power of two
+#define SEARCH_ALL_MAX_WORKERS 16
+
+typedef struct {
+	u32   job;
+	usize at;
+} Search_All_Hit;
+
+typedef struct Search_All Search_All;
+
+typedef struct {
+	OS_Thread   thread;
+	Search_All *owner;
+
+	Search_All_Hit *ring;
+	_Atomic usize head; // pushed by the worker
+	_Atomic usize tail; // drained by the main thread
+	_Atomic bool  done;
+} Search_All_Worker;
+
+typedef struct {
+	Q_Buffer *buffer;   // NULL once the buffer is closed
+	Q_Buffer  snapshot; // released as soon as the workers are done
+} Search_All_Source;
+
+typedef struct {
+	u32   source;
+	usize begin;        // hits start in [begin, end)
+	usize end;
+	Dynamic_Array hits; // usize, sorted, main thread only
+} Search_All_Job;
+
+struct Search_All {
+	Allocator    alloc;
+	String8      pattern;
+	Search_Flags flags;
+
+	Search_All_Source *sources;
+	u32                source_count;
+	Search_All_Job    *jobs;
+	u32                job_count;
+
+	_Atomic u32  next_job;
+	_Atomic bool cancel;
+
+	Search_All_Worker workers[SEARCH_ALL_MAX_WORKERS];
+	u32  worker_count;
+	bool running;         // the workers have not been joined yet
+
+	usize hit_count;
+	bool  overflow;       // stopped at SEARCH_MAX_HITS
+	u32   current_job;    // hit the cursor was last sent to
+	usize current;        // USIZE_MAX before the first one
+};
+
+// ~geb: grep over a directory tree. one thread walks the tree and lists the
+//       files, the workers map them one at a time, skip the ones that look
+//       binary and send every hit back with its line through their rings.
+//       the results view only ever formats the rows that are on screen.
+#define FIND_MAX_FILES  Mb(4)
+#define FIND_RING       Kb(4)  // hits in flight per worker, a power of two
+#define FIND_PREVIEW    96     // bytes of a hit's line that are kept
+#define FIND_SNIFF      Kb(8)  // a NUL in this many leading bytes means binary
+#define FIND_READ_MAX   Kb(64) // files up to this size are read, bigger ones mapped
+
+typedef struct {
+	u32   file;
+	u32   line;   // 0 based
+	usize offset;
+	u8    preview_len;
+	u8    preview[FIND_PREVIEW];
+} Find_Hit;
+
+typedef struct {
+	u32     file;
+	u32     line;
+	usize   offset;
+	String8 preview;
+} Find_Result;
+
+typedef struct Find_In_Files Find_In_Files;
+
+typedef struct {
+	OS_Thread      thread;
+	Find_In_Files *owner;
+
+	Find_Hit     *ring;
+	u8           *scratch; // FIND_READ_MAX bytes the small files are read into
+	_Atomic usize head;
+	_Atomic usize tail;
+	_Atomic bool  done;
+} Find_Worker;
+
+struct Find_In_Files {
+	Allocator     alloc;
+	String8       root;
+	String8       pattern;
+	Buffer_Search search;   // prepared once, shared by the workers
+
+	// ~geb: filled by the walker, a file is published by bumping `file_count`
+	OS_Thread     walker;
+	Allocator     paths;    // arena, the walker's until it is joined
+	String8      *files;    // os_reserve'd, committed as it fills
+	usize         files_committed;
+	_Atomic usize file_count;
+	_Atomic bool  walked;
+
+	_Atomic usize next_file;
+	_Atomic usize files_done;
+	_Atomic bool  cancel;
+
+	Find_Worker workers[SEARCH_ALL_MAX_WORKERS];
+	u32  worker_count;
+	bool running;
+
+	Dynamic_Array results;  // Find_Result
+	Allocator     previews; // arena
+	bool  overflow;         // stopped at SEARCH_MAX_HITS
+
+	bool  showing;
+	usize selected;
+	usize top;              // first row in view
+};
+
+// ~geb: matches on the rows in view, for drawing
+typedef struct {
+	usize *starts; // sorted, may overlap
+	usize  count;
+	usize  len;
+	usize  current;
+} Search_Highlights;
+
+// ~geb: what is kept up to date on the side of one open buffer
+typedef struct {
+	Q_Buffer     *buffer;
+	Syntax_Cache *syntax; // NULL when the language is not known
+	Pair_Index   *pairs;
+	Wrap_Layout  *wrap;   // only while lines are wrapped
+} Buffer_Caches;
+
+// ~geb: begin == end when nothing is selected
+typedef struct {
+	usize begin;
+	usize end;
+} Editor_Selection;
+
+// ~geb: a pane onto a buffer, side by side with the others. its cursor and
+//       the top of what it shows are marks, so edits made in another pane
+//       carry them along. only the focused pane's cursor is the buffer's
+//       own, the cursor being where edits go, so the gap only ever moves
+//       for the pane being typed in however many show the same buffer
+#define EDITOR_MAX_VIEWS 4
+
+typedef struct {
+	Q_Buffer *buffer;
+	Mark cursor; // behind while focused, the buffer's cursor stands in for it
+	Mark top;    // start of the first row in view
+} Editor_View;
+
 typedef struct {
 	Editor_Mode mode;
 
@@ -20,11 +215,38 @@ typedef struct {
 	Allocator frame_alloc;
 
 	int tab_width;
+	OS_Sync_Policy save_sync;
 
 	Q_Buffer *active_buffer;
 	Q_Buffer *buffer_list;
 
-	Q_Buffer *cli_buffer;
+	Q_Buffer   *cli_buffer;
+	Prompt_Kind prompt;
+	Editor_Mode prompt_return; // mode to go back to once the prompt is closed
+
+	// ~geb: every cursor in the active buffer, sorted, once there is more
+	//       than one. the buffer's own cursor is the primary among them
+	Dynamic_Array cursors; // usize
+
+	Editor_Search search;
+	Search_All   *search_all; // the last search through every buffer, NULL if none
+	Find_In_Files *find;      // the last `:grep`, NULL if none
+
+	Dynamic_Array caches;     // Buffer_Caches, one per buffer
+
+	bool  wrap;      // long lines go on in the next display row
+	usize wrap_cols; // cells in a display row, as of the last resize
+
+	// ~geb: grown one pair of brackets at a time, marks in the active buffer.
+	//       any other command drops it
+	Mark select_begin;
+	Mark select_end;
+
+	// ~geb: the focused view is on the active buffer, commands that change
+	//       the active buffer take it along
+	Editor_View views[EDITOR_MAX_VIEWS];
+	u32 view_count;
+	u32 view;        // focused
 } Editor_Context;
 
 typedef u32 Editor_Cmd_Type;
@@ -32,11 +254,39 @@ enum {
 	Cmd_Mode_Change,
 	Cmd_Buffer_Open,
 	Cmd_Buffer_Close,
+	Cmd_Buffer_Save,
 
 	Cmd_Insert_Text,
 	Cmd_Delete_Text,
 	Cmd_Cursor_Move,
 	Cmd_Scroll,
+
+	Cmd_Undo,
+	Cmd_Redo,
+
+	Cmd_Cursor_Add,
+	Cmd_Cursor_Clear,
+
+	Cmd_Search_Begin,
+	Cmd_Command_Begin,
+	Cmd_Prompt_Accept,
+	Cmd_Prompt_Cancel,
+
+	Cmd_Search_All_Begin,
+	Cmd_Search_All_Next,
+
+	Cmd_Find_Select,
+	Cmd_Find_Open,
+	Cmd_Find_Toggle,
+
+	Cmd_Pair_Jump,
+	Cmd_Pair_Select,
+
+	Cmd_Fold_Toggle,
+
+	Cmd_View_Split,
+	Cmd_View_Close,
+	Cmd_View_Next,
 };
 
 typedef struct {
@@ -52,6 +302,11 @@ typedef struct {
 	Q_Buffer *buffer;
 } Buffer_Close;
 
+typedef struct {
+	Q_Buffer *buffer;
+	String8 path; // empty saves to the buffer name
+} Buffer_Save;
+
 typedef struct {
     String8 text;
 } Text_Insert;
@@ -61,9 +316,30 @@ typedef struct {
     int dy;
 } Cursor_Move;
 
+typedef struct {
+	isize rows; // the new cursor goes this many lines from the primary one
+} Cursor_Add;
+
+typedef struct {
+	isize rows; // from the selected result
+} Find_Select;
+
+typedef struct {
+	isize rows; // the focused view's top goes this many display rows down
+} Scroll;
+
+typedef u32 Text_Delete_Unit;
+enum {
+	Delete_Codepoints = 0, // `amount` codepoints from the cursor
+	Delete_Bytes,          // `amount` bytes from the cursor
+	Delete_Range,          // the byte range [begin, end)
+};
+
 typedef struct {
     int amount;
-	bool move;
+	bool move; // delete backwards from the cursor and move with it
+	Text_Delete_Unit unit;
+	usize begin, end;
 } Text_Delete;
 
 typedef struct {
@@ -73,13 +349,42 @@ typedef struct {
 		Mode_Change  mode;
 		Buffer_New   buffer_open;
 		Buffer_Close buffer_close;
+		Buffer_Save  buffer_save;
 		Text_Insert  text_insert;
 		Text_Delete  text_delete;
 		Cursor_Move  cursor;
+		Cursor_Add   cursor_add;
+		Find_Select  find_select;
+		Scroll       scroll;
 	};
 } Editor_Cmd;
 
 internal Editor_Context editor_context(Allocator alloc, Allocator frame_alloc);
 internal void editor_push_cmd(Editor_Context *ctx, Editor_Cmd cmd);
 
+// ~geb: gathers the next slice of search hits, call once a frame
+internal void editor_search_pump(Editor_Context *ctx);
+internal Search_Highlights editor_search_visible(Editor_Search *search, Q_Buffer *buf, usize first_row, usize rows, usize row_bytes, Allocator alloc);
+
+// ~geb: takes in the hits the workers found since, call once a frame
+internal void    editor_search_all_pump(Editor_Context *ctx);
+internal String8 editor_search_all_status(Editor_Context *ctx, Allocator alloc);
+
+// ~geb: NULL when the buffer is not open
+internal Buffer_Caches   *editor_caches(Editor_Context *ctx, Q_Buffer *buf);
+internal void             editor_caches_pump(Editor_Context *ctx);
+internal Editor_Selection editor_selection(Editor_Context *ctx);
+
+// ~geb: NULL when lines are not wrapped
+internal Wrap_Layout *editor_wrap(Editor_Context *ctx, Q_Buffer *buf);
+internal void         editor_wrap_resize(Editor_Context *ctx, usize cols);
+
+// ~geb: the cursor is the buffer's own for the focused view
+internal usize editor_view_cursor(Editor_Context *ctx, u32 view);
+internal usize editor_view_top_row(Editor_Context *ctx, u32 view);
+
+internal void    editor_find_pump(Editor_Context *ctx);
+internal String8 editor_find_row(Find_In_Files *find, usize row, Allocator alloc);
+internal String8 editor_find_status(Find_In_Files *find, Allocator alloc);
+
 #endif
@@ -131,6 +131,7 @@ _resize_proc(Window_Handle window, i32 w, i32 h)
 	glUniformMatrix4fv(g_ctx->quad_uniforms[Uniform_Proj], 1, false, proj);
 	g_ctx->resolution.x = w;
 	g_ctx->resolution.y = h;
+	g_ctx->resizes++;
 }
 
 internal void
@@ -331,6 +332,8 @@ gfx_delta_time() {
 internal Rect
 gfx_get_clip_rect()
 {
+	if (g_ctx->clipped) return g_ctx->clip;
+
 	Rect r = {
 		{0, 0},
 		{(f32)g_ctx->resolution.x, (f32)g_ctx->resolution.y}
@@ -338,6 +341,48 @@ gfx_get_clip_rect()
 	return r;
 }
 
+// ~geb: what was pushed so far is drawn under the old rect first
+internal void
+gfx_set_clip_rect(Rect rect)
+{
+	if (g_ctx->render_batch.index_count > 0) {
+		_flush_batch();
+		_prepare_batch(g_ctx->active_texture);
+	}
+
+	// ~geb: the scissor box counts up from the bottom of the window
+	i32 x = cast(i32) rect.from.x;
+	i32 y = cast(i32) rect.from.y;
+	i32 w = cast(i32) (rect.to.x - rect.from.x);
+	i32 h = cast(i32) (rect.to.y - rect.from.y);
+
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(x, g_ctx->resolution.y - (y + h), Max(w, 0), Max(h, 0));
+
+	g_ctx->clip    = rect;
+	g_ctx->clipped = true;
+}
+
+internal void
+gfx_reset_clip_rect()
+{
+	if (!g_ctx->clipped) return;
+
+	if (g_ctx->render_batch.index_count > 0) {
+		_flush_batch();
+		_prepare_batch(g_ctx->active_texture);
+	}
+
+	glDisable(GL_SCISSOR_TEST);
+	g_ctx->clipped = false;
+}
+
+internal u32
+gfx_resizes()
+{
+	return g_ctx->resizes;
+}
+
 internal Frame_Input
 gfx_frame_begin(color8_t col)
 {
@@ -365,6 +410,32 @@ gfx_frame_begin(color8_t col)
 				MaskSet( input_data.special_key_presses, event.key.value == RGFW_up, Pressed_Move_Up);
 				MaskSet( input_data.special_key_presses, event.key.value == RGFW_down, Pressed_Move_Down);
 
+				MaskSet( input_data.special_key_presses, event.key.value == RGFW_escape, Pressed_Escape);
+				MaskSet( input_data.special_key_presses, event.key.value == RGFW_F3, Pressed_Search_Next);
+				MaskSet( input_data.special_key_presses, event.key.value == RGFW_F4, Pressed_Find_Toggle);
+
+				if ((event.key.mod & RGFW_modControl) && (event.key.mod & RGFW_modAlt)) {
+					if (event.key.value == RGFW_up || event.key.value == RGFW_down) {
+						input_data.special_key_presses &= ~(Pressed_Move_Up | Pressed_Move_Down);
+						MaskSet( input_data.special_key_presses, event.key.value == RGFW_up, Pressed_Cursor_Add_Up);
+						MaskSet( input_data.special_key_presses, event.key.value == RGFW_down, Pressed_Cursor_Add_Down);
+					}
+				}
+
+				if (event.key.mod & RGFW_modControl) {
+					bool shift = (event.key.mod & RGFW_modShift) != 0;
+					MaskSet( input_data.special_key_presses, event.key.value == RGFW_z && !shift, Pressed_Undo);
+					MaskSet( input_data.special_key_presses, event.key.value == RGFW_y || (event.key.value == RGFW_z && shift), Pressed_Redo);
+					MaskSet( input_data.special_key_presses, event.key.value == RGFW_f && !shift, Pressed_Search);
+					MaskSet( input_data.special_key_presses, event.key.value == RGFW_f && shift, Pressed_Search_All);
+					MaskSet( input_data.special_key_presses, event.key.value == RGFW_h, Pressed_Command);
+					MaskSet( input_data.special_key_presses, event.key.value == RGFW_m && !shift, Pressed_Pair_Jump);
+					MaskSet( input_data.special_key_presses, event.key.value == RGFW_m && shift, Pressed_Pair_Select);
+					MaskSet( input_data.special_key_presses, event.key.value == RGFW_k, Pressed_Fold_Toggle);
+					MaskSet( input_data.special_key_presses, event.key.value == RGFW_w, Pressed_View_Next);
+					MaskSet( input_data.special_key_presses, event.key.value == RGFW_s, Pressed_Save);
+				}
+
 				if (RGFW_isKeyDown(RGFW_space)) {
 					u8 *str = alloc_array_nz(g_ctx->temp_allocator, u8, 1, NULL);
 					input_data.text = str8(str, 1);
@@ -394,6 +465,10 @@ gfx_frame_begin(color8_t col)
 	glBindBuffer(GL_ARRAY_BUFFER, g_ctx->batch_vbo);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_ctx->batch_ebo);
 
+	// ~geb: the clear would be cut to the last frame's clip rect otherwise
+	glDisable(GL_SCISSOR_TEST);
+	g_ctx->clipped = false;
+
 	glClearColor(color_r(col)/255.0, color_g(col)/255.0, color_b(col)/255.0, color_a(col)/255.0);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -128,6 +128,9 @@ typedef struct {
 	u32 batch_ebo;
 
 	ivec2         resolution;
+	u32           resizes; // bumped on every resize, for whatever is laid out to the window
+	Rect          clip;    // drawing is cut to this while `clipped`, the whole window otherwise
+	bool          clipped;
 	f64           frame_delta;
 	OS_Time_Stamp last_frame_time;
 	Render_Flags  render_flags;
@@ -142,6 +145,23 @@ enum {
 	Pressed_Move_Right = Bit(4),
 	Pressed_Move_Up    = Bit(5),
 	Pressed_Move_Down  = Bit(6),
+
+	Pressed_Undo       = Bit(7),
+	Pressed_Redo       = Bit(8),
+
+	Pressed_Escape     = Bit(9),
+	Pressed_Cursor_Add_Up   = Bit(10),
+	Pressed_Cursor_Add_Down = Bit(11),
+	Pressed_Search          = Bit(12),
+	Pressed_Command         = Bit(13),
+	Pressed_Search_All      = Bit(14),
+	Pressed_Search_Next     = Bit(15),
+	Pressed_Find_Toggle     = Bit(16),
+	Pressed_Pair_Jump       = Bit(17),
+	Pressed_Pair_Select     = Bit(18),
+	Pressed_Fold_Toggle     = Bit(19),
+	Pressed_View_Next       = Bit(20),
+	Pressed_Save            = Bit(21),
 };
 
 typedef struct {
@@ -159,6 +179,9 @@ internal bool         gfx_window_open();
 internal void         gfx_mouse_position(f32 *x, f32 *y);
 internal f64          gfx_delta_time();
 internal Rect         gfx_get_clip_rect();
+internal void         gfx_set_clip_rect(Rect rect);
+internal void         gfx_reset_clip_rect();
+internal u32          gfx_resizes();
 
 ///////////////////////
 // ~geb: Rendering API
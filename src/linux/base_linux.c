@@ -99,6 +99,56 @@ os_sleep_ns(u64 ns)
 	while (nanosleep(&ts, &ts) == -1 && errno == EINTR);
 }
 
+///////////////////////
+// ~geb: threads
+
+typedef struct {
+	OS_Thread_Proc *proc;
+	void           *data;
+} OS_Linx_Thread_Start;
+
+internal void *
+os_linx_thread_entry(void *param)
+{
+	OS_Linx_Thread_Start start = *(OS_Linx_Thread_Start *)param;
+	free(param);
+
+	start.proc(start.data);
+	return NULL;
+}
+
+internal OS_Thread
+os_thread_start(OS_Thread_Proc *proc, void *data)
+{
+	OS_Linx_Thread_Start *start = malloc(sizeof(*start));
+	if (!start) return (OS_Thread){0};
+
+	start->proc = proc;
+	start->data = data;
+
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, os_linx_thread_entry, start) != 0) {
+		free(start);
+		return (OS_Thread){0};
+	}
+
+	return (OS_Thread){ .handle = (u64)thread };
+}
+
+internal void
+os_thread_join(OS_Thread thread)
+{
+	if (!thread.handle) return;
+	pthread_join((pthread_t)thread.handle, NULL);
+}
+
+internal u32
+os_core_count(void)
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? cast(u32) n : 1;
+}
+
 
 internal OS_Handle
 os_file_open(OS_AccessFlags flags, String8 path)
@@ -185,6 +235,152 @@ os_file_write(OS_Handle file, usize begin, usize end, void *data)
 	return total;
 }
 
+// ~geb: writes the spans back to back from the current file position,
+//       as few writev calls as the kernel allows
+internal usize
+os_file_write_spans(OS_Handle file, String8 *spans, usize count)
+{
+	if (file < 0)
+		return 0;
+
+	struct iovec iov[64];
+	usize total = 0;
+
+	while (count)
+	{
+		int n = 0;
+		for (; n < (int)count && n < (int)ArrayCount(iov); ++n)
+		{
+			iov[n].iov_base = spans[n].str;
+			iov[n].iov_len  = spans[n].len;
+		}
+
+		int first = 0;
+		while (first < n)
+		{
+			ssize_t w = writev((int)file, iov + first, n - first);
+			if (w < 0)
+			{
+				if (errno == EINTR) continue;
+				return total;
+			}
+			if (w == 0) return total;
+
+			total += (usize)w;
+
+			usize left = (usize)w;
+			while (first < n && left >= iov[first].iov_len)
+				left -= iov[first++].iov_len;
+
+			if (first < n)
+			{
+				iov[first].iov_base = (u8 *)iov[first].iov_base + left;
+				iov[first].iov_len -= left;
+			}
+		}
+
+		spans += n;
+		count -= (usize)n;
+	}
+
+	return total;
+}
+
+internal bool
+os_file_sync(OS_Handle file, OS_Sync_Policy sync)
+{
+	if (file < 0)
+		return false;
+
+	switch (sync)
+	{
+		case OS_Sync_None: return true;
+		case OS_Sync_Data: return fdatasync((int)file) == 0;
+		default:           return fsync((int)file) == 0;
+	}
+}
+
+// ~geb: writes the spans to a temp file next to the file `path` names and
+//       renames it over that file, so the target is never seen half written.
+//       Existing mappings of the old file stay valid since they keep the old
+//       inode alive.
+internal bool
+os_replace_path(String8 path, String8 *spans, usize count, OS_Sync_Policy sync)
+{
+	// ~geb: the temp file gets a name of its own, nothing of the user's is
+	//       ever written over and two saves of one file never meet
+	const char suffix[] = ".quark-save-XXXXXX";
+
+	char cpath[PATH_LEN_MAX];
+	char ctemp[PATH_LEN_MAX];
+	if (path.len == 0 || path.len >= sizeof(cpath))
+		return false;
+
+	MemMove(cpath, path.str, path.len);
+	cpath[path.len] = 0;
+
+	// ~geb: a symlink is saved through, the file it points at gets replaced
+	//       in its own directory and the link is left as it was. a path that
+	//       does not exist yet is made as it is
+	char *real = realpath(cpath, NULL);
+	if (real) {
+		usize len = MemStrlen(real);
+		if (len >= sizeof(cpath)) { free(real); return false; }
+		MemMove(cpath, real, len + 1);
+		free(real);
+	}
+
+	usize len = MemStrlen(cpath);
+	if (len + sizeof(suffix) > sizeof(ctemp))
+		return false;
+
+	MemMove(ctemp, cpath, len);
+	MemMove(ctemp + len, suffix, sizeof(suffix));
+
+	mode_t mode = 0644;
+	struct stat st;
+	if (stat(cpath, &st) == 0)
+		mode = st.st_mode & 07777;
+
+	int fd = mkostemp(ctemp, O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	usize expected = 0;
+	for (usize i = 0; i < count; ++i)
+		expected += spans[i].len;
+
+	bool ok = fchmod(fd, mode) == 0;
+	ok = ok && os_file_write_spans((OS_Handle)fd, spans, count) == expected;
+	ok = ok && os_file_sync((OS_Handle)fd, sync);
+	ok = (close(fd) == 0) && ok;
+	ok = ok && rename(ctemp, cpath) == 0;
+
+	if (!ok)
+	{
+		unlink(ctemp);
+		return false;
+	}
+
+	if (sync == OS_Sync_Full)
+	{
+		// ~geb: flush the directory entry too so the rename survives a crash
+		isize slash = find_right(str8((u8 *)cpath, len), '/');
+		char *dir = ".";
+		if (slash == 0)       dir = "/";
+		else if (slash > 0) { cpath[slash] = 0; dir = cpath; }
+
+		int dfd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (dfd >= 0)
+		{
+			fsync(dfd);
+			close(dfd);
+		}
+	}
+
+	return true;
+}
+
 internal OS_FileProps
 os_properties_from_file(OS_Handle file)
 {
@@ -198,6 +394,24 @@ os_properties_from_file(OS_Handle file)
 	return os_linx_file_props_from_stats(&st);
 }
 
+// ~geb: read-only private mapping, it stays valid after the handle is closed
+internal void *
+os_file_map(OS_Handle file, usize size)
+{
+	if (file < 0 || size == 0)
+		return 0;
+
+	void *p = mmap(0, size, PROT_READ, MAP_PRIVATE, (int)file, 0);
+	return (p == MAP_FAILED) ? 0 : p;
+}
+
+internal void
+os_file_unmap(void *ptr, usize size)
+{
+	if (ptr && size)
+		munmap(ptr, size);
+}
+
 
 internal bool
 os_path_exists(String8 path)
@@ -218,3 +432,77 @@ os_path_exists(String8 path)
 
     return (result == 0);
 }
+
+///////////////////////
+// ~geb: directories
+
+// ~geb: the record getdents64 fills `batch` with, back to back
+typedef struct {
+	u64  ino;
+	i64  off;
+	u16  reclen;
+	u8   type;
+	char name[];
+} OS_Linx_Dirent64;
+
+internal bool
+os_dir_open(String8 path, OS_Dir_Iter *it)
+{
+	char cpath[PATH_LEN_MAX];
+	if (path.len + 1 > sizeof(cpath))
+		return false;
+	MemMove(cpath, path.str, path.len);
+	cpath[path.len] = 0;
+
+	it->dir    = (OS_Handle)open(cpath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	it->at     = 0;
+	it->filled = 0;
+	return it->dir >= 0;
+}
+
+internal bool
+os_dir_next(OS_Dir_Iter *it, OS_Dir_Entry *entry)
+{
+	for (;;) {
+		if (it->at == it->filled) {
+			long n = syscall(SYS_getdents64, (int)it->dir, it->batch, sizeof(it->batch));
+			if (n <= 0) return false;
+
+			it->at     = 0;
+			it->filled = (usize)n;
+		}
+
+		OS_Linx_Dirent64 *d = (OS_Linx_Dirent64 *)(it->batch + it->at);
+		it->at += d->reclen;
+
+		usize len = mem_find_byte((u8 *)d->name, d->reclen, 0);
+		if (d->name[0] == '.' && (len == 1 || (len == 2 && d->name[1] == '.')))
+			continue;
+
+		u8 type = d->type;
+		if (type == DT_UNKNOWN) {
+			// ~geb: some file systems leave the kind out, ask for it
+			struct stat st;
+			if (fstatat((int)it->dir, d->name, &st, AT_SYMLINK_NOFOLLOW) != 0) continue;
+
+			type = S_ISDIR(st.st_mode) ? DT_DIR
+				: S_ISLNK(st.st_mode) ? DT_LNK
+				: S_ISREG(st.st_mode) ? DT_REG : DT_FIFO;
+		}
+
+		entry->name  = str8((u8 *)d->name, len);
+		entry->flags = 0;
+		MaskSet(entry->flags, type == DT_DIR, OS_FileFlag_Directory);
+		MaskSet(entry->flags, type == DT_LNK, OS_FileFlag_Symlink);
+		MaskSet(entry->flags, type != DT_DIR && type != DT_LNK && type != DT_REG, OS_FileFlag_Special);
+		return true;
+	}
+}
+
+internal void
+os_dir_close(OS_Dir_Iter *it)
+{
+	if (it->dir >= 0)
+		close((int)it->dir);
+	it->dir = -1;
+}
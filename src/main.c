@@ -3,6 +3,9 @@
 #include "draw.h"
 #include "glyph_cache.h"
 #include "buffer.h"
+#include "syntax.h"
+#include "pairs.h"
+#include "wrap.h"
 #include "editor.h"
 
 #include "base.c"
@@ -10,6 +13,9 @@
 #include "draw.c"
 #include "glyph_cache.c"
 #include "buffer.c"
+#include "syntax.c"
+#include "pairs.c"
+#include "wrap.c"
 #include "editor.c"
 
 #include "embed_data.h"
@@ -105,29 +111,143 @@ smooth_damp(f32 current, f32 target, f32 time, f32 dt)
 	return Lerp(current, target, factor);
 }
 
+// ~geb: draws one view into the clip rect, `y_level` is how far its top is
+//       scrolled. `cursor` is the view's own, `caret` where its cursor was
+//       drawn last frame. only the focused view gets the search, the extra
+//       cursors and the selection
 internal void
-editor_render(Q_Buffer *buf, Allocator scratch, Glyph_Cache *cache, f32 y_level)
+editor_render(Q_Buffer *buf, usize cursor, usize *cursors, usize cursor_count, Editor_Search *search, Buffer_Caches *caches, Editor_Selection selection, String8 *status, bool focused, vec2 *caret, Allocator scratch, Glyph_Cache *cache, f32 y_level)
 {
-	f32 pen_x = 10.0f;
-	f32 pen_y = -y_level;
-
 	f32 cell_w = (f32)cache->tile_width;
 	f32 cell_h = (f32)cache->tile_height;
 
 	Rect screen_rect = gfx_get_clip_rect();
 
+	Wrap_Layout *wrap = caches ? caches->wrap : NULL;
+
+	// ~geb: start at the first row that reaches into the clip rect. rows
+	//       are display rows while wrapping, otherwise the lines left in
+	//       view by the folds. folds are shown open while wrapping
+	usize first_row = 0;
+	if (y_level > 0)
+		first_row = cast(usize) (y_level / cell_h);
+
+	// ~geb: clamp through the offset so only the rows up to the screen get indexed
+	usize start      = 0;
+	usize first_line = 0;
+	usize first_cell = 0; // where the first glyph sits in its line
+	if (wrap) {
+		start      = wrap_offset_from_row(wrap, first_row, &first_cell);
+		first_row  = Min(first_row, wrap_row_from_offset(wrap, start));
+		first_line = buffer_row_from_offset(buf, start);
+	} else {
+		first_line = buffer_row_from_visible(buf, first_row);
+		first_line = Min(first_line, buffer_row_from_offset(buf, buffer_offset_from_row(buf, first_line)));
+		first_row  = Min(first_row, buffer_visible_row(buf, first_line));
+		start      = buffer_offset_from_row(buf, first_line);
+	}
+
+	f32 left  = screen_rect.from.x + 10.0f;
+	f32 pen_x = left;
+	f32 pen_y = screen_rect.from.y - y_level + cast(f32) first_row * cell_h;
+
 	vec2 cursor_target = { pen_x, pen_y };
 	bool cursor_found = false;
 	rune cursor_cp = 0;
+	usize next_cursor = 0;
+
+	Q_Iterator itr = {
+		.offset     = start,
+		.position   = { .row = first_line },
+		.skip_folds = !wrap,
+	};
+
+	// ~geb: wrapped, a glyph goes wherever its cell in the line falls
+	usize cell   = first_cell;
+	f32   line_y = wrap ? pen_y - cast(f32) (first_cell / wrap->cols) * cell_h : pen_y;
+
+	// ~geb: only the rows in view get searched, and each only as far as the
+	//       screen is wide, however big the buffer is
+	usize rows = cast(usize) ((screen_rect.to.y - screen_rect.from.y) / cell_h) + 2;
+	usize cols = cast(usize) ((screen_rect.to.x - screen_rect.from.x) / cell_w) + 1;
+
+	usize row_bytes = wrap ? (first_cell + rows * cols) * 4 : cols * 4;
+
+	Search_Highlights hl = {0};
+	usize next_hit = 0;
+	if (search)
+		hl = editor_search_visible(search, buf, first_line, rows, row_bytes, scratch);
+
+	internal color8_t token_color[Token_Count] = {
+		[Token_Text]    = 0x131313ff,
+		[Token_Keyword] = 0x6e2a14ff,
+		[Token_Type]    = 0x1d4b5cff,
+		[Token_Number]  = 0x5a3a8aff,
+		[Token_String]  = 0x2e5a1cff,
+		[Token_Comment] = 0x54483aff,
+		[Token_Preproc] = 0x7d3356ff,
+	};
+
+	Syntax_Cache *syntax = caches ? caches->syntax : NULL;
+	Pair_Index   *pairs  = caches ? caches->pairs : NULL;
 
-	Q_Iterator itr = {0};
+	Syntax_Highlights sh = syntax_visible(syntax, first_line, rows, row_bytes, scratch);
+	usize next_span = 0;
 
+	// ~geb: brackets take the color of how deep they sit
+	internal color8_t bracket_color[] = { 0x6e2a14ff, 0x1d4b5cff, 0x5a3a8aff, 0x2e5a1cff };
+	isize depth = pairs ? pairs_depth(pairs, itr.offset) : 0;
+
+	usize next = itr.offset; // where the step below starts from
 	while (buffer_iter(buf, &itr)) {
 		rune c = itr.codepoint;
 
+		// ~geb: the view's cursor is not the buffer's unless it is focused,
+		//       a step over a fold stands in for everything it hid
+		usize at        = itr.folded ? itr.fold_end : next;
+		bool  on_cursor = at == cursor || (itr.folded && next <= cursor && cursor < at);
+		next = itr.offset;
+
+		if (wrap) {
+			pen_x = left + cast(f32) (cell % wrap->cols) * cell_w;
+			pen_y = line_y + cast(f32) (cell / wrap->cols) * cell_h;
+			cell += c == '\t' ? 4 : 1;
+		}
+
 		if (pen_y > screen_rect.to.y)
 			break;
 
+		// ~geb: rest of the row is past the right edge, jump to its newline
+		if (!wrap && pen_x > screen_rect.to.x && c != '\n') {
+			usize row_end = buffer_row_end(buf, itr.position.row);
+
+			if (at <= cursor && cursor < row_end) {
+				cursor_target = (vec2){ pen_x, pen_y };
+				cursor_found  = true;
+			}
+
+			itr.offset = next = row_end;
+			if (pairs) depth = pairs_depth(pairs, row_end);
+			continue;
+		}
+
+		// ~geb: a collapsed fold was stepped over, it is marked at the end of its
+		//       line and the highlights pick up again behind it
+		if (itr.folded) {
+			if (pen_x <= screen_rect.to.x)
+				push_glyph(cache, 0x2026, (vec2){ pen_x, pen_y }, (vec2){ cell_w, cell_h }, 0x99856aff);
+			pen_x += cell_w * 2.0f;
+
+			usize line = buffer_row_from_offset(buf, itr.fold_end);
+			sh = syntax_visible(syntax, line, rows, row_bytes, scratch);
+			next_span = 0;
+			if (search) {
+				hl = editor_search_visible(search, buf, line, rows, row_bytes, scratch);
+				next_hit = 0;
+			}
+			if (pairs) depth = pairs_depth(pairs, itr.fold_end);
+		}
+
 		vec2 pos  = { pen_x, pen_y };
 		vec2 size = { cell_w, cell_h };
 
@@ -135,15 +255,36 @@ editor_render(Q_Buffer *buf, Allocator scratch, Glyph_Cache *cache, f32 y_level)
 			!(pen_y + cell_h < screen_rect.from.y ||
 			pen_y > screen_rect.to.y);
 
-		if (itr.is_on_cursor) {
+		// ~geb: secondary cursors are thin bars, only the primary one animates
+		while (next_cursor < cursor_count && cursors[next_cursor] < itr.offset)
+			next_cursor++;
+		if (visible && next_cursor < cursor_count && cursors[next_cursor] == itr.offset && !on_cursor)
+			draw_quad(pos, (vec2){ 2.0f, cell_h }, 0x131313ff);
+
+		while (next_hit < hl.count && hl.starts[next_hit] + hl.len <= itr.offset)
+			next_hit++;
+		if (visible && c != '\n' && next_hit < hl.count && hl.starts[next_hit] <= itr.offset) {
+			bool current = hl.current <= itr.offset && itr.offset < hl.current + hl.len;
+			f32  width   = c == '\t' ? cell_w * 4.0f : cell_w;
+			draw_quad(pos, (vec2){ width, cell_h }, current ? 0xd9c79dff : 0xb8a27eff);
+		}
+
+		if (visible && c != '\n' && selection.begin <= itr.offset && itr.offset < selection.end) {
+			f32 width = c == '\t' ? cell_w * 4.0f : cell_w;
+			draw_quad(pos, (vec2){ width, cell_h }, 0xc9c2a8ff);
+		}
+
+		if (on_cursor) {
 			cursor_target = pos;
 			cursor_cp     = c;
 			cursor_found  = true;
 		}
 
 		if (c == '\n') {
-			pen_x = 10.0;
+			pen_x  = left;
 			pen_y += cell_h;
+			line_y = pen_y;
+			cell   = 0;
 			continue;
 		}
 
@@ -157,34 +298,57 @@ editor_render(Q_Buffer *buf, Allocator scratch, Glyph_Cache *cache, f32 y_level)
 			continue;
 		}
 
+		i32 effect = c < 0x80 ? pairs_effect(cast(u8) c, Pair_Any) : 0;
+		if (effect < 0) depth--;
+
 		if (visible) {
-			push_glyph(cache, c, pos, size, 0x131313ff);
+			while (next_span < sh.count && sh.spans[next_span].end <= itr.offset)
+				next_span++;
+
+			Token_Kind kind = Token_Text;
+			if (next_span < sh.count && sh.spans[next_span].begin <= itr.offset)
+				kind = sh.spans[next_span].kind;
+
+			color8_t color = token_color[kind];
+			if (pairs && effect && kind == Token_Text) {
+				isize shades = cast(isize) ArrayCount(bracket_color);
+				color = bracket_color[(depth % shades + shades) % shades];
+			}
+
+			push_glyph(cache, c, pos, size, color);
 		}
 
+		if (effect > 0) depth++;
+
 		pen_x += cell_w;
 	}
 
 	if (!cursor_found) {
-		cursor_target = (vec2){ pen_x, pen_y };
+		usize cursor_row = wrap
+			? wrap_row_from_offset(wrap, cursor)
+			: buffer_visible_row(buf, buffer_row_from_offset(buf, cursor));
+		if (cursor_row < first_row)
+			cursor_target = (vec2){ left, screen_rect.from.y - y_level + cast(f32) cursor_row * cell_h };
+		else
+			cursor_target = (vec2){ pen_x, pen_y };
 	}
 
-	static vec2 cursor_visual = {0};
-	static bool initialized = false;
-
-	if (!initialized) {
+	// ~geb: no cursor is ever drawn at the corner of the window, so a caret
+	//       still there was never placed
+	vec2 cursor_visual = *caret;
+	if (cursor_visual.x == 0 && cursor_visual.y == 0)
 		cursor_visual = cursor_target;
-		initialized = true;
-	}
 
 	f32 dt = cast(f32) gfx_delta_time();
 	f32 smooth_time = 0.04f;
 
 	cursor_visual.x = smooth_damp(cursor_visual.x, cursor_target.x, smooth_time, dt);
 	cursor_visual.y = smooth_damp(cursor_visual.y, cursor_target.y, smooth_time, dt);
+	*caret = cursor_visual;
 
 	draw_cursor(cursor_visual,
 			 (vec2){ cell_w, cell_h },
-			 0x131313ff,
+			 focused ? 0x131313ff : 0x54483aff,
 			 WHITE_TEXTURE);
 
 
@@ -208,17 +372,85 @@ editor_render(Q_Buffer *buf, Allocator scratch, Glyph_Cache *cache, f32 y_level)
 		quad_pos, quad_size, 0x99856aff, 4,
 		(Box_Alignment) {AlignH_Right, AlignV_Center}, cache
 	);
+
+	f32 progress = buffer_load_progress(buf);
+	if (progress < 1.0f) {
+		draw_string_aligned(
+			str8_tprintf(scratch, "indexing %d%%", cast(int) (progress * 100.0f)),
+			quad_pos, quad_size, 0x99856aff, 4,
+			(Box_Alignment) {AlignH_Center, AlignV_Center}, cache
+		);
+	}
+	if (search) {
+		String8 prompt = str8_tprintf(scratch, " /" STR, s_fmt(str8(cast(u8 *) search->pattern.data, search->pattern.len)));
+		if (search->pattern.len && !search->overflow && search->scanned >= buffer_len(buf))
+			prompt = str8_tprintf(scratch, STR "  [%zu]", s_fmt(prompt), search->hits.len);
+
+		draw_string_aligned(
+			prompt,
+			quad_pos, quad_size, 0x99856aff, 4,
+			(Box_Alignment) {AlignH_Left, AlignV_Center}, cache
+		);
+	} else if (status) {
+		draw_string_aligned(
+			*status,
+			quad_pos, quad_size, 0x99856aff, 4,
+			(Box_Alignment) {AlignH_Left, AlignV_Center}, cache
+		);
+	} else {
+		draw_string_aligned(
+			str8_tprintf(scratch, " -- " STR " --" , mode_string[Mode_Normal]),
+			quad_pos, quad_size, 0x99856aff, 4,
+			(Box_Alignment) {AlignH_Left, AlignV_Center}, cache
+		);
+	}
+
+}
+
+
+// ~geb: only the rows on screen get formatted, however many results there are
+internal void
+find_render(Find_In_Files *ff, Allocator scratch, Glyph_Cache *cache)
+{
+	f32 cell_h = (f32)cache->tile_height;
+	Rect screen_rect = gfx_get_clip_rect();
+	f32 width = screen_rect.to.x - screen_rect.from.x;
+
+	usize rows = cast(usize) ((screen_rect.to.y - screen_rect.from.y) / cell_h);
+	rows = rows > 1 ? rows - 1 : 1;
+
+	if (ff->selected < ff->top)         ff->top = ff->selected;
+	if (ff->selected >= ff->top + rows) ff->top = ff->selected - rows + 1;
+
+	for (usize r = ff->top; r < ff->top + rows && r < ff->results.len; ++r) {
+		vec2 pos  = { screen_rect.from.x, screen_rect.from.y + cast(f32) (r - ff->top) * cell_h };
+		vec2 size = { width, cell_h };
+
+		if (r == ff->selected)
+			draw_quad(pos, size, 0xb8a27eff);
+
+		draw_string_aligned(
+			str8_tprintf(scratch, " " STR, s_fmt(editor_find_row(ff, r, scratch))),
+			pos, size, 0x131313ff, 4,
+			(Box_Alignment) {AlignH_Left, AlignV_Center}, cache
+		);
+	}
+
+	vec2 quad_pos =  { screen_rect.from.x, screen_rect.to.y - cell_h };
+	vec2 quad_size = { width, cell_h };
+	draw_quad(quad_pos, quad_size, 0x131313ff);
+
 	draw_string_aligned(
-		str8_tprintf(scratch, " -- " STR " --" , mode_string[Mode_Normal]),
+		editor_find_status(ff, scratch),
 		quad_pos, quad_size, 0x99856aff, 4,
 		(Box_Alignment) {AlignH_Left, AlignV_Center}, cache
 	);
-
 }
 
-
 int main(int argc, const char **argv)
 {
+	mem_scan_init();
+
 	Allocator alloc       = heap_allocator();
 	Allocator frame_alloc = arena_allocator(Mb(32));
 
@@ -278,7 +510,49 @@ int main(int argc, const char **argv)
 
 		Frame_Input input = gfx_frame_begin(0x99856aff);
 
-		if (input.text.len) {
+		if (ctx.mode == Mode_CLI) {
+			u32 flags = input.special_key_presses;
+
+			if (input.text.len) {
+				editor_push_cmd(&ctx, (Editor_Cmd){
+					.type = Cmd_Insert_Text,
+					.text_insert = { .text = input.text }
+				});
+			}
+			else if (MaskCheck(flags, Pressed_Enter)) {
+				editor_push_cmd(&ctx, (Editor_Cmd){ .type = Cmd_Prompt_Accept });
+			}
+			else if (MaskCheck(flags, Pressed_Escape)) {
+				editor_push_cmd(&ctx, (Editor_Cmd){ .type = Cmd_Prompt_Cancel });
+			}
+			else if (MaskCheck(flags, Pressed_Backspace)) {
+				editor_push_cmd(&ctx, (Editor_Cmd){
+					.type = Cmd_Delete_Text,
+					.text_delete = { .amount = 1, .move = true }
+				});
+			}
+		} else if (ctx.find && ctx.find->showing) {
+			u32 flags = input.special_key_presses;
+
+			if (MaskCheck(flags, Pressed_Move_Up) || MaskCheck(flags, Pressed_Move_Down)) {
+				editor_push_cmd(&ctx, (Editor_Cmd){
+					.type = Cmd_Find_Select,
+					.find_select = { .rows = MaskCheck(flags, Pressed_Move_Up) ? -1 : 1 }
+				});
+			}
+			else if (input.scroll_y != 0) {
+				editor_push_cmd(&ctx, (Editor_Cmd){
+					.type = Cmd_Find_Select,
+					.find_select = { .rows = cast(isize) (-input.scroll_y * 3) }
+				});
+			}
+			else if (MaskCheck(flags, Pressed_Enter)) {
+				editor_push_cmd(&ctx, (Editor_Cmd){ .type = Cmd_Find_Open });
+			}
+			else if (MaskCheck(flags, Pressed_Escape) || MaskCheck(flags, Pressed_Find_Toggle)) {
+				editor_push_cmd(&ctx, (Editor_Cmd){ .type = Cmd_Find_Toggle });
+			}
+		} else if (input.text.len) {
 			editor_push_cmd(&ctx, (Editor_Cmd){
 				.type = Cmd_Insert_Text,
 				.text_insert = { .text = input.text }
@@ -335,15 +609,131 @@ int main(int argc, const char **argv)
 					.cursor = { .dx = 0, .dy = 1 }
 				});
 			}
+			else if (MaskCheck(flags, Pressed_Cursor_Add_Up)) {
+				editor_push_cmd(&ctx, (Editor_Cmd){
+					.type = Cmd_Cursor_Add,
+					.cursor_add = { .rows = -1 }
+				});
+			}
+			else if (MaskCheck(flags, Pressed_Cursor_Add_Down)) {
+				editor_push_cmd(&ctx, (Editor_Cmd){
+					.type = Cmd_Cursor_Add,
+					.cursor_add = { .rows = 1 }
+				});
+			}
+			else if (MaskCheck(flags, Pressed_Escape)) {
+				editor_push_cmd(&ctx, (Editor_Cmd){ .type = Cmd_Cursor_Clear });
+			}
+			else if (MaskCheck(flags, Pressed_Undo)) {
+				editor_push_cmd(&ctx, (Editor_Cmd){ .type = Cmd_Undo });
+			}
+			else if (MaskCheck(flags, Pressed_Redo)) {
+				editor_push_cmd(&ctx, (Editor_Cmd){ .type = Cmd_Redo });
+			}
+			else if (MaskCheck(flags, Pressed_Search)) {
+				editor_push_cmd(&ctx, (Editor_Cmd){ .type = Cmd_Search_Begin });
+			}
+			else if (MaskCheck(flags, Pressed_Command)) {
+				editor_push_cmd(&ctx, (Editor_Cmd){ .type = Cmd_Command_Begin });
+			}
+			else if (MaskCheck(flags, Pressed_Search_All)) {
+				editor_push_cmd(&ctx, (Editor_Cmd){ .type = Cmd_Search_All_Begin });
+			}
+			else if (MaskCheck(flags, Pressed_Search_Next)) {
+				editor_push_cmd(&ctx, (Editor_Cmd){ .type = Cmd_Search_All_Next });
+			}
+			else if (MaskCheck(flags, Pressed_Find_Toggle)) {
+				editor_push_cmd(&ctx, (Editor_Cmd){ .type = Cmd_Find_Toggle });
+			}
+			else if (MaskCheck(flags, Pressed_Pair_Jump)) {
+				editor_push_cmd(&ctx, (Editor_Cmd){ .type = Cmd_Pair_Jump });
+			}
+			else if (MaskCheck(flags, Pressed_Pair_Select)) {
+				editor_push_cmd(&ctx, (Editor_Cmd){ .type = Cmd_Pair_Select });
+			}
+			else if (MaskCheck(flags, Pressed_Fold_Toggle)) {
+				editor_push_cmd(&ctx, (Editor_Cmd){ .type = Cmd_Fold_Toggle });
+			}
+			else if (MaskCheck(flags, Pressed_View_Next)) {
+				editor_push_cmd(&ctx, (Editor_Cmd){ .type = Cmd_View_Next });
+			}
+			else if (MaskCheck(flags, Pressed_Save)) {
+				editor_push_cmd(&ctx, (Editor_Cmd){ .type = Cmd_Buffer_Save });
+			}
+		}
+
+		if (input.scroll_y != 0 && !(ctx.find && ctx.find->showing)) {
+			editor_push_cmd(&ctx, (Editor_Cmd){
+				.type = Cmd_Scroll,
+				.scroll = { .rows = cast(isize) (-input.scroll_y * 3) }
+			});
 		}
 
 
-		local_persist f32 scroll = -10.0;
-		if (scroll >= -10.0)
-			scroll -= input.scroll_y * 90;
-		else
-			scroll = -10.0;
-		editor_render(ctx.active_buffer, frame_alloc, &glyph_cache, scroll );
+		// ~geb: wrapped lines are only laid out again once the window changed
+		//       size or was split another way. the views are all as wide
+		local_persist u32 resizes = U32_MAX;
+		local_persist u32 views   = 0;
+		if (gfx_resizes() != resizes || ctx.view_count != views) {
+			resizes = gfx_resizes();
+			views   = ctx.view_count;
+
+			Rect clip = gfx_get_clip_rect();
+			f32  wide = (clip.to.x - clip.from.x) / cast(f32) Max(views, 1) - 10.0f;
+			editor_wrap_resize(&ctx, cast(usize) Max(wide / cast(f32) glyph_cache.tile_width, 1.0f));
+		}
+
+		for (Q_Buffer *b = ctx.buffer_list; b; b = b->next)
+			buffer_load_pump(b);
+		editor_search_pump(&ctx);
+		editor_search_all_pump(&ctx);
+		editor_find_pump(&ctx);
+		editor_caches_pump(&ctx);
+
+		// ~geb: the line drawn in place of the mode, if any
+		String8 status = {0};
+		if (ctx.mode == Mode_CLI && ctx.prompt != Prompt_Search) {
+			String8 line = buffer_slice(ctx.cli_buffer, 0, buffer_len(ctx.cli_buffer), frame_alloc);
+			status = str8_tprintf(frame_alloc, ctx.prompt == Prompt_Command ? " :" STR : " all/" STR, s_fmt(line));
+		} else if (ctx.mode != Mode_CLI && ctx.search_all) {
+			String8 line = editor_search_all_status(&ctx, frame_alloc);
+			status = str8_tprintf(frame_alloc, " " STR, s_fmt(line));
+		}
+
+		if (ctx.find && ctx.find->showing && ctx.mode != Mode_CLI) {
+			find_render(ctx.find, frame_alloc, &glyph_cache);
+		} else {
+			// ~geb: side by side, each drawn into a clip rect of its own
+			local_persist vec2 carets[EDITOR_MAX_VIEWS];
+
+			Rect window = gfx_get_clip_rect();
+			f32  width  = (window.to.x - window.from.x) / cast(f32) Max(ctx.view_count, 1);
+
+			for (u32 i = 0; i < ctx.view_count; ++i) {
+				Editor_View *v = &ctx.views[i];
+				if (!v->buffer) continue;
+
+				bool focused = i == ctx.view;
+				f32  x = window.from.x + width * cast(f32) i;
+
+				gfx_set_clip_rect((Rect){ { x, window.from.y }, { x + width, window.to.y } });
+
+				f32 y_level = cast(f32) editor_view_top_row(&ctx, i) * cast(f32) glyph_cache.tile_height - 10.0f;
+
+				editor_render(v->buffer, editor_view_cursor(&ctx, i),
+					focused ? dyn_arr_data(&ctx.cursors, usize) : NULL, focused ? ctx.cursors.len : 0,
+					focused && ctx.mode == Mode_CLI && ctx.prompt == Prompt_Search ? &ctx.search : NULL,
+					editor_caches(&ctx, v->buffer),
+					focused ? editor_selection(&ctx) : (Editor_Selection){0},
+					focused && status.len ? &status : NULL,
+					focused, &carets[i],
+					frame_alloc, &glyph_cache, y_level );
+
+				if (i) draw_quad((vec2){ x, window.from.y }, (vec2){ 2.0f, window.to.y - window.from.y }, 0x131313ff);
+			}
+
+			gfx_reset_clip_rect();
+		}
 
 		gfx_frame_end();
 	}
@@ -0,0 +1,418 @@
+///////////////////////////////////////////////
+// ~geb: Summaries
+
+internal i32
+pairs_effect(u8 c, Pair_Kind k)
+{
+	switch (c) {
+		case '(': return k == Pair_Paren  || k == Pair_Any ?  1 : 0;
+		case ')': return k == Pair_Paren  || k == Pair_Any ? -1 : 0;
+		case '[': return k == Pair_Square || k == Pair_Any ?  1 : 0;
+		case ']': return k == Pair_Square || k == Pair_Any ? -1 : 0;
+		case '{': return k == Pair_Curly  || k == Pair_Any ?  1 : 0;
+		case '}': return k == Pair_Curly  || k == Pair_Any ? -1 : 0;
+	}
+	return 0;
+}
+
+internal Pair_Kind
+_pairs_kind(u8 c)
+{
+	switch (c) {
+		case '(': case ')': return Pair_Paren;
+		case '[': case ']': return Pair_Square;
+		case '{': case '}': return Pair_Curly;
+	}
+	return Pair_Any;
+}
+
+internal void
+_pairs_join(void *out, void *left, void *right)
+{
+	Pair_Summary *a = left, *b = right;
+	Pair_Summary s = { .len = a->len + b->len };
+	for (usize k = 0; k < Pair_Kind_Count; ++k) {
+		s.delta[k] = a->delta[k] + b->delta[k];
+		s.low[k]   = Min(a->low[k], a->delta[k] + b->low[k]);
+	}
+	*cast(Pair_Summary *) out = s;
+}
+
+internal Pair_Summary
+_pairs_summarize(Q_Buffer *b, usize begin, usize end)
+{
+	Pair_Summary s = { .len = end - begin };
+
+	for (Q_Span_Iterator it = buffer_spans(b, begin, end); buffer_span_next(b, &it);) {
+		u8 *p = it.span.str;
+
+		for (usize i = 0; i < it.span.len; ++i) {
+			Pair_Kind k = _pairs_kind(p[i]);
+			if (k == Pair_Any) continue;
+
+			i32 e = pairs_effect(p[i], k);
+			s.delta[k]        += e;
+			s.low[k]           = Min(s.low[k], s.delta[k]);
+			s.delta[Pair_Any] += e;
+			s.low[Pair_Any]    = Min(s.low[Pair_Any], s.delta[Pair_Any]);
+		}
+	}
+	return s;
+}
+
+///////////////////////////////////////////////
+// ~geb: Tree
+
+// ~geb: how far the blocks reach into the text
+internal usize
+_pairs_built(Pair_Index *pi)
+{
+	return gap_tree_nodes(&pi->tree, Pair_Summary)[1].len;
+}
+
+// ~geb: a block put in right in front of the gap
+internal bool
+_pairs_push(Pair_Index *pi, Pair_Summary s)
+{
+	return gap_tree_push(&pi->tree, &s);
+}
+
+// ~geb: leaf of the block holding `offset`, which has to be indexed
+internal usize
+_pairs_leaf_at(Pair_Index *pi, usize offset, usize *start)
+{
+	Pair_Summary *t = gap_tree_nodes(&pi->tree, Pair_Summary);
+	usize n  = 1;
+	usize at = 0;
+
+	while (n < pi->tree.cap) {
+		if (offset < at + t[2 * n].len) {
+			n = 2 * n;
+		} else {
+			at += t[2 * n].len;
+			n   = 2 * n + 1;
+		}
+	}
+	*start = at;
+	return n - pi->tree.cap;
+}
+
+internal usize
+_pairs_leaf_start(Pair_Index *pi, usize leaf)
+{
+	Pair_Summary *t = gap_tree_nodes(&pi->tree, Pair_Summary);
+	usize at = 0;
+	for (usize n = pi->tree.cap + leaf; n > 1; n >>= 1) {
+		if (n & 1) at += t[n - 1].len;
+	}
+	return at;
+}
+
+// ~geb: indexes the text up to `to`, from wherever it got to before
+internal bool
+_pairs_build(Pair_Index *pi, usize to)
+{
+	usize len   = buffer_len(pi->buffer);
+	usize built = _pairs_built(pi);
+
+	to = Min(to, len);
+	if (built >= to) return true;
+
+	gap_tree_gap_to(&pi->tree, gap_tree_count(&pi->tree));
+
+	while (built < to) {
+		usize end = Min(built + PAIR_BLOCK, len);
+		if (!_pairs_push(pi, _pairs_summarize(pi->buffer, built, end))) return false;
+		built = end;
+	}
+	return true;
+}
+
+// ~geb: the blocks an edit touched are scanned again, the ones on either
+//       side stay as they are. when the edit runs past what was indexed
+//       everything from it on is left for later
+internal void
+_pairs_catch_up(Pair_Index *pi)
+{
+	Buffer_Dirty d = pi->dirty;
+	if (!d.any) return;
+	pi->dirty = (Buffer_Dirty){0};
+
+	usize len     = buffer_len(pi->buffer);
+	usize old_len = pi->text_len;
+	usize old_end = d.end + old_len - len;
+	usize built   = _pairs_built(pi);
+	pi->text_len  = len;
+
+	if (d.begin >= built) return;
+
+	usize start = 0;
+	usize first = gap_tree_logical(&pi->tree, _pairs_leaf_at(pi, d.begin, &start));
+	usize last  = gap_tree_count(&pi->tree) - 1;
+	usize stop  = built;
+
+	if (old_end < built) {
+		usize leaf = _pairs_leaf_at(pi, old_end, &stop);
+		stop += gap_tree_nodes(&pi->tree, Pair_Summary)[pi->tree.cap + leaf].len;
+		last  = gap_tree_logical(&pi->tree, leaf);
+	}
+
+	gap_tree_gap_to(&pi->tree, first);
+	gap_tree_drop(&pi->tree, last - first + 1);
+
+	if (old_end >= built) return;
+
+	// ~geb: cut into even blocks so typing at the end of one does not leave slivers
+	usize end    = stop + len - old_len;
+	usize size   = end - start;
+	usize blocks = (size + PAIR_BLOCK - 1) / PAIR_BLOCK;
+
+	for (usize i = 0; i < blocks; ++i) {
+		usize from = start + size * i / blocks;
+		usize to   = start + size * (i + 1) / blocks;
+
+		if (!_pairs_push(pi, _pairs_summarize(pi->buffer, from, to))) {
+			// ~geb: no room, drop the rest and index it again later
+			gap_tree_drop(&pi->tree, pi->tree.cap - pi->tree.after);
+			return;
+		}
+	}
+}
+
+///////////////////////////////////////////////
+// ~geb: Queries
+
+// ~geb: depth relative to some point is `*depth` at `begin`, first spot
+//       in (begin, end] where it is down to `target`. when there is none
+//       `*depth` is left at what it is at `end`
+internal bool
+_pairs_scan_first(Pair_Index *pi, Pair_Kind k, usize begin, usize end, isize *depth, isize target, usize *at)
+{
+	isize d = *depth;
+	for (Q_Span_Iterator it = buffer_spans(pi->buffer, begin, end); buffer_span_next(pi->buffer, &it);) {
+		for (usize i = 0; i < it.span.len; ++i) {
+			d += pairs_effect(it.span.str[i], k);
+			if (d <= target) {
+				*at = it.offset + i + 1;
+				return true;
+			}
+		}
+	}
+	*depth = d;
+	return false;
+}
+
+// ~geb: same, the last spot in [begin, end) where it is down to `target`
+internal bool
+_pairs_scan_last(Pair_Index *pi, Pair_Kind k, usize begin, usize end, isize depth, isize target, usize *at)
+{
+	bool found = false;
+	if (depth <= target && begin < end) {
+		*at   = begin;
+		found = true;
+	}
+
+	for (Q_Span_Iterator it = buffer_spans(pi->buffer, begin, end); buffer_span_next(pi->buffer, &it);) {
+		for (usize i = 0; i < it.span.len; ++i) {
+			depth += pairs_effect(it.span.str[i], k);
+			if (depth <= target && it.offset + i + 1 < end) {
+				*at   = it.offset + i + 1;
+				found = true;
+			}
+		}
+	}
+	return found;
+}
+
+// ~geb: first spot after `from` where the depth is one below what it is at `from`
+internal bool
+_pairs_forward(Pair_Index *pi, Pair_Kind k, usize from, usize *at)
+{
+	if (!_pairs_build(pi, USIZE_MAX)) return false;
+
+	Pair_Summary *t = gap_tree_nodes(&pi->tree, Pair_Summary);
+	if (from >= t[1].len) return false;
+
+	usize start = 0;
+	usize leaf  = _pairs_leaf_at(pi, from, &start);
+	usize n     = pi->tree.cap + leaf;
+
+	isize depth = 0;
+	if (_pairs_scan_first(pi, k, from, start + t[n].len, &depth, -1, at)) return true;
+
+	// ~geb: up until a block to the right dips low enough, then down into it
+	for (;; n >>= 1) {
+		if (n == 1) return false;
+		if (n & 1) continue;
+
+		if (depth + t[n + 1].low[k] <= -1) {
+			n = n + 1;
+			break;
+		}
+		depth += t[n + 1].delta[k];
+	}
+
+	while (n < pi->tree.cap) {
+		usize l = 2 * n;
+		if (depth + t[l].low[k] <= -1) {
+			n = l;
+		} else {
+			depth += t[l].delta[k];
+			n = l + 1;
+		}
+	}
+
+	start = _pairs_leaf_start(pi, n - pi->tree.cap);
+	return _pairs_scan_first(pi, k, start, start + t[n].len, &depth, -1, at);
+}
+
+// ~geb: last spot before `from` where the depth is one below what it is at `from`
+internal bool
+_pairs_backward(Pair_Index *pi, Pair_Kind k, usize from, usize *at)
+{
+	if (!from || !_pairs_build(pi, from)) return false;
+
+	Pair_Summary *t = gap_tree_nodes(&pi->tree, Pair_Summary);
+
+	usize start = 0;
+	usize leaf  = _pairs_leaf_at(pi, from - 1, &start);
+	usize n     = pi->tree.cap + leaf;
+
+	isize depth = 0; // ~geb: at `start`, from `from`
+	for (Q_Span_Iterator it = buffer_spans(pi->buffer, start, from); buffer_span_next(pi->buffer, &it);) {
+		for (usize i = 0; i < it.span.len; ++i) depth -= pairs_effect(it.span.str[i], k);
+	}
+	if (_pairs_scan_last(pi, k, start, from, depth, -1, at)) return true;
+
+	// ~geb: up until a block to the left dips low enough, then down into it.
+	//       `depth` is kept at the end of the part being looked at
+	for (;; n >>= 1) {
+		if (n == 1) return false;
+		if (!(n & 1)) continue;
+
+		Pair_Summary *s = &t[n - 1];
+		if (depth - s->delta[k] + s->low[k] <= -1) {
+			n = n - 1;
+			break;
+		}
+		depth -= s->delta[k];
+	}
+
+	while (n < pi->tree.cap) {
+		Pair_Summary *r = &t[2 * n + 1];
+		if (depth - r->delta[k] + r->low[k] <= -1) {
+			n = 2 * n + 1;
+		} else {
+			depth -= r->delta[k];
+			n = 2 * n;
+		}
+	}
+
+	start = _pairs_leaf_start(pi, n - pi->tree.cap);
+	return _pairs_scan_last(pi, k, start, start + t[n].len, depth - t[n].delta[k], -1, at);
+}
+
+internal u8
+_pairs_byte(Q_Buffer *b, usize offset)
+{
+	Q_Span_Iterator it = buffer_spans(b, offset, offset + 1);
+	return buffer_span_next(b, &it) ? it.span.str[0] : 0;
+}
+
+///////////////////////////////////////////////
+
+internal Pair_Index *
+pairs_make(Q_Buffer *buf, Allocator alloc)
+{
+	Pair_Index *pi = cast(Pair_Index *) mem_alloc_aligned(alloc, sizeof(Pair_Index), AlignOf(Pair_Index), true, NULL);
+	if (!pi) return NULL;
+
+	pi->alloc    = alloc;
+	pi->buffer   = buf;
+	pi->text_len = buffer_len(buf);
+
+	pi->tree = gap_tree(alloc, Pair_Summary, _pairs_join);
+	if (!gap_tree_grow(&pi->tree) || !buffer_watch(buf, &pi->dirty)) {
+		gap_tree_delete(&pi->tree);
+		mem_free(alloc, pi, NULL);
+		return NULL;
+	}
+	return pi;
+}
+
+internal void
+pairs_delete(Pair_Index *pi)
+{
+	if (!pi) return;
+
+	buffer_unwatch(pi->buffer, &pi->dirty);
+	gap_tree_delete(&pi->tree);
+	mem_free(pi->alloc, pi, NULL);
+}
+
+internal void
+pairs_pump(Pair_Index *pi)
+{
+	if (!pi) return;
+	_pairs_catch_up(pi);
+	_pairs_build(pi, _pairs_built(pi) + PAIR_PUMP_BUDGET);
+}
+
+internal isize
+pairs_depth(Pair_Index *pi, usize offset)
+{
+	_pairs_catch_up(pi);
+	if (!_pairs_build(pi, offset)) return 0;
+
+	Pair_Summary *t = gap_tree_nodes(&pi->tree, Pair_Summary);
+	if (offset >= t[1].len) return t[1].delta[Pair_Any];
+
+	usize start = 0;
+	usize n     = pi->tree.cap + _pairs_leaf_at(pi, offset, &start);
+
+	isize depth = 0;
+	for (; n > 1; n >>= 1) {
+		if (n & 1) depth += t[n - 1].delta[Pair_Any];
+	}
+	for (Q_Span_Iterator it = buffer_spans(pi->buffer, start, offset); buffer_span_next(pi->buffer, &it);) {
+		for (usize i = 0; i < it.span.len; ++i) depth += pairs_effect(it.span.str[i], Pair_Any);
+	}
+	return depth;
+}
+
+internal bool
+pairs_match(Pair_Index *pi, usize offset, usize *match)
+{
+	_pairs_catch_up(pi);
+	if (offset >= buffer_len(pi->buffer)) return false;
+
+	u8 c = _pairs_byte(pi->buffer, offset);
+	Pair_Kind k = _pairs_kind(c);
+	if (k == Pair_Any) return false;
+
+	usize at = 0;
+	if (pairs_effect(c, k) > 0) {
+		if (!_pairs_forward(pi, k, offset + 1, &at)) return false;
+		*match = at - 1;
+	} else {
+		if (!_pairs_backward(pi, k, offset, &at)) return false;
+		*match = at;
+	}
+	return true;
+}
+
+internal bool
+pairs_enclosing(Pair_Index *pi, usize begin, usize end, usize *open, usize *close)
+{
+	_pairs_catch_up(pi);
+
+	usize at = 0;
+	if (!_pairs_backward(pi, Pair_Any, begin, &at)) return false;
+
+	usize after = 0;
+	if (!_pairs_forward(pi, Pair_Any, at + 1, &after) || after < end) return false;
+
+	*open  = at;
+	*close = after - 1;
+	return true;
+}
@@ -0,0 +1,66 @@
+#ifndef PAIRS_H
+#define PAIRS_H
+
+///////////////////////////////////////////////////////////////////
+// ~geb: bracket nesting over a whole buffer. the text is cut into
+//       blocks of about PAIR_BLOCK bytes and each block is summed up
+//       as how far it moves the depth and how low the depth dips in
+//       it. the blocks are the leaves of a segment tree, so the depth
+//       at an offset and the next / previous spot the depth drops
+//       under some level are found in O(log n) plus one block scanned.
+//       an edit only scans the blocks it touched again.
+//       brackets inside strings and comments count like any other.
+///////////////////////////////////////////////////////////////////
+
+#include "base.h"
+#include "buffer.h"
+
+typedef u8 Pair_Kind;
+enum {
+	Pair_Paren = 0,
+	Pair_Square,
+	Pair_Curly,
+	Pair_Any,       // the three taken together
+	Pair_Kind_Count,
+};
+
+#define PAIR_BLOCK        Kb(4)
+#define PAIR_PUMP_BUDGET  Mb(16) // bytes indexed ahead per frame
+
+typedef struct {
+	usize len;
+	i32   delta[Pair_Kind_Count]; // depth at the end, from the start
+	i32   low[Pair_Kind_Count];   // lowest depth on the way, the start included
+} Pair_Summary;
+
+// ~geb: the blocks are the leaves of a gap tree of Pair_Summary, they
+//       cover the text up to the root's `len`, the rest is indexed lazily.
+typedef struct {
+	Allocator     alloc;
+	Q_Buffer     *buffer;
+	Buffer_Dirty  dirty;
+
+	Gap_Tree      tree;
+
+	usize         text_len; // buffer length as of the last look
+} Pair_Index;
+
+// ~geb: +1 for an opening bracket of kind `k`, -1 for a closing one
+internal i32 pairs_effect(u8 c, Pair_Kind k);
+
+internal Pair_Index *pairs_make(Q_Buffer *buf, Allocator alloc);
+internal void        pairs_delete(Pair_Index *index);
+internal void        pairs_pump(Pair_Index *index);
+
+// ~geb: depth counting every kind of bracket in front of `offset`.
+//       negative when there are more closing than opening ones
+internal isize pairs_depth(Pair_Index *index, usize offset);
+
+// ~geb: the bracket matching the one at `offset`
+internal bool pairs_match(Pair_Index *index, usize offset, usize *match);
+
+// ~geb: the innermost pair of brackets wrapped around [begin, end) that
+//       is not [begin, end) itself. `close` is the offset of the closing one
+internal bool pairs_enclosing(Pair_Index *index, usize begin, usize end, usize *open, usize *close);
+
+#endif
@@ -0,0 +1,550 @@
+///////////////////////////////////////////////
+// ~geb: Languages
+
+#define W(s, k) { S(s), k }
+#define KW(s) W(s, Token_Keyword)
+#define TY(s) W(s, Token_Type)
+
+#define C_WORDS \
+	KW("auto"), KW("break"), KW("case"), KW("const"), KW("continue"), KW("default"), \
+	KW("do"), KW("else"), KW("enum"), KW("extern"), KW("for"), KW("goto"), KW("if"), \
+	KW("inline"), KW("register"), KW("restrict"), KW("return"), KW("sizeof"), \
+	KW("static"), KW("struct"), KW("switch"), KW("typedef"), KW("union"), \
+	KW("volatile"), KW("while"), KW("_Alignas"), KW("_Alignof"), KW("_Atomic"), \
+	KW("_Generic"), KW("_Noreturn"), KW("_Static_assert"), KW("_Thread_local"), \
+	KW("true"), KW("false"), KW("NULL"), KW("internal"), KW("local_persist"), \
+	TY("void"), TY("char"), TY("short"), TY("int"), TY("long"), TY("float"), \
+	TY("double"), TY("signed"), TY("unsigned"), TY("bool"), TY("_Bool"), \
+	TY("size_t"), TY("ssize_t"), TY("ptrdiff_t"), TY("intptr_t"), TY("uintptr_t"), \
+	TY("int8_t"), TY("int16_t"), TY("int32_t"), TY("int64_t"), \
+	TY("uint8_t"), TY("uint16_t"), TY("uint32_t"), TY("uint64_t"), TY("FILE"), \
+	TY("u8"), TY("u16"), TY("u32"), TY("u64"), TY("i8"), TY("i16"), TY("i32"), \
+	TY("i64"), TY("f32"), TY("f64"), TY("usize"), TY("isize"), TY("rune")
+
+internal Syntax_Word _c_words[] = { C_WORDS };
+
+internal Syntax_Word _cpp_words[] = {
+	C_WORDS,
+	KW("class"), KW("namespace"), KW("template"), KW("typename"), KW("public"),
+	KW("private"), KW("protected"), KW("virtual"), KW("override"), KW("final"),
+	KW("new"), KW("delete"), KW("this"), KW("operator"), KW("using"), KW("try"),
+	KW("catch"), KW("throw"), KW("constexpr"), KW("consteval"), KW("nullptr"),
+	KW("noexcept"), KW("decltype"), KW("explicit"), KW("friend"), KW("mutable"),
+	KW("static_cast"), KW("dynamic_cast"), KW("reinterpret_cast"), KW("const_cast"),
+	KW("co_await"), KW("co_return"), KW("co_yield"), KW("concept"), KW("requires"),
+	TY("wchar_t"), TY("char8_t"), TY("char16_t"), TY("char32_t"),
+};
+
+internal Syntax_Word _python_words[] = {
+	KW("and"), KW("as"), KW("assert"), KW("async"), KW("await"), KW("break"),
+	KW("class"), KW("continue"), KW("def"), KW("del"), KW("elif"), KW("else"),
+	KW("except"), KW("finally"), KW("for"), KW("from"), KW("global"), KW("if"),
+	KW("import"), KW("in"), KW("is"), KW("lambda"), KW("nonlocal"), KW("not"),
+	KW("or"), KW("pass"), KW("raise"), KW("return"), KW("try"), KW("while"),
+	KW("with"), KW("yield"), KW("match"), KW("None"), KW("True"), KW("False"),
+	KW("self"),
+	TY("int"), TY("float"), TY("complex"), TY("str"), TY("bytes"), TY("bytearray"),
+	TY("list"), TY("dict"), TY("set"), TY("frozenset"), TY("tuple"), TY("bool"),
+	TY("object"), TY("type"),
+};
+
+internal Syntax_Word _js_words[] = {
+	KW("break"), KW("case"), KW("catch"), KW("class"), KW("const"), KW("continue"),
+	KW("debugger"), KW("default"), KW("delete"), KW("do"), KW("else"), KW("export"),
+	KW("extends"), KW("finally"), KW("for"), KW("function"), KW("if"), KW("import"),
+	KW("in"), KW("instanceof"), KW("let"), KW("new"), KW("return"), KW("super"),
+	KW("switch"), KW("this"), KW("throw"), KW("try"), KW("typeof"), KW("var"),
+	KW("void"), KW("while"), KW("with"), KW("yield"), KW("async"), KW("await"),
+	KW("of"), KW("static"), KW("true"), KW("false"), KW("null"), KW("undefined"),
+	KW("interface"), KW("type"), KW("enum"), KW("implements"), KW("readonly"),
+	KW("declare"), KW("namespace"), KW("abstract"), KW("as"),
+	TY("number"), TY("string"), TY("boolean"), TY("any"), TY("unknown"),
+	TY("never"), TY("object"), TY("bigint"), TY("symbol"),
+};
+
+internal Syntax_Word _go_words[] = {
+	KW("break"), KW("case"), KW("chan"), KW("const"), KW("continue"), KW("default"),
+	KW("defer"), KW("else"), KW("fallthrough"), KW("for"), KW("func"), KW("go"),
+	KW("goto"), KW("if"), KW("import"), KW("interface"), KW("map"), KW("package"),
+	KW("range"), KW("return"), KW("select"), KW("struct"), KW("switch"), KW("type"),
+	KW("var"), KW("true"), KW("false"), KW("nil"), KW("iota"),
+	TY("bool"), TY("byte"), TY("complex64"), TY("complex128"), TY("error"),
+	TY("float32"), TY("float64"), TY("int"), TY("int8"), TY("int16"), TY("int32"),
+	TY("int64"), TY("rune"), TY("string"), TY("uint"), TY("uint8"), TY("uint16"),
+	TY("uint32"), TY("uint64"), TY("uintptr"), TY("any"),
+};
+
+internal Syntax_Word _shell_words[] = {
+	KW("if"), KW("then"), KW("else"), KW("elif"), KW("fi"), KW("case"), KW("esac"),
+	KW("for"), KW("while"), KW("until"), KW("do"), KW("done"), KW("in"),
+	KW("function"), KW("return"), KW("local"), KW("export"), KW("readonly"),
+	KW("declare"), KW("set"), KW("unset"), KW("shift"), KW("exit"), KW("break"),
+	KW("continue"), KW("source"), KW("eval"), KW("exec"), KW("trap"),
+};
+
+#undef C_WORDS
+#undef TY
+#undef KW
+#undef W
+
+internal Syntax_Language _languages[] = {
+	{
+		.name = S("c"), .extensions = S("c h"),
+		.line_comment = S("//"), .block_open = S("/*"), .block_close = S("*/"),
+		.quotes = { { S("\""), Quote_Escapes }, { S("'"), Quote_Escapes } },
+		.preproc = true,
+		.words = _c_words, .word_count = ArrayCount(_c_words),
+	},
+	{
+		.name = S("c++"), .extensions = S("cpp cc cxx c++ hpp hh hxx inl"),
+		.line_comment = S("//"), .block_open = S("/*"), .block_close = S("*/"),
+		.quotes = { { S("\""), Quote_Escapes }, { S("'"), Quote_Escapes } },
+		.preproc = true,
+		.words = _cpp_words, .word_count = ArrayCount(_cpp_words),
+	},
+	{
+		.name = S("python"), .extensions = S("py pyw pyi"),
+		.line_comment = S("#"),
+		.quotes = {
+			{ S("\"\"\""), Quote_Escapes | Quote_Multiline },
+			{ S("'''"),    Quote_Escapes | Quote_Multiline },
+			{ S("\""),     Quote_Escapes },
+			{ S("'"),      Quote_Escapes },
+		},
+		.words = _python_words, .word_count = ArrayCount(_python_words),
+	},
+	{
+		.name = S("javascript"), .extensions = S("js mjs cjs jsx ts tsx"),
+		.line_comment = S("//"), .block_open = S("/*"), .block_close = S("*/"),
+		.quotes = {
+			{ S("\""), Quote_Escapes },
+			{ S("'"),  Quote_Escapes },
+			{ S("`"),  Quote_Escapes | Quote_Multiline },
+		},
+		.words = _js_words, .word_count = ArrayCount(_js_words),
+	},
+	{
+		.name = S("go"), .extensions = S("go"),
+		.line_comment = S("//"), .block_open = S("/*"), .block_close = S("*/"),
+		.quotes = {
+			{ S("\""), Quote_Escapes },
+			{ S("'"),  Quote_Escapes },
+			{ S("`"),  Quote_Multiline },
+		},
+		.words = _go_words, .word_count = ArrayCount(_go_words),
+	},
+	{
+		.name = S("shell"), .extensions = S("sh bash zsh"),
+		.line_comment = S("#"),
+		.quotes = {
+			{ S("\""), Quote_Escapes | Quote_Multiline },
+			{ S("'"),  Quote_Multiline },
+		},
+		.words = _shell_words, .word_count = ArrayCount(_shell_words),
+	},
+};
+
+internal u32
+_word_hash(u8 *p, usize n)
+{
+	u32 h = 2166136261u;
+	for (usize i = 0; i < n; ++i)
+		h = (h ^ p[i]) * 16777619u;
+	return h;
+}
+
+internal void
+_language_ready(Syntax_Language *lang)
+{
+	if (lang->ready) return;
+
+	for (usize c = 0; c < 256; ++c) {
+		Char_Class k = 0;
+		if (is_letter(cast(rune) c) || c >= 0x80) k |= Class_Word_Begin | Class_Word;
+		if (is_digit(cast(rune) c))               k |= Class_Digit | Class_Word;
+		lang->class[c] = k;
+	}
+
+	String8 openers[] = { lang->line_comment, lang->block_open };
+	for (usize i = 0; i < ArrayCount(openers); ++i) {
+		if (openers[i].len) lang->class[openers[i].str[0]] |= Class_Opener;
+	}
+	for (usize i = 0; i < SYNTAX_MAX_QUOTES; ++i) {
+		if (lang->quotes[i].text.len) lang->class[lang->quotes[i].text.str[0]] |= Class_Opener;
+	}
+
+	Assert(lang->word_count * 2 <= SYNTAX_WORD_SLOTS);
+	for (usize i = 0; i < lang->word_count; ++i) {
+		String8 w = lang->words[i].text;
+		u32 at = _word_hash(w.str, w.len) & (SYNTAX_WORD_SLOTS - 1);
+
+		while (lang->slots[at]) at = (at + 1) & (SYNTAX_WORD_SLOTS - 1);
+		lang->slots[at] = cast(u16) (i + 1);
+	}
+
+	lang->ready = true;
+}
+
+internal Token_Kind
+_word_kind(Syntax_Language *lang, u8 *p, usize n)
+{
+	u32 at = _word_hash(p, n) & (SYNTAX_WORD_SLOTS - 1);
+
+	for (u16 slot; (slot = lang->slots[at]); at = (at + 1) & (SYNTAX_WORD_SLOTS - 1)) {
+		Syntax_Word *w = &lang->words[slot - 1];
+		if (w->text.len == n && MemCompare(w->text.str, p, n) == 0) return w->kind;
+	}
+	return Token_Text;
+}
+
+internal Syntax_Language *
+syntax_language_for(String8 path)
+{
+	String8 ext = str8_file_extension(path);
+	if (!ext.len || find_left(ext, '/') >= 0 || find_left(ext, '\\') >= 0) return NULL;
+
+	for (usize i = 0; i < ArrayCount(_languages); ++i) {
+		String8 list = _languages[i].extensions;
+
+		for (usize at = 0; at < list.len;) {
+			usize end = at;
+			while (end < list.len && list.str[end] != ' ') end++;
+
+			if (str8_equal(str8_slice(list, at, end), ext)) {
+				_language_ready(&_languages[i]);
+				return &_languages[i];
+			}
+			at = end + 1;
+		}
+	}
+	return NULL;
+}
+
+///////////////////////////////////////////////
+// ~geb: Lexer
+
+// ~geb: consecutive bytes of the same kind end up in one span
+internal void
+_span_push(Syntax_Highlights *out, usize begin, usize end, Token_Kind kind)
+{
+	if (!out || begin == end) return;
+
+	if (out->count) {
+		Syntax_Span *last = &out->spans[out->count - 1];
+		if (last->kind == kind && last->end == begin) {
+			last->end = end;
+			return;
+		}
+	}
+
+	if (out->count == out->cap) return;
+	out->spans[out->count++] = (Syntax_Span){ begin, end, kind };
+}
+
+internal bool
+_lex_has(String8 line, usize at, String8 s)
+{
+	return s.len && s.len <= line.len - at && MemCompare(line.str + at, s.str, s.len) == 0;
+}
+
+// ~geb: walks `at` past the close of a string opened with quote `q`,
+//       returns the state to go on in, which is `open` if it did not close
+internal Lex_State
+_lex_string(Syntax_Quote *q, Lex_State open, String8 line, usize *at)
+{
+	usize i = *at;
+
+	while (i < line.len) {
+		u8 c = line.str[i];
+
+		if (c == '\\' && (q->flags & Quote_Escapes)) {
+			if (i + 1 == line.len) {
+				*at = line.len;
+				return open; // ~geb: the newline is escaped
+			}
+			i += 2;
+			continue;
+		}
+		if (c == q->text.str[0] && _lex_has(line, i, q->text)) {
+			*at = i + q->text.len;
+			return Lex_Normal;
+		}
+		i++;
+	}
+
+	*at = line.len;
+	return (q->flags & Quote_Multiline) ? open : Lex_Normal;
+}
+
+// ~geb: spans are pushed as `base` + their offset in the line, and only
+//       for the part of the line in front of `stop`. the state the next
+//       line starts in is only right when `stop` is past the end of it.
+internal Lex_State
+syntax_lex_line(Syntax_Language *lang, Lex_State state, String8 line, usize base, usize stop, Syntax_Highlights *out)
+{
+	if (line.len && line.str[line.len - 1] == '\r') line.len--;
+	if (stop < line.len) line.len = stop;
+
+	usize at = 0;
+	bool  directive = state == Lex_Preproc;
+
+	// ~geb: finish what the line before left open
+	if (state == Lex_Block_Comment) {
+		for (; at < line.len && !_lex_has(line, at, lang->block_close); ++at);
+		if (at == line.len) {
+			_span_push(out, base, base + at, Token_Comment);
+			return state;
+		}
+		at += lang->block_close.len;
+		_span_push(out, base, base + at, Token_Comment);
+	}
+	else if (state >= Lex_String) {
+		Lex_State next = _lex_string(&lang->quotes[state - Lex_String], state, line, &at);
+		_span_push(out, base, base + at, Token_String);
+		if (next != Lex_Normal) return next;
+	}
+	else if (state == Lex_Normal && lang->preproc) {
+		usize i = 0;
+		while (i < line.len && (line.str[i] == ' ' || line.str[i] == '\t')) i++;
+		directive = i < line.len && line.str[i] == '#';
+	}
+
+	Char_Class *class = lang->class;
+
+	while (at < line.len) {
+		u8 c = line.str[at];
+		Char_Class k = class[c];
+
+		if (k & Class_Opener) {
+			if (_lex_has(line, at, lang->line_comment)) {
+				_span_push(out, base + at, base + line.len, Token_Comment);
+				return Lex_Normal;
+			}
+
+			if (_lex_has(line, at, lang->block_open)) {
+				usize from = at;
+				for (at += lang->block_open.len; at < line.len && !_lex_has(line, at, lang->block_close); ++at);
+				if (at == line.len) {
+					_span_push(out, base + from, base + at, Token_Comment);
+					return Lex_Block_Comment;
+				}
+				at += lang->block_close.len;
+				_span_push(out, base + from, base + at, Token_Comment);
+				continue;
+			}
+
+			usize q = 0;
+			while (q < SYNTAX_MAX_QUOTES && !_lex_has(line, at, lang->quotes[q].text)) q++;
+			if (q < SYNTAX_MAX_QUOTES) {
+				usize from = at;
+				at += lang->quotes[q].text.len;
+
+				Lex_State next = _lex_string(&lang->quotes[q], cast(Lex_State) (Lex_String + q), line, &at);
+				_span_push(out, base + from, base + at, Token_String);
+				if (next != Lex_Normal) return next;
+				continue;
+			}
+		}
+
+		if (directive) {
+			_span_push(out, base + at, base + at + 1, Token_Preproc);
+			at++;
+			continue;
+		}
+
+		if (k & Class_Digit) {
+			usize from = at;
+			bool  hex  = c == '0' && at + 1 < line.len && (line.str[at + 1] | 0x20) == 'x';
+
+			for (at++; at < line.len; ++at) {
+				u8 d = line.str[at];
+				if (class[d] & Class_Word || d == '.') continue;
+
+				u8 e = line.str[at - 1] | 0x20;
+				if ((d == '+' || d == '-') && !hex && e == 'e') continue;
+				break;
+			}
+			_span_push(out, base + from, base + at, Token_Number);
+			continue;
+		}
+
+		if (k & Class_Word_Begin) {
+			usize from = at;
+			for (at++; at < line.len && (class[line.str[at]] & Class_Word); ++at);
+
+			Token_Kind kind = _word_kind(lang, line.str + from, at - from);
+			if (kind != Token_Text) _span_push(out, base + from, base + at, kind);
+			continue;
+		}
+
+		at++;
+	}
+
+	if (directive && line.len && line.str[line.len - 1] == '\\') return Lex_Preproc;
+	return Lex_Normal;
+}
+
+///////////////////////////////////////////////
+// ~geb: State cache
+
+internal Syntax_Cache *
+syntax_cache_make(Q_Buffer *buf, Syntax_Language *lang, Allocator alloc)
+{
+	Syntax_Cache *sc = cast(Syntax_Cache *) mem_alloc_aligned(alloc, sizeof(Syntax_Cache), AlignOf(Syntax_Cache), true, NULL);
+	if (!sc) return NULL;
+
+	sc->alloc  = alloc;
+	sc->buffer = buf;
+	sc->lang   = lang;
+	sc->states = dynamic_array(alloc, Lex_State, 0);
+
+	if (!buffer_watch(buf, &sc->dirty)) {
+		mem_free(alloc, sc, NULL);
+		return NULL;
+	}
+
+	dyn_arr_append(&sc->states, Lex_State, Lex_Normal);
+	sc->valid = sc->stale = sc->states.len;
+	return sc;
+}
+
+internal void
+syntax_cache_delete(Syntax_Cache *sc)
+{
+	if (!sc) return;
+
+	buffer_unwatch(sc->buffer, &sc->dirty);
+	dynamic_array_delete(&sc->states);
+	mem_free(sc->alloc, sc, NULL);
+}
+
+// ~geb: folds the edits made since the last look into the states. the rows
+//       in front of the first edited one keep theirs, the ones behind the
+//       last edited one keep theirs as something to check against
+internal void
+_syntax_catch_up(Syntax_Cache *sc)
+{
+	Buffer_Dirty d = sc->dirty;
+	if (!d.any) return;
+	sc->dirty    = (Buffer_Dirty){0};
+	sc->complete = false;
+
+	Q_Buffer      *b  = sc->buffer;
+	Dynamic_Array *st = &sc->states;
+
+	usize lo = buffer_row_from_offset(b, d.begin);
+	usize hi = buffer_row_from_offset(b, d.end);
+	isize old_hi = cast(isize) hi - d.rows;
+
+	// ~geb: the states in front of `valid` and the ones from `stale` on each
+	//       follow from the row before them, but the two runs do not follow
+	//       from one another. only the part of one run behind the edit is kept
+	usize valid = sc->valid;
+	usize from  = cast(usize) Max(old_hi + 1, 0);
+	usize until = st->len;
+	if (from < valid) until = valid;
+	else              from  = Max(from, sc->stale);
+
+	sc->valid = Min(valid, lo + 1);
+
+	if (d.end >= buffer_len(b) || old_hi < cast(isize) lo || from >= until) {
+		st->len   = sc->valid;
+		sc->stale = sc->valid;
+		return;
+	}
+
+	usize keep = until - from;
+	usize to   = cast(usize) (cast(isize) from + d.rows);
+	if (to + keep > st->capacity && !dynamic_array_reserve(st, sizeof(Lex_State), AlignOf(Lex_State), to + keep)) {
+		st->len   = sc->valid;
+		sc->stale = sc->valid;
+		return;
+	}
+
+	Lex_State *s = dyn_arr_data(st, Lex_State);
+	MemMove(s + to, s + from, keep);
+	st->len   = to + keep;
+	sc->stale = to;
+}
+
+// ~geb: lexes row `valid - 1` for the state of the next one. returns the
+//       bytes gone through, 0 when nothing could be done
+internal usize
+_syntax_step(Syntax_Cache *sc, Allocator scratch)
+{
+	if (sc->complete || !sc->valid) return 0;
+
+	Q_Buffer  *b     = sc->buffer;
+	Lex_State *s     = dyn_arr_data(&sc->states, Lex_State);
+	usize      row   = sc->valid - 1;
+	usize      begin = buffer_offset_from_row(b, row);
+	usize      end   = buffer_row_end(b, row);
+
+	String8   line = buffer_slice(b, begin, end, scratch);
+	Lex_State next = syntax_lex_line(sc->lang, s[row], line, 0, USIZE_MAX, NULL);
+
+	if (end == buffer_len(b)) {
+		sc->complete   = true;
+		sc->states.len = sc->valid;
+		sc->stale      = sc->valid;
+		return end - begin + 1;
+	}
+
+	if (sc->valid < sc->states.len) {
+		// ~geb: the rest is what it was before the edit once a row starts as it did
+		bool same = sc->valid >= sc->stale && s[sc->valid] == next;
+		s[sc->valid] = next;
+		sc->valid = same ? sc->states.len : sc->valid + 1;
+	} else {
+		usize len = sc->states.len;
+		dyn_arr_append(&sc->states, Lex_State, next);
+		if (sc->states.len == len) return 0;
+		sc->valid++;
+	}
+
+	sc->stale = Max(sc->stale, sc->valid);
+	return end - begin + 1;
+}
+
+internal void
+syntax_pump(Syntax_Cache *sc, Allocator scratch)
+{
+	if (!sc) return;
+	_syntax_catch_up(sc);
+
+	for (usize budget = 0; budget < SYNTAX_PUMP_BUDGET;) {
+		usize n = _syntax_step(sc, scratch);
+		if (!n) break;
+		budget += n;
+	}
+}
+
+internal Syntax_Highlights
+syntax_visible(Syntax_Cache *sc, usize first_row, usize rows, usize row_bytes, Allocator alloc)
+{
+	Syntax_Highlights hl = {0};
+	if (!sc) return hl;
+	_syntax_catch_up(sc);
+
+	// ~geb: the pump has usually been through these already
+	while (sc->valid < first_row + rows && _syntax_step(sc, alloc));
+
+	usize last = Min(first_row + rows, sc->valid);
+	if (first_row >= last) return hl;
+
+	hl.cap   = (last - first_row) * 64;
+	hl.spans = alloc_array_nz(alloc, Syntax_Span, hl.cap, NULL);
+	if (!hl.spans) return (Syntax_Highlights){0};
+
+	Q_Buffer  *b = sc->buffer;
+	Lex_State *s = dyn_arr_data(&sc->states, Lex_State);
+
+	for (usize row = first_row; row < last; ++row) {
+		usize begin = buffer_offset_from_row(b, row);
+		usize end   = Min(buffer_row_end(b, row), begin + row_bytes);
+
+		String8 line = buffer_slice(b, begin, end, alloc);
+		syntax_lex_line(sc->lang, s[row], line, begin, row_bytes, &hl);
+	}
+	return hl;
+}
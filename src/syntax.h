@@ -0,0 +1,125 @@
+#ifndef SYNTAX_H
+#define SYNTAX_H
+
+///////////////////////////////////////////////////////////////////
+// ~geb: syntax highlighting. a language is just a table, one lexer
+//       walks all of them a line at a time. what a line leaves open
+//       (a block comment, a string that goes on) is carried into the
+//       next one as a small state, and the state every row starts in
+//       is cached, so any row can be lexed on its own. an edit only
+//       throws away the states from its row on, and lexing again stops
+//       at the first row that starts in the state it had before.
+///////////////////////////////////////////////////////////////////
+
+#include "base.h"
+#include "buffer.h"
+
+typedef u8 Token_Kind;
+enum {
+	Token_Text = 0,
+	Token_Keyword,
+	Token_Type,
+	Token_Number,
+	Token_String,
+	Token_Comment,
+	Token_Preproc,
+	Token_Count,
+};
+
+// ~geb: what is still open at the end of a line
+typedef u8 Lex_State;
+enum {
+	Lex_Normal = 0,
+	Lex_Block_Comment,
+	Lex_Preproc,       // a directive carried on with a backslash
+	Lex_String,        // + the index of the quote in the language
+};
+
+typedef u8 Quote_Flags;
+enum {
+	Quote_Multiline = Bit(0), // goes on past the end of the line
+	Quote_Escapes   = Bit(1), // a backslash takes the byte after it, a newline too
+};
+
+typedef struct {
+	String8     text; // opens and closes the string
+	Quote_Flags flags;
+} Syntax_Quote;
+
+typedef struct {
+	String8    text;
+	Token_Kind kind;
+} Syntax_Word;
+
+#define SYNTAX_MAX_QUOTES 4
+#define SYNTAX_WORD_SLOTS 512 // a power of two, over twice the words of any language
+
+typedef u8 Char_Class;
+enum {
+	Class_Word_Begin = Bit(0),
+	Class_Word       = Bit(1),
+	Class_Digit      = Bit(2),
+	Class_Opener     = Bit(3), // may start a comment or a string
+};
+
+typedef struct {
+	String8 name;
+	String8 extensions;   // space separated, without the dot
+	String8 line_comment;
+	String8 block_open;
+	String8 block_close;
+	Syntax_Quote quotes[SYNTAX_MAX_QUOTES]; // longer openers first
+	bool    preproc;      // a line starting with '#' is a directive
+
+	Syntax_Word *words;
+	usize        word_count;
+
+	// ~geb: built from the above on first use
+	bool       ready;
+	Char_Class class[256];
+	u16        slots[SYNTAX_WORD_SLOTS]; // index + 1 into `words`, 0 when empty
+} Syntax_Language;
+
+typedef struct {
+	usize      begin;
+	usize      end;
+	Token_Kind kind;
+} Syntax_Span;
+
+// ~geb: colored spans on the rows in view, sorted. text gets no span
+typedef struct {
+	Syntax_Span *spans;
+	usize        count;
+	usize        cap;
+} Syntax_Highlights;
+
+#define SYNTAX_PUMP_BUDGET Mb(4) // bytes lexed ahead per frame
+
+// ~geb: the lexer states of one buffer. `states[r]` is the state row r
+//       starts in, right for every row in front of `valid`. the ones from
+//       `stale` on were right before the last edits and only got shifted to
+//       where their rows are now, they are kept to be checked against.
+typedef struct {
+	Allocator        alloc;
+	Q_Buffer        *buffer;
+	Syntax_Language *lang;
+	Buffer_Dirty     dirty; // watched, folded in before every use
+
+	Dynamic_Array states;   // Lex_State
+	usize valid;
+	usize stale;
+	bool  complete;         // every row is in front of `valid`
+} Syntax_Cache;
+
+internal Syntax_Language *syntax_language_for(String8 path); // NULL if none
+
+internal Syntax_Cache *syntax_cache_make(Q_Buffer *buf, Syntax_Language *lang, Allocator alloc);
+internal void          syntax_cache_delete(Syntax_Cache *cache);
+
+// ~geb: lexes ahead of what was asked for, call once a frame
+internal void              syntax_pump(Syntax_Cache *cache, Allocator scratch);
+internal Syntax_Highlights syntax_visible(Syntax_Cache *cache, usize first_row, usize rows, usize row_bytes, Allocator alloc);
+
+internal Lex_State syntax_lex_line(Syntax_Language *lang, Lex_State state, String8 line, usize base, usize stop, Syntax_Highlights *out);
+
+#endif
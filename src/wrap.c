@@ -0,0 +1,305 @@
+///////////////////////////////////////////////
+// ~geb: Measuring
+
+internal u32
+_wrap_cells(Q_Buffer *b, usize begin, usize end)
+{
+	usize cells = 0;
+	for (Q_Span_Iterator it = buffer_spans(b, begin, end); buffer_span_next(b, &it);) {
+		u8 *p = it.span.str;
+
+		for (usize i = 0; i < it.span.len; ++i) {
+			if ((p[i] & 0xc0) == 0x80) continue; // ~geb: the rest of a codepoint
+			cells += p[i] == '\t' ? WRAP_TAB_CELLS : 1;
+		}
+	}
+	return cast(u32) Min(cells, cast(usize) U32_MAX / 2);
+}
+
+internal u32
+_wrap_measure(Q_Buffer *b, usize line)
+{
+	return _wrap_cells(b, buffer_offset_from_row(b, line), buffer_row_end(b, line));
+}
+
+// ~geb: first glyph of `line` at or past cell `target`, the end of the line if none
+internal usize
+_wrap_offset_at_cell(Q_Buffer *b, usize line, usize target, usize *cell)
+{
+	usize begin = buffer_offset_from_row(b, line);
+	usize end   = buffer_row_end(b, line);
+	usize at    = 0;
+
+	for (Q_Span_Iterator it = buffer_spans(b, begin, end); buffer_span_next(b, &it);) {
+		u8 *p = it.span.str;
+
+		for (usize i = 0; i < it.span.len; ++i) {
+			if ((p[i] & 0xc0) == 0x80) continue;
+			if (at >= target) {
+				*cell = at;
+				return it.offset + i;
+			}
+			at += p[i] == '\t' ? WRAP_TAB_CELLS : 1;
+		}
+	}
+	*cell = at;
+	return end;
+}
+
+internal u32
+_wrap_rows(Wrap_Layout *wl, u32 width)
+{
+	return cast(u32) (width / wl->cols + 1);
+}
+
+///////////////////////////////////////////////
+// ~geb: Tree
+
+internal void
+_wrap_join(void *out, void *left, void *right)
+{
+	Wrap_Line *a = left, *b = right;
+	*cast(Wrap_Line *) out = (Wrap_Line){ .rows = a->rows + b->rows };
+}
+
+internal usize
+_wrap_total(Wrap_Layout *wl)
+{
+	return gap_tree_nodes(&wl->tree, Wrap_Line)[1].rows;
+}
+
+// ~geb: divides every width by `cols` again and sums the tree up anew
+internal void
+_wrap_relayout(Wrap_Layout *wl)
+{
+	Wrap_Line *leaf = gap_tree_nodes(&wl->tree, Wrap_Line) + wl->tree.cap;
+	for (usize i = 0; i < wl->tree.cap; ++i) {
+		bool gap = i >= wl->tree.before && i < wl->tree.after;
+		leaf[i].rows = gap ? 0 : _wrap_rows(wl, leaf[i].width);
+	}
+	gap_tree_fix(&wl->tree, 0, wl->tree.cap);
+}
+
+// ~geb: a line put in right in front of the gap
+internal bool
+_wrap_push(Wrap_Layout *wl, u32 width)
+{
+	Wrap_Line line = { .rows = _wrap_rows(wl, width), .width = width };
+	return gap_tree_push(&wl->tree, &line);
+}
+
+// ~geb: the leaf display row `row` is in, which has to be laid out,
+//       and the row its line starts on
+internal usize
+_wrap_leaf_at(Wrap_Layout *wl, usize row, usize *top)
+{
+	Wrap_Line *t = gap_tree_nodes(&wl->tree, Wrap_Line);
+	usize n  = 1;
+	usize at = 0;
+
+	while (n < wl->tree.cap) {
+		if (row < at + t[2 * n].rows) {
+			n = 2 * n;
+		} else {
+			at += t[2 * n].rows;
+			n   = 2 * n + 1;
+		}
+	}
+	*top = at;
+	return n - wl->tree.cap;
+}
+
+internal usize
+_wrap_top(Wrap_Layout *wl, usize line)
+{
+	Wrap_Line *t = gap_tree_nodes(&wl->tree, Wrap_Line);
+	usize at = 0;
+	for (usize n = wl->tree.cap + gap_tree_leaf(&wl->tree, line); n > 1; n >>= 1) {
+		if (n & 1) at += t[n - 1].rows;
+	}
+	return at;
+}
+
+// ~geb: measures lines from where it got to before until line `line` and
+//       display row `row` are both laid out, or the text runs out
+internal void
+_wrap_build(Wrap_Layout *wl, usize line, usize row)
+{
+	Q_Buffer *b  = wl->buffer;
+	usize built  = gap_tree_count(&wl->tree);
+	if (built > line && _wrap_total(wl) > row) return;
+
+	gap_tree_gap_to(&wl->tree, built);
+
+	usize len = buffer_len(b);
+	while (built <= line || _wrap_total(wl) <= row) {
+		if (built && buffer_row_end(b, built - 1) >= len) break;
+		if (!_wrap_push(wl, _wrap_measure(b, built))) break;
+		built++;
+	}
+}
+
+// ~geb: the lines an edit touched are measured again, the ones on either
+//       side stay as they are. when the edit runs past what was laid out
+//       everything from it on is left for later
+internal void
+_wrap_catch_up(Wrap_Layout *wl)
+{
+	if (wl->resized) {
+		wl->resized = false;
+		_wrap_relayout(wl);
+	}
+
+	Buffer_Dirty d = wl->dirty;
+	if (!d.any) return;
+	wl->dirty = (Buffer_Dirty){0};
+
+	Q_Buffer *b = wl->buffer;
+	usize built = gap_tree_count(&wl->tree);
+	usize first = buffer_row_from_offset(b, d.begin);
+	if (first >= built) return;
+
+	usize last     = buffer_row_from_offset(b, d.end);
+	isize old_last = Max(cast(isize) last - d.rows, cast(isize) first);
+	bool  to_end   = d.end >= buffer_len(b) || old_last >= cast(isize) built;
+
+	usize drop = to_end ? built - first : cast(usize) old_last - first + 1;
+
+	gap_tree_gap_to(&wl->tree, first);
+	gap_tree_drop(&wl->tree, drop);
+
+	if (to_end) return;
+
+	for (usize line = first; line <= last; ++line) {
+		if (!_wrap_push(wl, _wrap_measure(b, line))) {
+			// ~geb: no room, drop the rest and lay it out again later
+			gap_tree_drop(&wl->tree, wl->tree.cap - wl->tree.after);
+			return;
+		}
+	}
+}
+
+// ~geb: line and row within it of display row `row`, clamped to the last one
+internal bool
+_wrap_row_at(Wrap_Layout *wl, usize row, usize *line, usize *sub)
+{
+	_wrap_build(wl, 0, row);
+
+	usize total = _wrap_total(wl);
+	if (!total) return false;
+	row = Min(row, total - 1);
+
+	usize top = 0;
+	*line = gap_tree_logical(&wl->tree, _wrap_leaf_at(wl, row, &top));
+	*sub  = row - top;
+	return true;
+}
+
+// ~geb: display row of `offset`, and the cell it sits at in its line
+internal usize
+_wrap_locate(Wrap_Layout *wl, usize offset, usize *cell)
+{
+	Q_Buffer *b = wl->buffer;
+	offset = Min(offset, buffer_len(b));
+
+	usize line = buffer_row_from_offset(b, offset);
+	_wrap_build(wl, line, 0);
+
+	*cell = _wrap_cells(b, buffer_offset_from_row(b, line), offset);
+	if (line >= gap_tree_count(&wl->tree)) return _wrap_total(wl);
+
+	return _wrap_top(wl, line) + *cell / wl->cols;
+}
+
+///////////////////////////////////////////////
+
+internal Wrap_Layout *
+wrap_make(Q_Buffer *buf, usize cols, Allocator alloc)
+{
+	Wrap_Layout *wl = cast(Wrap_Layout *) mem_alloc_aligned(alloc, sizeof(Wrap_Layout), AlignOf(Wrap_Layout), true, NULL);
+	if (!wl) return NULL;
+
+	wl->alloc  = alloc;
+	wl->buffer = buf;
+	wl->cols   = Max(cols, 1);
+
+	wl->tree = gap_tree(alloc, Wrap_Line, _wrap_join);
+	if (!gap_tree_grow(&wl->tree) || !buffer_watch(buf, &wl->dirty)) {
+		gap_tree_delete(&wl->tree);
+		mem_free(alloc, wl, NULL);
+		return NULL;
+	}
+	return wl;
+}
+
+internal void
+wrap_delete(Wrap_Layout *wl)
+{
+	if (!wl) return;
+
+	buffer_unwatch(wl->buffer, &wl->dirty);
+	gap_tree_delete(&wl->tree);
+	mem_free(wl->alloc, wl, NULL);
+}
+
+internal void
+wrap_pump(Wrap_Layout *wl)
+{
+	if (!wl) return;
+	_wrap_catch_up(wl);
+	_wrap_build(wl, gap_tree_count(&wl->tree) + WRAP_PUMP_LINES, 0);
+}
+
+// ~geb: nothing is divided here, a window dragged across many sizes in
+//       one frame only gets laid out once
+internal void
+wrap_set_cols(Wrap_Layout *wl, usize cols)
+{
+	cols = Max(cols, 1);
+	if (wl->cols == cols) return;
+
+	wl->cols    = cols;
+	wl->resized = true;
+}
+
+internal usize
+wrap_row_from_offset(Wrap_Layout *wl, usize offset)
+{
+	_wrap_catch_up(wl);
+
+	usize cell = 0;
+	return _wrap_locate(wl, offset, &cell);
+}
+
+internal usize
+wrap_offset_from_row(Wrap_Layout *wl, usize row, usize *cell)
+{
+	_wrap_catch_up(wl);
+
+	usize line = 0, sub = 0;
+	if (!_wrap_row_at(wl, row, &line, &sub)) {
+		*cell = 0;
+		return 0;
+	}
+	return _wrap_offset_at_cell(wl->buffer, line, sub * wl->cols, cell);
+}
+
+internal usize
+wrap_offset_by_rows(Wrap_Layout *wl, usize offset, isize rows)
+{
+	_wrap_catch_up(wl);
+
+	usize cell = 0;
+	usize row  = _wrap_locate(wl, offset, &cell);
+	usize col  = cell % wl->cols;
+
+	row = rows < 0 && cast(usize) -rows > row ? 0 : row + rows;
+
+	usize line = 0, sub = 0;
+	if (!_wrap_row_at(wl, row, &line, &sub)) return offset;
+
+	// ~geb: past the last row goes to the end of the text
+	if (row > sub + _wrap_top(wl, line)) return buffer_len(wl->buffer);
+
+	return _wrap_offset_at_cell(wl->buffer, line, sub * wl->cols + col, &cell);
+}
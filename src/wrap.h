@@ -0,0 +1,55 @@
+#ifndef WRAP_H
+#define WRAP_H
+
+///////////////////////////////////////////////////////////////////
+// ~geb: soft wrap. every line of the buffer is kept as how many cells
+//       it is wide, a cell being one glyph tile, and a line `w` cells
+//       wide takes w / cols + 1 display rows, the +1 for the cell the
+//       cursor sits in at its end. the lines are the leaves of a tree
+//       summing up the rows, so going between a display row and the
+//       offset drawn there is O(log n) plus one line walked.
+//       an edit only measures the lines it touched again, a resize only
+//       divides the widths again, and only once the layout is next used.
+///////////////////////////////////////////////////////////////////
+
+#include "base.h"
+#include "buffer.h"
+
+#define WRAP_TAB_CELLS   4     // as wide as the renderer draws a tab
+#define WRAP_PUMP_LINES  65536 // lines measured ahead per frame
+
+// ~geb: a leaf of the tree, the nodes above it only sum up the rows
+typedef struct {
+	u32 rows;
+	u32 width; // cells
+} Wrap_Line;
+
+// ~geb: the lines are the leaves of a gap tree of Wrap_Line. lines are
+//       measured from the top down, the ones past the leaves are not yet
+typedef struct {
+	Allocator     alloc;
+	Q_Buffer     *buffer;
+	Buffer_Dirty  dirty;
+
+	Gap_Tree      tree;
+
+	usize cols;    // cells a display row holds
+	bool  resized; // the rows were not divided by `cols` yet
+} Wrap_Layout;
+
+internal Wrap_Layout *wrap_make(Q_Buffer *buf, usize cols, Allocator alloc);
+internal void         wrap_delete(Wrap_Layout *layout);
+internal void         wrap_pump(Wrap_Layout *layout);
+
+internal void wrap_set_cols(Wrap_Layout *layout, usize cols);
+
+internal usize wrap_row_from_offset(Wrap_Layout *layout, usize offset);
+
+// ~geb: the first glyph drawn on display row `row`, clamped to the last
+//       row. `cell` is where it sits in its line
+internal usize wrap_offset_from_row(Wrap_Layout *layout, usize row, usize *cell);
+
+// ~geb: `rows` display rows up or down, keeping to the same column
+internal usize wrap_offset_by_rows(Wrap_Layout *layout, usize offset, isize rows);
+
+#endif